@@ -0,0 +1,145 @@
+// Equalizer layouts at different buffer sizes:
+//   per-sample  frame -> channel -> band on the interleaved buffer (the old loop)
+//   blocks      channels copied out, one band at a time over the block
+//   vector      SSE2/NEON cascade, two bands x stereo per vector
+// Build with -DYABOKU_BUILD_BENCHMARKS=ON, run yaboku_eq_bench
+
+#include "eq.h"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <functional>
+
+static const float BENCH_SAMPLE_RATE = 44100.0f;
+static const float BENCH_GAINS[EQ_BANDS] = {4.0f, -2.0f, 1.5f, -3.0f, 2.0f, 3.5f, -1.0f, 2.5f, -4.0f};
+
+// The filter bank Equalizer builds, driven one sample at a time
+struct PerSampleEqualizer {
+    BiquadFilter filters[EQ_BANDS][2];
+
+    PerSampleEqualizer() {
+        for (int band = 0; band < EQ_BANDS; ++band) {
+            for (int channel = 0; channel < 2; ++channel) {
+                if (band == 0) {
+                    filters[band][channel].setLowShelf(EQ_FREQUENCIES[band], BENCH_SAMPLE_RATE, BENCH_GAINS[band], 0.707f);
+                } else if (band == EQ_BANDS - 1) {
+                    filters[band][channel].setHighShelf(EQ_FREQUENCIES[band], BENCH_SAMPLE_RATE, BENCH_GAINS[band], 0.707f);
+                } else {
+                    filters[band][channel].setPeakingEQ(EQ_FREQUENCIES[band], BENCH_SAMPLE_RATE, BENCH_GAINS[band], 1.0f);
+                }
+            }
+        }
+    }
+
+    void process(float* buffer, int frames) {
+        for (int frame = 0; frame < frames; ++frame) {
+            for (int channel = 0; channel < 2; ++channel) {
+                float sample = buffer[frame * 2 + channel];
+                for (int band = 0; band < EQ_BANDS; ++band) {
+                    sample = filters[band][channel].process(sample);
+                }
+                buffer[frame * 2 + channel] = sample;
+            }
+        }
+    }
+};
+
+// Gains set before initialize are taken as they are, no glide
+static void setupEqualizer(Equalizer& equalizer) {
+    for (int band = 0; band < EQ_BANDS; ++band) {
+        equalizer.setBandGain(band, BENCH_GAINS[band]);
+    }
+    equalizer.initialize(BENCH_SAMPLE_RATE);
+    equalizer.setEnabled(true);
+}
+
+// Nanoseconds per stereo frame, best of a few rounds of about 50 ms of
+// audio (at least 64 calls) each. Every call gets its own slice of the
+// input, refilled before the timed part, so the filters always see audio
+// and not a buffer they already decayed to denormals or zero.
+static double measure(const std::function<void(float*, int)>& process, const std::vector<float>& input, int frames) {
+    int calls = std::max(64, static_cast<int>(BENCH_SAMPLE_RATE * 0.05f) / frames);
+    size_t samples = static_cast<size_t>(frames) * 2;
+    std::vector<float> buffer(samples * calls);
+    double best = 1e300;
+    for (int round = 0; round < 5; ++round) {
+        for (size_t i = 0; i < buffer.size(); ++i) {
+            buffer[i] = input[i % input.size()];
+        }
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < calls; ++i) {
+            process(buffer.data() + i * samples, frames);
+        }
+        auto end = std::chrono::steady_clock::now();
+        double nanos = std::chrono::duration<double, std::nano>(end - start).count();
+        best = std::min(best, nanos / (static_cast<double>(calls) * frames));
+    }
+    return best;
+}
+
+// Same input through each layout, largest difference to the per-sample loop
+static float compare(const std::function<void(float*, int)>& process, const std::vector<float>& input, int frames) {
+    PerSampleEqualizer reference;
+    std::vector<float> expected(input);
+    std::vector<float> actual(input);
+    float worst = 0.0f;
+    for (size_t offset = 0; offset + frames * 2 <= input.size(); offset += frames * 2) {
+        reference.process(expected.data() + offset, frames);
+        process(actual.data() + offset, frames);
+    }
+    for (size_t i = 0; i < input.size(); ++i) {
+        worst = std::max(worst, std::fabs(expected[i] - actual[i]));
+    }
+    return worst;
+}
+
+int main() {
+    std::vector<float> input(4096 * 2 * 4);
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> noise(-0.5f, 0.5f);
+    for (float& sample : input) sample = noise(random);
+
+    bool vector = Equalizer::hasVectorPath();
+    std::cout << "Equalizer, " << EQ_BANDS << " bands, stereo, ns per frame (lower is better)" << std::endl;
+    std::cout << std::setw(8) << "frames" << std::setw(14) << "per-sample" << std::setw(10) << "blocks";
+    if (vector) std::cout << std::setw(10) << "vector";
+    std::cout << std::endl;
+
+    Equalizer blocks;
+    Equalizer stereo;
+    setupEqualizer(blocks);
+    setupEqualizer(stereo);
+    auto runBlocks = [&](float* buffer, int frames) { blocks.processBlocks(buffer, frames, 2); };
+    auto runVector = [&](float* buffer, int frames) { stereo.processStereo(buffer, frames); };
+
+    for (int frames = 64; frames <= 4096; frames *= 2) {
+        PerSampleEqualizer perSample;
+        auto runPerSample = [&](float* buffer, int count) { perSample.process(buffer, count); };
+
+        std::cout << std::fixed << std::setprecision(2)
+                  << std::setw(8) << frames
+                  << std::setw(14) << measure(runPerSample, input, frames)
+                  << std::setw(10) << measure(runBlocks, input, frames);
+        if (vector) std::cout << std::setw(10) << measure(runVector, input, frames);
+        std::cout << std::endl;
+    }
+
+    // Fresh state for the check, every layout starts from silence
+    Equalizer checkBlocks;
+    Equalizer checkStereo;
+    setupEqualizer(checkBlocks);
+    setupEqualizer(checkStereo);
+    std::cout << std::scientific << std::setprecision(2)
+              << "max difference to per-sample: blocks "
+              << compare([&](float* buffer, int frames) { checkBlocks.processBlocks(buffer, frames, 2); }, input, 512);
+    if (vector) {
+        std::cout << ", vector "
+                  << compare([&](float* buffer, int frames) { checkStereo.processStereo(buffer, frames); }, input, 512);
+    }
+    std::cout << std::endl;
+    return 0;
+}
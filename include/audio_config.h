@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+
+// Playback engine settings, stored in config/audio.json
+struct AudioConfig {
+    // Streaming decode: play while the decoder is still running
+    bool streamingEnabled = true;
+    int streamPrerollMs = 200;   // buffered audio required before the first sample plays
+    int streamBufferMs = 4000;   // ring buffer size between decoder thread and callback
+    // Open the next track ahead of time and splice it in without a gap (streaming only)
+    bool gaplessEnabled = true;
+    // Crossfade between tracks, 0 = gapless only
+    float crossfadeSeconds = 0.0f;
+    std::string crossfadeCurve = "equal-power";   // linear, equal-power, s-curve
+    int skipFadeMs = 100;        // fade on manual next/previous, 0 = hard cut
+    // Loudness normalization to -18 LUFS from the background analysis
+    std::string loudnessMode = "track";   // off, track, album
+    float loudnessPreampDb = 0.0f;        // added to the computed gain, peaks still stay under 0 dBTP
+    // Look-ahead limiter after the EQ, off = hard clip at 0 dBFS
+    bool limiterEnabled = true;
+    float limiterCeilingDb = -1.0f;     // dBTP with true-peak detection
+    float limiterReleaseMs = 150.0f;
+    float limiterLookaheadMs = 1.5f;    // added output latency
+    bool limiterTruePeak = true;
+    // Where the audio goes, YABOKU_OUTPUT_SINK in the environment overrides it
+    std::string outputSink = "portaudio";   // portaudio, null (no hardware, real-time pace), file
+    std::string outputFile;                 // file sink target, empty = config/output.wav
+    // Output stream, devices are stored by name since PortAudio indices change between runs
+    std::string outputHostApi;   // empty = default host API
+    std::string outputDevice;    // empty = default device of the host API
+    int framesPerBuffer = 512;   // 0 = chosen by the host
+    int outputLatencyMs = 0;     // suggested latency, 0 = device default low latency
+    std::string outputSampleFormat = "auto";   // auto (float32 when the device takes it), float32, int32, int24, int16
+    std::string outputDither = "tpdf";         // for int16/int24: off, tpdf, shaped
+};
+
+extern AudioConfig audioConfig;
+
+void loadAudioConfig();
+void saveAudioConfig();
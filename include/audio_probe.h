@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+
+struct AudioInfo {
+    float sampleRate = 44100.0f;
+    int channels = 2;
+    float duration = 0.0f;
+    bool valid = false;
+
+    std::string codec;
+    int bitrate = 0;        // kbit/s
+    int bitDepth = 0;       // 0 for lossy codecs
+    bool hasCover = false;
+
+    // Tags
+    std::string title;
+    std::string artist;
+    std::string album;
+    std::string genre;
+    int year = 0;
+    int trackNumber = 0;
+};
+
+// All stream/format properties and tags of a file in one pass.
+// TagLib reads them in-process; one ffprobe JSON call is the fallback.
+// Results are kept in memory and in the metadata store, so a file is only
+// probed again after it changed on disk.
+AudioInfo probeAudio(const std::string& filepath);
+
+// What is known about the file without probing it: the session cache or the
+// metadata store. False when the file was not probed yet; info may still be
+// invalid when it was and failed.
+bool findProbedAudio(const std::string& filepath, AudioInfo& info);
+
+// Drop the session result so the next call checks the file again, e.g. when it
+// is added to the playlist once more
+void invalidateProbe(const std::string& filepath);
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// Timing and status of one block, as seen by the sink
+struct SinkBlockInfo {
+    double dacTime = 0.0;     // when the first frame is heard, on the AudioSink::time() clock, 0 = unknown
+    bool underflow = false;   // the sink ran dry before this block
+    bool overflow = false;
+    bool priming = false;     // block is filling the device buffer before playback starts
+};
+
+// Fills frames * channels interleaved floats. Runs on the sink's thread, must not block.
+using SinkRenderFunction = void (*)(float* out, unsigned long frames, const SinkBlockInfo& info);
+
+struct SinkSettings {
+    double sampleRate = 44100.0;
+    int channels = 2;
+    int framesPerBuffer = 512;     // 0 = chosen by the host (PortAudio), 512 elsewhere
+    std::string hostApi;           // PortAudio only, empty = default
+    std::string device;            // PortAudio only, empty = default device of the host API
+    int latencyMs = 0;             // PortAudio only, 0 = device default low latency
+    std::string sampleFormat = "auto";   // PortAudio only: auto (float first), float32, int32, int24, int16
+    std::string dither = "tpdf";   // int16/int24 output: off, tpdf, shaped
+    std::string filePath;          // file sink only
+};
+
+// What is actually open, may differ from the settings
+struct SinkInfo {
+    std::string kind;              // portaudio, null, file
+    std::string device;
+    std::string hostApi;
+    int framesPerBuffer = 0;       // 0 = chosen by the host
+    double latencySeconds = 0.0;   // from handing a block over to hearing it
+    std::string sampleFormat = "float32";   // what the device was opened with
+    std::string dither = "off";    // applied when converting to it
+};
+
+// Where the engine's blocks go. The sink owns the thread that calls render.
+class AudioSink {
+public:
+    virtual ~AudioSink() = default;
+
+    // Opens the device and starts calling render, false if it could not
+    virtual bool start(SinkRenderFunction render) = 0;
+    // Returns once render is no longer running
+    virtual void stop() = 0;
+
+    virtual double time() const = 0;      // clock the dacTime of each block is on
+    virtual double cpuLoad() const = 0;   // share of the block duration spent in render, 0-1
+    const SinkInfo& info() const { return sinkInfo; }
+
+protected:
+    SinkInfo sinkInfo;
+};
+
+// Sound card through PortAudio
+std::unique_ptr<AudioSink> createPortAudioSink(const SinkSettings& settings);
+// Discards the audio; a timer thread pulls blocks at real-time pace, for machines without audio hardware
+std::unique_ptr<AudioSink> createNullSink(const SinkSettings& settings);
+// Like the null sink, but writes what it pulls to a 32-bit float WAV file
+std::unique_ptr<AudioSink> createFileSink(const SinkSettings& settings);
+
+struct OutputDeviceInfo {
+    std::string name;
+    std::string hostApi;
+    double defaultLowLatencyMs = 0.0;
+    double defaultHighLatencyMs = 0.0;
+};
+
+// PortAudio devices, initializes PortAudio for the call if no sink has
+std::vector<std::string> listHostApis();
+std::vector<OutputDeviceInfo> listOutputDevices(int channels);
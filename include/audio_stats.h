@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Log-linear histogram of durations in nanoseconds, HDR-style: values below
+// 2 * SUB_BUCKETS get a bucket each, every power of two above that is split
+// into SUB_BUCKETS linear buckets, so the error stays under 1 / SUB_BUCKETS.
+// One thread records (relaxed load + store, no locked instructions), any
+// thread may read.
+class TimingHistogram {
+public:
+    static const int SUB_BUCKET_BITS = 4;
+    static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static const int BUCKETS = (32 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    void record(uint32_t nanos);
+    void reset();   // writer side only
+
+    uint64_t count() const;
+    uint32_t max() const { return maxValue.load(std::memory_order_relaxed); }
+    double mean() const;
+    // Upper bound of the bucket holding the given percentile (0-100)
+    uint32_t percentile(double p) const;
+
+private:
+    static int bucketIndex(uint32_t value);
+    static uint32_t bucketUpperBound(int index);
+
+    std::atomic<uint32_t> counts[BUCKETS] = {};
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint32_t> maxValue{0};
+};
+
+struct TimingSummary {
+    uint64_t count = 0;
+    double meanUs = 0.0;
+    double p50Us = 0.0;
+    double p90Us = 0.0;
+    double p99Us = 0.0;
+    double p999Us = 0.0;
+    double maxUs = 0.0;
+};
+
+struct AudioStatsReport {
+    TimingSummary callback;      // whole audioCallback
+    TimingSummary equalizer;     // processEqualizerBuffer only
+    double budgetUs = 0.0;       // duration of the last buffer, the callback's deadline
+    uint64_t overruns = 0;       // callbacks that took longer than their buffer lasts
+    uint64_t underflows = 0;     // paOutputUnderflow reported by the host
+    uint64_t overflows = 0;      // paOutputOverflow
+    uint64_t primingCallbacks = 0;
+};
+
+// Audio thread, once per callback
+void recordCallbackStats(uint32_t callbackNanos, uint32_t equalizerNanos, uint32_t budgetNanos,
+                         bool underflow, bool overflow, bool priming);
+
+AudioStatsReport getAudioStats();
+// Applied by the audio thread on its next callback
+void resetAudioStats();
+bool dumpAudioStats(const std::string& path, double cpuLoad);
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "ring_buffer.h"
+#include "decoder.h"
+
+#include <string>
+#include <memory>
+#include <thread>
+#include <atomic>
+
+// Streaming playback: a decoder thread pulls frames from a Decoder into a
+// bounded ring buffer and the audio callback reads from there. Memory use
+// and time-to-first-audio do not depend on the track length.
+class AudioStream {
+public:
+    AudioStream(float sampleRate, int channels, int bufferMs, int prerollMs);
+    ~AudioStream();
+
+    bool open(const std::string& filepath, float startSeconds = 0.0f);
+    void close();
+
+    // Audio thread side, never blocks. Returns frames written to out.
+    size_t read(float* out, size_t frames);
+
+    // Pre-roll is buffered (or the whole track is shorter than that)
+    bool isReady() const;
+    // Decoder reached the end and everything was played
+    bool isFinished() const;
+    // Decoder reached the end, what is buffered now is all that is left
+    bool isDecodeComplete() const { return endOfStream.load(); }
+
+    size_t bufferedFrames() const;
+    size_t decodedFrames() const { return framesDecoded.load(); }
+    // Frames handed out by read() since open()
+    size_t playedFrames() const { return framesPlayed.load(); }
+    float startOffset() const { return startSeconds; }
+    // Estimated from the container, 0 if unknown
+    uint64_t totalFrames() const { return trackFrames; }
+    const std::string& path() const { return filepath; }
+
+private:
+    void decodeLoop();
+
+    std::string filepath;
+    float sampleRate;
+    int channels;
+    size_t prerollFrames;
+    float startSeconds = 0.0f;
+    uint64_t trackFrames = 0;
+
+    std::unique_ptr<Decoder> decoder;
+    std::thread decoderThread;
+    RingBuffer<float> ring;
+    std::atomic<bool> stopRequested{false};
+    std::atomic<bool> endOfStream{false};
+    std::atomic<size_t> framesDecoded{0};
+    std::atomic<size_t> framesPlayed{0};
+};
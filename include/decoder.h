@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <cstdint>
+
+// Pluggable audio decoder. Backends decode straight into interleaved float
+// frames in [-1, 1], channels in WAVE order (FL, FR, FC, LFE, BL, BR, SL, SR).
+class Decoder {
+public:
+    virtual ~Decoder() = default;
+
+    virtual bool open(const std::string& filepath) = 0;
+    // Returns frames written to out, 0 at the end of the stream
+    virtual size_t read(float* out, size_t frames) = 0;
+    virtual bool seek(double seconds) = 0;
+    virtual const char* name() const = 0;
+
+    int sampleRate() const { return rate; }
+    int channels() const { return channelCount; }
+    // 0 when the length is unknown
+    uint64_t totalFrames() const { return frameCount; }
+    double duration() const { return rate > 0 ? static_cast<double>(frameCount) / rate : 0.0; }
+
+protected:
+    int rate = 0;
+    int channelCount = 0;
+    uint64_t frameCount = 0;
+};
+
+// In-process backends, nullptr when the backend is not compiled in
+std::unique_ptr<Decoder> createWavDecoder();
+std::unique_ptr<Decoder> createFlacDecoder();
+std::unique_ptr<Decoder> createMp3Decoder();
+std::unique_ptr<Decoder> createVorbisDecoder();
+// Fallback for containers the backends can't open, outputs the requested format
+std::unique_ptr<Decoder> createFFmpegDecoder(int sampleRate, int channels);
+
+// Picks a backend by file signature/extension and opens the file.
+// Returns nullptr if neither a backend nor ffmpeg can read it.
+std::unique_ptr<Decoder> createDecoder(const std::string& filepath, int fallbackRate = 44100, int fallbackChannels = 2);
+
+// Opens the file and converts its output to the given rate and channel count
+std::unique_ptr<Decoder> openDecoder(const std::string& filepath, int sampleRate, int channels);
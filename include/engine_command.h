@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "limiter.h"
+
+class AudioStream;
+
+// UI thread -> audio engine. Commands go through an SPSC RingBuffer and are
+// applied at the start of the next callback, so every change lands on a
+// buffer boundary. A command carrying a stream or buffer hands it over to
+// the engine, which sends it back for deletion once it is done with it.
+enum class EngineCommandType : uint8_t {
+    Play,       // stream or buffer becomes the current source; neither = promote the next source with this id
+    SetNext,    // stream to continue with when the current one ends, nullptr clears it
+    NextGain,   // loudness gain of the next source with this id, once its analysis finished
+    Seek,       // stream restarted at the target, or frame position in the buffer
+    Pause,
+    Resume,
+    Stop,
+    Volume,
+    EqEnabled,
+    Crossfade,  // frames = length (0 = gapless only), index = FadeCurve
+    Limiter     // limiter settings
+};
+
+struct EngineCommand {
+    EngineCommandType type = EngineCommandType::Stop;
+    uint32_t id = 0;          // source id for Play/SetNext/Seek
+    int index = 0;
+    size_t frames = 0;        // fade length, or buffer position for Seek
+    float value = 0.0f;       // linear loudness gain for Play/SetNext/NextGain
+    AudioStream* stream = nullptr;
+    std::vector<float>* buffer = nullptr;
+    LimiterSettings limiter;
+};
+
+// Audio engine -> UI thread, published at the end of every callback
+struct EngineSnapshot {
+    uint32_t sourceId = 0;          // source playing now, 0 = none
+    uint64_t positionFrames = 0;    // in the current track, including a stream's start offset
+    double positionTime = 0.0;      // stream time at which positionFrames reaches the DAC, 0 = unknown
+    uint64_t segmentStartFrames = 0;  // where playback of the current source began (track start or seek target)
+    uint32_t finishedCount = 0;     // bumped when a source ended with nothing queued after it
+    uint32_t finishedId = 0;        // and which one it was
+    uint32_t advancedCount = 0;     // bumped on every gapless or crossfade switch to the next source
+    bool playing = false;
+    bool paused = false;
+    int fadingVoices = 0;
+    size_t bufferedFrames = 0;      // decoded ahead in the current stream
+    size_t limiterLatencyFrames = 0;  // look-ahead delay after the EQ
+    float limiterReductionDb = 0.0f;  // deepest in the last buffer, 0 or negative
+};
@@ -4,6 +4,9 @@
 #include <array>
 #include <atomic>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <cstdint>
 
 // EQ frequency point count
 constexpr int EQ_BANDS = 9;
@@ -13,37 +16,163 @@ constexpr std::array<float, EQ_BANDS> EQ_FREQUENCIES = {
     30.0f, 150.0f, 350.0f, 600.0f, 1000.0f, 3500.0f, 7000.0f, 11000.0f, 16000.0f
 };
 
+// Most bands the parametric EQ runs, enough for a headphone correction
+// profile with room to spare
+constexpr int EQ_MAX_BANDS = 32;
+
+enum class EqFilterType {
+    Peak = 0,
+    LowShelf,
+    HighShelf,
+    LowPass,
+    HighPass,
+    Notch,
+    AllPass
+};
+
+const char* eqFilterTypeName(EqFilterType type);
+bool eqFilterTypeFromName(const std::string& name, EqFilterType& type);
+// Gain only matters to peaks and shelves
+bool eqFilterTypeHasGain(EqFilterType type);
+
+struct EqBand {
+    EqFilterType type = EqFilterType::Peak;
+    float frequency = 1000.0f;
+    float q = 0.707f;
+    float gainDB = 0.0f;
+    bool enabled = true;
+};
+
+// The 9-band graphic EQ as parametric bands: low shelf, peaks, high shelf
+std::vector<EqBand> graphicEqualizerBands(const float gains[EQ_BANDS]);
+
+// Transposed direct form II: two state values instead of four, and the
+// same arithmetic as the vectorized cascade in Equalizer. Coefficients are
+// designed in double and rounded once, low bands at 44.1 kHz need it.
 class BiquadFilter {
 public:
     BiquadFilter();
     void setPeakingEQ(float frequency, float sampleRate, float gainDB, float Q = 1.0f);
     void setLowShelf(float frequency, float sampleRate, float gainDB, float Q = 0.707f);
     void setHighShelf(float frequency, float sampleRate, float gainDB, float Q = 0.707f);
+    void setLowPass(float frequency, float sampleRate, float Q = 0.707f);
+    void setHighPass(float frequency, float sampleRate, float Q = 0.707f);
+    void setNotch(float frequency, float sampleRate, float Q = 0.707f);
+    void setAllPass(float frequency, float sampleRate, float Q = 0.707f);
+    void setGain(float gainDB);
+    void setPassThrough();
+    // Any band; a disabled one passes through
+    void design(const EqBand& band, float sampleRate);
     float process(float input);
     void reset();
 
 private:
+    friend class Equalizer;
+
+    void setNormalized(double b0, double b1, double b2, double a0, double a1, double a2);
+
     float b0, b1, b2, a1, a2;
-    float x1, x2, y1, y2;
+    float s1, s2;
+};
+
+// Target filters of every band, designed off the audio thread. Stage
+// EQ_MAX_BANDS is the preamp.
+struct EqualizerBank {
+    static constexpr int STAGES = EQ_MAX_BANDS + 1;
+    BiquadFilter designs[STAGES];
+    bool flat[STAGES] = {};           // passes the signal through unchanged
+    uint32_t revisions[STAGES] = {};  // bumped whenever a design changes
 };
 
+// Settings are written on the UI side and published as a whole bank; the
+// audio thread picks up the newest one at the start of a buffer and glides
+// its coefficients there, so neither side ever waits and the filters never
+// jump. setEnabled is the engine's, it comes in through the command queue.
 class Equalizer {
 public:
     Equalizer();
     ~Equalizer();
 
+    // Before the audio thread runs: takes the bands as they are, no glide
     void initialize(float sampleRate);
+    // UI side, any thread. Starts out as the flat graphic EQ; setBandGain
+    // changes the gain of one band of whatever layout is set.
+    void setBands(const std::vector<EqBand>& bands, float preampDB = 0.0f);
+    std::vector<EqBand> getBands() const;
     void setBandGain(int band, float gainDB);
     float getBandGain(int band) const;
-    void setEnabled(bool enabled);
-    bool isEnabled() const;
     void reset();
 
+    // Audio thread
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
     void processBuffer(float* buffer, int frames, int channels);
+    // Off, or every band flat with nothing new published: the buffer would
+    // come out unchanged
+    bool isBypassed() const;
+
+    // The two layouts processBuffer picks from, public for the benchmark.
+    // processStereo is the vector cascade (SSE2/NEON builds, stereo only);
+    // processBlocks copies the first two channels out into blocks and runs
+    // one band at a time over each block. Both run the compiled chain with
+    // its current coefficients.
+    static bool hasVectorPath();
+    void processStereo(float* buffer, int frames);
+    void processBlocks(float* buffer, int frames, int channels);
 
 private:
-    std::array<std::array<BiquadFilter, 2>, EQ_BANDS> filters; // [band][channel]
-    std::array<std::atomic<float>, EQ_BANDS> bandGains;
+    static constexpr int MAX_STAGES = EqualizerBank::STAGES;
+    static constexpr int PREAMP_STAGE = EQ_MAX_BANDS;
+    // Stages two at a time, stereo: lanes {L, R} of stage 2p and {L, R} of
+    // stage 2p + 1, an odd chain padded with a pass-through
+    static constexpr int STAGE_PAIRS = (MAX_STAGES + 1) / 2;
+    static constexpr int BLOCK_FRAMES = 256;
+    // Coefficient glide: one step per RAMP_STEP_FRAMES, RAMP_STEPS steps (~23 ms at 44.1 kHz)
+    static constexpr int RAMP_STEP_FRAMES = 64;
+    static constexpr int RAMP_STEPS = 16;
+    static constexpr int BANK_INDEX = 3;
+    static constexpr int BANK_NEW = 4;
+
+    using StereoKernel = void (*)(const float* coefficients, float* state, float* buffer, int frames);
+
+    // Writer side, under writerMutex
+    void designStage(int stage);
+    void publish();
+
+    void adoptPublishedBank();
+    void advanceRamps();
+    void loadCoefficients();
+    // Chain of the stages that change the signal, and the kernel for its length
+    void compileChain();
+    // Drops flat stages from the chain once their state has rung out
+    void retireSettledBands();
+    bool isSettled(int stage) const;
+
+    // UI side: the settings, the bank built from them, and the spare it goes out through
+    mutable std::mutex writerMutex;
+    std::vector<EqBand> bands;
+    float preampDB;
+    EqualizerBank latest;
+    int writerBank;
+    // Exchanged by both sides: index of the bank in between, BANK_NEW when
+    // the writer put a fresh one there
+    std::atomic<int> middleBank;
+    EqualizerBank banks[3];
+
+    // Audio thread
+    int readerBank;
+    uint32_t revisions[MAX_STAGES];                          // of the designs adopted
+    int rampSteps[MAX_STAGES];                               // steps left to the target
+    int rampingBands;
+    std::array<std::array<BiquadFilter, 2>, MAX_STAGES> filters; // [stage][channel], current coefficients and state
+    int chain[MAX_STAGES];                                   // active stages in order
+    int chainLength;
+    bool chainDraining;                                      // holds a flat stage still ringing
+    StereoKernel stereoKernel;
+    alignas(16) float coefficients[STAGE_PAIRS][5][4];       // [pair][b0 b1 b2 a1 a2][lane]
+    alignas(16) float state[STAGE_PAIRS][2][4];              // [pair][s1 s2][lane]
+    alignas(16) float blocks[2][BLOCK_FRAMES];               // [channel][frame]
+
     std::atomic<bool> enabled;
     float sampleRate;
     bool initialized;
@@ -56,7 +185,11 @@ void initEqualizer(float sampleRate = 44100.0f);
 void shutdownEqualizer();
 void setEqualizerEnabled(bool enabled);
 bool isEqualizerEnabled();
+bool isEqualizerBypassed();
 void setEqualizerBand(int band, float gainDB);
+void setEqualizerBands(const std::vector<EqBand>& bands, float preampDB);
+// The layout set, graphic or parametric
+std::vector<EqBand> getEqualizerBands();
 float getEqualizerBand(int band);
 void resetEqualizer();
 
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "eq.h"
+
+#include <string>
+#include <vector>
+#include <istream>
+
+// Parametric preset in the Equalizer APO text format, as AutoEq writes them:
+//   Preamp: -6.2 dB
+//   Filter 1: ON PK Fc 105 Hz Gain -2.3 dB Q 0.70
+struct EqPreset {
+    float preampDB = 0.0f;
+    std::vector<EqBand> bands;
+};
+
+// False when nothing usable was found; skipped lines are reported on std::cerr
+bool parseEqPreset(std::istream& input, EqPreset& preset);
+bool loadEqPreset(const std::string& path, EqPreset& preset);
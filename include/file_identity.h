@@ -0,0 +1,12 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+// What the on-disk caches (metadata store, waveforms) key and validate
+// entries by: a hash of the path, and the file's size and mtime
+
+// FNV-1a
+uint64_t hashPath(const std::string& path);
+// False when the file is missing or unreadable
+bool statFile(const std::string& filepath, uint64_t& size, int64_t& mtime);
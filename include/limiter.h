@@ -0,0 +1,80 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+struct LimiterSettings {
+    bool enabled = true;        // off = hard clip at 0 dBFS
+    float ceilingDb = -1.0f;    // dBTP with truePeak, dBFS otherwise
+    float releaseMs = 150.0f;
+    float lookaheadMs = 1.5f;   // attack time, sets the added latency
+    bool truePeak = true;       // also catch peaks between samples (4x, 2x above 88.2 kHz)
+};
+
+// Look-ahead brick-wall limiter on interleaved stereo. The gain needed by
+// every peak is held over the look-ahead window (sliding minimum), released
+// exponentially and smoothed by a moving average of the same length, so it
+// has fully come down when the delayed peak comes out: nothing passes the
+// ceiling and there is no distortion from clipping. Below the ceiling the
+// output is the input, delayed by latencyFrames().
+class Limiter {
+public:
+    static constexpr float MAX_LOOKAHEAD_MS = 10.0f;
+
+    // Not real-time safe, allocates for the longest look-ahead
+    void initialize(float sampleRate);
+    // Audio thread; restarts the limiter (clears the delay line) when the
+    // look-ahead or detector changes
+    void setSettings(const LimiterSettings& settings);
+    void process(float* buffer, size_t frames);
+    void reset();
+
+    size_t latencyFrames() const { return delayFrames; }
+    // Deepest gain reduction of the last block, 0 or negative
+    float reductionDb() const { return lastReductionDb; }
+
+private:
+    static constexpr int TAPS = 8;          // per phase of the true-peak interpolator
+    static constexpr int MAX_PHASES = 4;
+    static constexpr size_t CHUNK_FRAMES = 64;
+
+    void detectPeaks(const float* buffer, size_t frames);
+    void computeGains(size_t frames);
+    void delayAndApply(float* buffer, size_t frames);
+
+    float sampleRate = 44100.0f;
+    LimiterSettings settings;
+    float ceiling = 1.0f;
+    double releaseCoefficient = 0.0;
+    bool initialized = false;
+
+    // Detector: one peak per frame, for the sample DETECTOR_DELAY frames back
+    int phases = 1;
+    size_t detectorDelay = 0;
+    float interpolation[TAPS][MAX_PHASES] = {};   // [tap][phase], phase 0 passes the sample through
+    std::vector<float> history;                   // [channel][TAPS - 1 + CHUNK_FRAMES], deinterleaved
+    float peaks[CHUNK_FRAMES] = {};
+    float gains[CHUNK_FRAMES] = {};
+
+    // Gain computer
+    size_t attackFrames = 1;
+    size_t holdFrames = 1;
+    std::vector<float> minValues;       // monotonic queue for the sliding minimum
+    std::vector<size_t> minIndices;
+    size_t minHead = 0;
+    size_t minCount = 0;
+    size_t frameIndex = 0;
+    double released = 1.0;
+    std::vector<float> averageWindow;
+    size_t averagePosition = 0;
+    double averageSum = 0.0;
+
+    // Delay line, interleaved stereo
+    std::vector<float> delay;
+    std::vector<float> delayed;         // one chunk read out of the delay line
+    size_t delayFrames = 0;
+    size_t delayPosition = 0;
+
+    float blockMinGain = 1.0f;
+    float lastReductionDb = 0.0f;
+};
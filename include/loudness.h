@@ -0,0 +1,86 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Result of one track's analysis, kept in the metadata store
+struct TrackLoudness {
+    bool analyzed = false;
+    float integratedLufs = -70.0f;   // EBU R128 integrated loudness
+    float truePeakDb = -70.0f;       // dBTP, 4x oversampled
+    uint32_t gatedBlocks = 0;        // 400 ms blocks above both gates, weights the track in an album
+};
+
+// ITU-R BS.1770-4 / EBU R128 meter: K-weighting, 400 ms blocks with 75%
+// overlap, absolute (-70 LUFS) and relative (-10 LU) gating, true peak on a
+// 4x (2x above 96 kHz) oversampled signal.
+class LoudnessMeter {
+public:
+    LoudnessMeter(int sampleRate, int channels);
+
+    // Interleaved frames in WAVE channel order
+    void process(const float* samples, size_t frames);
+
+    double integratedLufs() const;   // -70 when everything is below the absolute gate
+    double truePeak() const;         // linear
+    uint32_t gatedBlocks() const;
+
+    TrackLoudness result() const;
+
+private:
+    struct Biquad {
+        double b0, b1, b2, a1, a2;
+        double z1 = 0.0, z2 = 0.0;
+        double process(double x) {
+            double y = b0 * x + z1;
+            z1 = b1 * x - a1 * y + z2;
+            z2 = b2 * x - a2 * y;
+            return y;
+        }
+    };
+
+    double gatedMean(double& count) const;
+
+    int channels;
+    std::vector<Biquad> shelf;        // stage 1 per channel, high shelf
+    std::vector<Biquad> highPass;     // stage 2 per channel, RLB high-pass
+    std::vector<double> weights;      // per channel, 0 for LFE
+
+    size_t subBlockFrames;            // 100 ms
+    size_t subBlockPosition = 0;
+    double subBlockEnergy = 0.0;
+    double recentSubBlocks[4] = {};   // the last four make one 400 ms block
+    size_t subBlockCount = 0;
+    std::vector<double> blockEnergies;
+
+    // True peak
+    int oversampling;
+    int tapsPerPhase;
+    std::vector<float> interpolation;   // phase-major, oversampling * tapsPerPhase
+    std::vector<float> history;         // per channel, last tapsPerPhase input samples
+    size_t historyPosition = 0;
+    double peak = 0.0;
+};
+
+// Album loudness from its analyzed tracks: energies weighted by gated block
+// count, loudest peak. Close to analyzing the album as one file, without
+// the album-wide relative gate.
+TrackLoudness combineAlbumLoudness(const std::vector<TrackLoudness>& tracks);
+
+// Background analysis. Low-priority worker threads decode queued tracks at
+// their native format and store the loudness in the metadata store and the
+// waveform overview in the waveform cache; tracks that already have both
+// (for the same file size and mtime) are skipped.
+void startLoudnessAnalysis();
+void stopLoudnessAnalysis();
+// first: ahead of everything still waiting, e.g. the track that just started
+void queueLoudnessAnalysis(const std::string& filepath, bool first = false);
+// Workers hold off between chunks while set, e.g. while playback is short on buffered audio
+void setLoudnessAnalysisPaused(bool paused);
+size_t pendingLoudnessAnalyses();
+// Bumped whenever a result is stored, so callers can pick up new gains and waveforms
+uint32_t loudnessResultCount();
+
+bool getTrackLoudness(const std::string& filepath, TrackLoudness& loudness);
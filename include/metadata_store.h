@@ -0,0 +1,84 @@
+#pragma once
+
+#include "audio_probe.h"
+#include "loudness.h"
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <cstdint>
+#include <unordered_map>
+
+// Persistent track metadata, stored in config/metadata.bin.
+//
+// The file is memory-mapped and laid out as a hash table (bucket heads,
+// fixed-size records, string pool), so a lookup is O(1) and needs no
+// parsing at startup. Entries are keyed by path and validated against the
+// file's size and mtime on every lookup; a changed file is simply a miss
+// and gets re-probed. New entries live in memory until save().
+class MetadataStore {
+public:
+    MetadataStore();
+    ~MetadataStore();
+
+    bool open(const std::string& storePath);
+    void close();
+
+    bool lookup(const std::string& filepath, AudioInfo& info);
+    void store(const std::string& filepath, const AudioInfo& info);
+    // Loudness rides along with the metadata entry, which must exist already
+    bool lookupLoudness(const std::string& filepath, TrackLoudness& loudness);
+    void storeLoudness(const std::string& filepath, const TrackLoudness& loudness);
+
+    // Rewrites the file with the pending entries merged in
+    bool save();
+    // Like save(), but also drops entries of missing or modified files. Returns removed count.
+    size_t compact();
+
+    size_t size() const;
+    size_t pendingCount() const;
+
+private:
+    struct Entry {
+        uint64_t fileSize = 0;
+        int64_t mtime = 0;
+        AudioInfo info;
+        TrackLoudness loudness;
+    };
+
+    bool findEntry(const std::string& filepath, Entry& entry, uint64_t fileSize, int64_t mtime);
+    bool findMapped(const std::string& filepath, Entry& entry) const;
+    bool writeFile(const std::unordered_map<std::string, Entry>& entries);
+    std::unordered_map<std::string, Entry> collectEntries(bool dropStale, size_t& removed) const;
+    bool mapFile();
+    void unmapFile();
+
+    std::string path;
+    std::unordered_map<std::string, Entry> pending;
+    size_t staleHits = 0;
+    mutable std::mutex mutex;
+
+    // Mapping
+    const uint8_t* data = nullptr;
+    size_t dataSize = 0;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#else
+    int fd = -1;
+#endif
+};
+
+extern std::unique_ptr<MetadataStore> g_metadataStore;
+
+void openMetadataStore(const std::string& storePath);
+void closeMetadataStore();
+bool lookupMetadata(const std::string& filepath, AudioInfo& info);
+void storeMetadata(const std::string& filepath, const AudioInfo& info);
+bool lookupLoudness(const std::string& filepath, TrackLoudness& loudness);
+void storeLoudness(const std::string& filepath, const TrackLoudness& loudness);
+void saveMetadataStore();
+size_t compactMetadataStore();
+size_t metadataStoreSize();
+size_t pendingMetadataCount();
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "audio_stream.h"
+
+#include <memory>
+#include <vector>
+#include <string>
+
+enum class FadeCurve {
+    Linear = 0,
+    EqualPower,
+    SCurve
+};
+
+const char* fadeCurveName(FadeCurve curve);
+FadeCurve fadeCurveFromName(const std::string& name);
+
+// Gain of a fade-in at t in [0, 1]; a fade-out uses 1 - t
+float fadeGain(FadeCurve curve, float t);
+
+// Gain envelope of one voice, evaluated per block and ramped linearly inside it
+struct FadeEnvelope {
+    FadeCurve curve = FadeCurve::EqualPower;
+    size_t length = 0;      // frames, 0 = no fade
+    size_t position = 0;
+    bool fadingIn = true;
+
+    bool active() const { return position < length; }
+    bool finished() const { return !fadingIn && position >= length; }
+    float gainAt(size_t pos) const;
+    // Gains at the start and end of the next block, then moves past it
+    void advance(size_t frames, float& gainStart, float& gainEnd);
+};
+
+// SIMD kernels on interleaved samples, the gain moves linearly from gainStart to gainEnd
+void mixWithRamp(float* dst, const float* src, size_t frames, int channels, float gainStart, float gainEnd);
+void applyRamp(float* buffer, size_t frames, int channels, float gainStart, float gainEnd);
+
+// Sources fading out next to the main stream: the previous track during a
+// crossfade or a manual skip. Voices are filled and mixed on the audio
+// thread; streams are only freed on another thread, after releaseFinished()
+// or collectFinished().
+class Mixer {
+public:
+    static const int MAX_VOICES = 4;
+
+    Mixer(int channels, size_t maxFrames);
+
+    // Takes over a stream that fades out from its current position, at its loudness gain.
+    // Returns false if all voices are busy (the stream is then left untouched).
+    bool fadeOut(std::unique_ptr<AudioStream>& stream, size_t frames, FadeCurve curve, float gain = 1.0f);
+
+    // Audio thread: adds every fading voice to out
+    void mix(float* out, size_t frames);
+
+    // Audio thread: ends every voice at once, the streams come back through releaseFinished()
+    void stopAll();
+
+    // Moves finished voices (or all of them) to the caller; only while the audio thread is stopped
+    void collectFinished(std::vector<std::unique_ptr<AudioStream>>& streams, bool all = false);
+
+    int activeVoices() const;
+    bool hasFreeVoice() const;
+
+    // Audio thread: gives up one finished stream, nullptr if there is none
+    AudioStream* releaseFinished();
+
+private:
+    struct Voice {
+        std::unique_ptr<AudioStream> stream;
+        FadeEnvelope envelope;
+        float gain = 1.0f;
+        bool done = false;
+    };
+
+    int channels;
+    Voice voices[MAX_VOICES];
+    std::vector<float> scratch;
+};
@@ -5,12 +5,22 @@
 #include <mutex>
 #include <atomic>
 #include <filesystem>
+#include <functional>
+#include <memory>
 #include <nlohmann/json.hpp>
 #include <portaudio.h>
+#include "audio_probe.h"
+
+class WaveformPyramid;
+struct EqBand;
 
 using json = nlohmann::json;
 namespace fs = std::filesystem;
 
+// Engine format: every source is converted to it, every sink is opened with it
+static const float TARGET_SAMPLE_RATE = 44100.0f;
+static const int TARGET_CHANNELS = 2;
+
 struct Track {
     std::string filepath;
     float durationSeconds = 0.0f;
@@ -21,11 +31,17 @@ struct Playlist {
     std::vector<Track> tracks;
 };
 
-struct AudioInfo {
-    float sampleRate = 44100.0f;
-    int channels = 2;
-    float duration = 0.0f;
-    bool valid = false;
+struct OutputStatus {
+    bool open = false;
+    std::string sink;           // portaudio, null, file
+    std::string device;
+    std::string hostApi;
+    int framesPerBuffer = 0;    // 0 = chosen by the host
+    double latencyMs = 0.0;     // reported by the opened sink
+    std::string sampleFormat;   // float32, int32, int24, int16
+    std::string dither;         // off, tpdf, shaped
+    double processingLatencyMs = 0.0;   // limiter look-ahead, on top of latencyMs
+    float limiterReductionDb = 0.0f;
 };
 
 // Global variables for UI and state
@@ -70,8 +86,25 @@ bool isShuffleEnabled();
 void setVolume(float normalized);
 float getNormalizedVolume();
 void seekTo(float seconds);
+// EQ changes go through the engine and apply at the next buffer
+void sendEqualizerBand(int band, float gainDB);
+// Whole parametric layout, replaces the bands sendEqualizerBand changes
+void sendEqualizerBands(const std::vector<EqBand>& bands, float preampDB);
+void sendEqualizerEnabled(bool enabled);
+// Applies the limiter settings in audioConfig
+void sendLimiterSettings();
+// Output sink, settings come from audioConfig (devices are listed in audio_sink.h)
+OutputStatus getOutputStatus();
+double getOutputCpuLoad();   // 0-1
+bool reopenAudioOutput();
+// Headless: runs the files through the engine (mixer, gain stage, EQ) as fast as
+// they decode and hands every block of interleaved stereo at 44100 Hz to write
+bool renderOffline(const std::vector<std::string>& files, float volume,
+                   const std::function<bool(const float*, size_t)>& write);
+// Overview of the playing track for the seek bar, null until its analysis is done
+std::shared_ptr<const WaveformPyramid> getCurrentWaveform();
 AudioInfo getAudioInfo(const std::string& filepath);
-std::vector<float> loadAudioWithFFmpeg(const std::string& filepath);
+std::vector<float> loadAudioFile(const std::string& filepath);
 float getTrackDuration(const std::string& filepath);
 double getTimeSec();
 void updateTrackPosition();
@@ -0,0 +1,5 @@
+#pragma once
+
+// Headless render: yaboku_player --render [options] <file>...
+// Returns the process exit code.
+int runRenderCommand(int argc, char** argv);
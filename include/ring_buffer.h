@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+
+// Single-producer / single-consumer ring buffer.
+// One thread writes, one thread reads, neither of them ever blocks.
+// Capacity is rounded up to a power of two.
+template <typename T>
+class RingBuffer {
+public:
+    explicit RingBuffer(size_t capacity = 0) {
+        resize(capacity);
+    }
+
+    // Not thread safe, call before producer/consumer start
+    void resize(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity) size <<= 1;
+        data.assign(size, T{});
+        mask = size - 1;
+        writePos.store(0, std::memory_order_relaxed);
+        readPos.store(0, std::memory_order_relaxed);
+    }
+
+    size_t capacity() const { return data.size(); }
+
+    size_t readAvailable() const {
+        return writePos.load(std::memory_order_acquire) - readPos.load(std::memory_order_relaxed);
+    }
+
+    size_t writeAvailable() const {
+        return data.size() - (writePos.load(std::memory_order_relaxed) - readPos.load(std::memory_order_acquire));
+    }
+
+    // Producer side
+    size_t write(const T* src, size_t count) {
+        size_t w = writePos.load(std::memory_order_relaxed);
+        size_t r = readPos.load(std::memory_order_acquire);
+        count = std::min(count, data.size() - (w - r));
+        if (count == 0) return 0;
+
+        size_t start = w & mask;
+        size_t first = std::min(count, data.size() - start);
+        std::memcpy(&data[start], src, first * sizeof(T));
+        std::memcpy(&data[0], src + first, (count - first) * sizeof(T));
+
+        writePos.store(w + count, std::memory_order_release);
+        return count;
+    }
+
+    // Consumer side
+    size_t read(T* dst, size_t count) {
+        size_t r = readPos.load(std::memory_order_relaxed);
+        size_t w = writePos.load(std::memory_order_acquire);
+        count = std::min(count, w - r);
+        if (count == 0) return 0;
+
+        size_t start = r & mask;
+        size_t first = std::min(count, data.size() - start);
+        std::memcpy(dst, &data[start], first * sizeof(T));
+        std::memcpy(dst + first, &data[0], (count - first) * sizeof(T));
+
+        readPos.store(r + count, std::memory_order_release);
+        return count;
+    }
+
+    // Consumer side, drops everything currently buffered
+    void clear() {
+        readPos.store(writePos.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+private:
+    std::vector<T> data;
+    size_t mask = 0;
+    alignas(64) std::atomic<size_t> writePos{0};
+    alignas(64) std::atomic<size_t> readPos{0};
+};
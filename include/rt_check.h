@@ -0,0 +1,32 @@
+#pragma once
+
+// Real-time safety checker, built with -DYABOKU_RT_CHECK=ON. A thread inside
+// an RtScope (the audio callback) must not allocate, lock or block; every
+// malloc/free, mutex lock and blocking call it makes is reported on stderr
+// with a stack trace. YABOKU_RT_CHECK_ABORT=1 in the environment aborts on
+// the first one instead, for test runs.
+//
+// Allocations are caught everywhere; locks, sleeps and file I/O are
+// intercepted on Linux (glibc) only.
+#ifdef YABOKU_RT_CHECK
+
+#include <cstdint>
+
+void rtCheckEnter();
+void rtCheckLeave();
+uint64_t rtCheckViolations();
+void rtCheckSummary();
+
+struct RtScope {
+    RtScope() { rtCheckEnter(); }
+    ~RtScope() { rtCheckLeave(); }
+    RtScope(const RtScope&) = delete;
+    RtScope& operator=(const RtScope&) = delete;
+};
+
+#else
+
+struct RtScope {};
+inline void rtCheckSummary() {}
+
+#endif
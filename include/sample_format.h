@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Output sample formats, integers are little-endian and interleaved; Int24
+// is packed into 3 bytes like paInt24
+enum class SampleFormat {
+    Float32 = 0,
+    Int32,
+    Int24,
+    Int16
+};
+
+enum class DitherMode {
+    Off = 0,
+    Triangular,   // TPDF, +-1 LSB, decorrelates the rounding error from the signal
+    Shaped        // TPDF with the error fed back through a high-pass, moves the noise above ~15 kHz
+};
+
+const char* sampleFormatName(SampleFormat format);
+bool sampleFormatFromName(const std::string& name, SampleFormat& format);
+size_t sampleFormatBytes(SampleFormat format);
+
+const char* ditherModeName(DitherMode mode);
+DitherMode ditherModeFromName(const std::string& name);
+
+// Random generator and noise shaper history of one stream
+struct DitherState {
+    static constexpr int MAX_CHANNELS = 8;
+    static constexpr int SHAPING_TAPS = 3;
+
+    explicit DitherState(int channels = 2, uint32_t seed = 0x9E3779B9u);
+
+    int channels;
+    uint32_t random[4];                           // xorshift32, one per vector lane
+    float error[MAX_CHANNELS][SHAPING_TAPS] = {};
+};
+
+// Converts frames * state.channels interleaved floats. There is one kernel
+// per format and dither mode, instantiated at compile time, so the chosen
+// one has no per-sample branches. Dither only applies to Int16 and Int24,
+// it would be below the float input's own resolution at 32 bits.
+using SampleConverter = void (*)(const float* in, void* out, size_t frames, DitherState& state);
+SampleConverter sampleConverter(SampleFormat format, DitherMode dither);
+
+// Order to try formats in when opening a device: the preferred one ("auto" =
+// float first) followed by the rest, best first
+std::vector<SampleFormat> sampleFormatCandidates(const std::string& preferred);
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+
+// Spectrum analyzer fed from the audio callback. The callback only copies
+// its output into a lock-free ring (spectrumTap); a separate thread runs a
+// Hann-windowed FFT over the latest samples and reduces it to log-spaced
+// bands with peak hold, readable from any thread without locking.
+
+constexpr int SPECTRUM_BANDS = 64;
+constexpr float SPECTRUM_MIN_HZ = 20.0f;
+constexpr float SPECTRUM_MAX_HZ = 20000.0f;
+constexpr float SPECTRUM_FLOOR_DB = -90.0f;
+
+struct SpectrumFrame {
+    float levels[SPECTRUM_BANDS];   // dB relative to a full-scale sine, attack instant, slow release
+    float peaks[SPECTRUM_BANDS];    // held maxima
+};
+
+void startSpectrumAnalyzer(float sampleRate, int channels);
+void stopSpectrumAnalyzer();
+
+// Audio thread: one bounded copy into the ring, frames that don't fit are dropped
+void spectrumTap(const float* samples, size_t frames);
+
+// Latest bands. The FFT only runs while this is being called (the display is visible).
+SpectrumFrame getSpectrum();
+// Lower edge of a band, band SPECTRUM_BANDS is the upper edge of the last one
+float spectrumBandEdge(int band);
@@ -0,0 +1,4 @@
+#pragma once
+
+// Spectrum of the output (after the EQ), EQ band frequencies marked
+void drawSpectrum(float width, float height);
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "sample_format.h"
+
+enum class WavFormat {
+    Float32,    // 32-bit float WAV, bit-exact engine output
+    Pcm16,      // TPDF dithered
+    Raw         // headerless interleaved 32-bit float
+};
+
+// Streams interleaved float blocks to disk, the WAV header is patched with
+// the final size on close
+class WavWriter {
+public:
+    WavWriter(const std::string& path, WavFormat format, int sampleRate, int channels);
+
+    bool isOpen() const { return file.is_open(); }
+    bool write(const float* samples, size_t frames);
+    bool close();
+
+    uint64_t frames() const { return framesWritten; }
+
+private:
+    void writeHeader(uint64_t frames);
+
+    std::ofstream file;
+    WavFormat format;
+    int sampleRate;
+    int channels;
+    std::vector<int16_t> pcm;
+    DitherState dither;
+    uint64_t framesWritten = 0;
+};
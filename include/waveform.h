@@ -0,0 +1,69 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+// One bucket of the overview, quantized to a byte per value
+struct WaveformBucket {
+    int8_t min;
+    int8_t max;
+    uint8_t rms;
+};
+
+// Summary of one seek bar column, linear -1..1 (rms 0..1)
+struct WaveformColumn {
+    float min = 0.0f;
+    float max = 0.0f;
+    float rms = 0.0f;
+};
+
+// Min/max/RMS peak pyramid of a track. Level 0 summarizes BASE_FRAMES
+// frames (all channels) per bucket, every level above halves the bucket
+// count, so any time range renders into N columns by reading at most a few
+// buckets per column from the level that matches the zoom.
+class WaveformPyramid {
+public:
+    static const uint32_t BASE_FRAMES = 256;
+
+    // Builder, fed with interleaved frames while the track is decoded
+    void begin(int sampleRate, int channels);
+    void add(const float* samples, size_t frames);
+    void finish();
+
+    bool empty() const { return levels.empty() || levels[0].empty(); }
+    double duration() const;
+    size_t levelCount() const { return levels.size(); }
+
+    // Columns covering [startSeconds, endSeconds), O(columns) at any range
+    void render(double startSeconds, double endSeconds, size_t columns, std::vector<WaveformColumn>& out) const;
+
+    // sourcePath, fileSize and mtime identify the track the pyramid was built from
+    bool save(const std::string& path, const std::string& sourcePath, uint64_t fileSize, int64_t mtime) const;
+    // Fails on a missing, damaged or stale (size/mtime mismatch) file, or one of another track
+    bool load(const std::string& path, const std::string& sourcePath, uint64_t fileSize, int64_t mtime);
+
+private:
+    void flushBucket();
+
+    int sampleRate = 0;
+    uint64_t totalFrames = 0;
+    std::vector<std::vector<WaveformBucket>> levels;
+
+    // Builder state
+    int channels = 0;
+    uint32_t bucketFrames = 0;
+    float bucketMin = 0.0f;
+    float bucketMax = 0.0f;
+    double bucketSquares = 0.0;
+};
+
+// Cache of pyramids in <dir>/<hash of path>.wfm, one file per track,
+// validated against the track's path, size and mtime like the metadata store.
+void openWaveformCache(const std::string& directory);
+bool hasWaveform(const std::string& filepath);
+bool storeWaveform(const std::string& filepath, const WaveformPyramid& pyramid);
+// Null when the track has no (current) pyramid yet
+std::shared_ptr<const WaveformPyramid> loadWaveform(const std::string& filepath);
@@ -0,0 +1,109 @@
+#include "audio_config.h"
+#include "player.h"
+#include "limiter.h"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <filesystem>
+#include <nlohmann/json.hpp>
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+AudioConfig audioConfig;
+
+static std::string audioConfigPath() {
+    return (configPath / "audio.json").string();
+}
+
+void loadAudioConfig() {
+    std::ifstream file(audioConfigPath());
+    if (!file.is_open()) {
+        std::cout << "No audio config found, using defaults" << std::endl;
+        saveAudioConfig();
+        return;
+    }
+
+    try {
+        json j;
+        file >> j;
+        AudioConfig defaults;
+        audioConfig.streamingEnabled = j.value("streamingEnabled", defaults.streamingEnabled);
+        audioConfig.streamPrerollMs = j.value("streamPrerollMs", defaults.streamPrerollMs);
+        audioConfig.streamBufferMs = j.value("streamBufferMs", defaults.streamBufferMs);
+        audioConfig.gaplessEnabled = j.value("gaplessEnabled", defaults.gaplessEnabled);
+        audioConfig.crossfadeSeconds = j.value("crossfadeSeconds", defaults.crossfadeSeconds);
+        audioConfig.crossfadeCurve = j.value("crossfadeCurve", defaults.crossfadeCurve);
+        audioConfig.skipFadeMs = j.value("skipFadeMs", defaults.skipFadeMs);
+        audioConfig.loudnessMode = j.value("loudnessMode", defaults.loudnessMode);
+        audioConfig.loudnessPreampDb = j.value("loudnessPreampDb", defaults.loudnessPreampDb);
+        audioConfig.limiterEnabled = j.value("limiterEnabled", defaults.limiterEnabled);
+        audioConfig.limiterCeilingDb = j.value("limiterCeilingDb", defaults.limiterCeilingDb);
+        audioConfig.limiterReleaseMs = j.value("limiterReleaseMs", defaults.limiterReleaseMs);
+        audioConfig.limiterLookaheadMs = j.value("limiterLookaheadMs", defaults.limiterLookaheadMs);
+        audioConfig.limiterTruePeak = j.value("limiterTruePeak", defaults.limiterTruePeak);
+        audioConfig.outputSink = j.value("outputSink", defaults.outputSink);
+        audioConfig.outputFile = j.value("outputFile", defaults.outputFile);
+        audioConfig.outputHostApi = j.value("outputHostApi", defaults.outputHostApi);
+        audioConfig.outputDevice = j.value("outputDevice", defaults.outputDevice);
+        audioConfig.framesPerBuffer = j.value("framesPerBuffer", defaults.framesPerBuffer);
+        audioConfig.outputLatencyMs = j.value("outputLatencyMs", defaults.outputLatencyMs);
+        audioConfig.outputSampleFormat = j.value("outputSampleFormat", defaults.outputSampleFormat);
+        audioConfig.outputDither = j.value("outputDither", defaults.outputDither);
+    } catch (const std::exception& e) {
+        std::cerr << "Error loading audio config: " << e.what() << std::endl;
+        audioConfig = AudioConfig();
+    }
+
+    // The ring buffer must be able to hold the whole pre-roll
+    audioConfig.streamPrerollMs = std::clamp(audioConfig.streamPrerollMs, 0, 5000);
+    audioConfig.streamBufferMs = std::max(audioConfig.streamBufferMs, audioConfig.streamPrerollMs * 2);
+    audioConfig.streamBufferMs = std::max(audioConfig.streamBufferMs, 500);
+    audioConfig.crossfadeSeconds = std::clamp(audioConfig.crossfadeSeconds, 0.0f, 12.0f);
+    audioConfig.skipFadeMs = std::clamp(audioConfig.skipFadeMs, 0, 2000);
+    audioConfig.loudnessPreampDb = std::clamp(audioConfig.loudnessPreampDb, -15.0f, 15.0f);
+    audioConfig.limiterCeilingDb = std::clamp(audioConfig.limiterCeilingDb, -12.0f, 0.0f);
+    audioConfig.limiterReleaseMs = std::clamp(audioConfig.limiterReleaseMs, 1.0f, 2000.0f);
+    audioConfig.limiterLookaheadMs = std::clamp(audioConfig.limiterLookaheadMs, 0.1f, Limiter::MAX_LOOKAHEAD_MS);
+    audioConfig.framesPerBuffer = std::clamp(audioConfig.framesPerBuffer, 0, 8192);
+    audioConfig.outputLatencyMs = std::clamp(audioConfig.outputLatencyMs, 0, 1000);
+
+    std::cout << "Loaded audio config (streaming: " << audioConfig.streamingEnabled
+              << ", pre-roll: " << audioConfig.streamPrerollMs << "ms)" << std::endl;
+}
+
+void saveAudioConfig() {
+    fs::path configDir = fs::path(audioConfigPath()).parent_path();
+    if (!fs::exists(configDir)) fs::create_directories(configDir);
+
+    json j = {
+        {"streamingEnabled", audioConfig.streamingEnabled},
+        {"streamPrerollMs", audioConfig.streamPrerollMs},
+        {"streamBufferMs", audioConfig.streamBufferMs},
+        {"gaplessEnabled", audioConfig.gaplessEnabled},
+        {"crossfadeSeconds", audioConfig.crossfadeSeconds},
+        {"crossfadeCurve", audioConfig.crossfadeCurve},
+        {"skipFadeMs", audioConfig.skipFadeMs},
+        {"loudnessMode", audioConfig.loudnessMode},
+        {"loudnessPreampDb", audioConfig.loudnessPreampDb},
+        {"limiterEnabled", audioConfig.limiterEnabled},
+        {"limiterCeilingDb", audioConfig.limiterCeilingDb},
+        {"limiterReleaseMs", audioConfig.limiterReleaseMs},
+        {"limiterLookaheadMs", audioConfig.limiterLookaheadMs},
+        {"limiterTruePeak", audioConfig.limiterTruePeak},
+        {"outputSink", audioConfig.outputSink},
+        {"outputFile", audioConfig.outputFile},
+        {"outputHostApi", audioConfig.outputHostApi},
+        {"outputDevice", audioConfig.outputDevice},
+        {"framesPerBuffer", audioConfig.framesPerBuffer},
+        {"outputLatencyMs", audioConfig.outputLatencyMs},
+        {"outputSampleFormat", audioConfig.outputSampleFormat},
+        {"outputDither", audioConfig.outputDither}
+    };
+
+    std::ofstream file(audioConfigPath());
+    if (file.is_open()) {
+        file << j.dump(4);
+    }
+}
@@ -0,0 +1,178 @@
+#include "audio_probe.h"
+#include "metadata_store.h"
+
+#include <iostream>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <nlohmann/json.hpp>
+
+#include <taglib/fileref.h>
+#include <taglib/tag.h>
+#include <taglib/mpegfile.h>
+#include <taglib/id3v2tag.h>
+#include <taglib/flacfile.h>
+#include <taglib/vorbisfile.h>
+#include <taglib/xiphcomment.h>
+#include <taglib/wavfile.h>
+
+using json = nlohmann::json;
+
+static std::unordered_map<std::string, AudioInfo> probeCache;
+static std::mutex probeMutex;
+
+static bool probeWithTagLib(const std::string& filepath, AudioInfo& info) {
+    TagLib::FileRef ref(filepath.c_str(), true, TagLib::AudioProperties::Average);
+    if (ref.isNull() || !ref.audioProperties()) return false;
+
+    TagLib::AudioProperties* props = ref.audioProperties();
+    if (props->sampleRate() <= 0) return false;
+
+    info.sampleRate = static_cast<float>(props->sampleRate());
+    info.channels = props->channels();
+    info.duration = props->lengthInMilliseconds() / 1000.0f;
+    info.bitrate = props->bitrate();
+
+    if (TagLib::Tag* tag = ref.tag()) {
+        info.title = tag->title().to8Bit(true);
+        info.artist = tag->artist().to8Bit(true);
+        info.album = tag->album().to8Bit(true);
+        info.genre = tag->genre().to8Bit(true);
+        info.year = static_cast<int>(tag->year());
+        info.trackNumber = static_cast<int>(tag->track());
+    }
+
+    TagLib::File* file = ref.file();
+    if (auto* mpeg = dynamic_cast<TagLib::MPEG::File*>(file)) {
+        info.codec = "mp" + std::to_string(mpeg->audioProperties() ? mpeg->audioProperties()->layer() : 3);
+        TagLib::ID3v2::Tag* id3 = mpeg->ID3v2Tag();
+        info.hasCover = id3 && !id3->frameListMap()["APIC"].isEmpty();
+    } else if (auto* flac = dynamic_cast<TagLib::FLAC::File*>(file)) {
+        info.codec = "flac";
+        info.bitDepth = flac->audioProperties() ? flac->audioProperties()->bitsPerSample() : 0;
+        info.hasCover = !flac->pictureList().isEmpty();
+    } else if (auto* vorbis = dynamic_cast<TagLib::Ogg::Vorbis::File*>(file)) {
+        info.codec = "vorbis";
+        info.hasCover = vorbis->tag() && !vorbis->tag()->pictureList().isEmpty();
+    } else if (auto* wav = dynamic_cast<TagLib::RIFF::WAV::File*>(file)) {
+        info.codec = "pcm";
+        info.bitDepth = wav->audioProperties() ? wav->audioProperties()->bitsPerSample() : 0;
+    }
+
+    info.valid = true;
+    return true;
+}
+
+static std::string jsonString(const json& j, const char* key) {
+    if (!j.contains(key)) return "";
+    const json& v = j[key];
+    return v.is_string() ? v.get<std::string>() : v.dump();
+}
+
+// Tag keys differ in case between containers
+static std::string jsonTag(const json& tags, const char* lower, const char* upper) {
+    std::string v = jsonString(tags, lower);
+    return v.empty() ? jsonString(tags, upper) : v;
+}
+
+static bool probeWithFFprobe(const std::string& filepath, AudioInfo& info) {
+    std::string command = "ffprobe -v quiet -print_format json -show_format -show_streams -select_streams a:0 \""
+                        + filepath + "\" 2>/dev/null";
+    std::unique_ptr<FILE, int(*)(FILE*)> pipe(popen(command.c_str(), "r"), pclose);
+    if (!pipe) return false;
+
+    std::string output;
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), pipe.get())) > 0) {
+        output.append(buffer, n);
+    }
+
+    try {
+        json j = json::parse(output);
+        if (!j.contains("streams") || j["streams"].empty()) return false;
+
+        const json& stream = j["streams"][0];
+        const json& format = j.contains("format") ? j["format"] : json::object();
+
+        info.sampleRate = std::stof(jsonString(stream, "sample_rate"));
+        info.channels = stream.value("channels", 2);
+        info.codec = stream.value("codec_name", "");
+
+        std::string duration = jsonString(format, "duration");
+        if (duration.empty()) duration = jsonString(stream, "duration");
+        if (!duration.empty()) info.duration = std::stof(duration);
+
+        std::string bitrate = jsonString(stream, "bit_rate");
+        if (bitrate.empty()) bitrate = jsonString(format, "bit_rate");
+        if (!bitrate.empty()) info.bitrate = std::stoi(bitrate) / 1000;
+
+        std::string bits = jsonString(stream, "bits_per_raw_sample");
+        if (!bits.empty()) info.bitDepth = std::stoi(bits);
+        else info.bitDepth = stream.value("bits_per_sample", 0);
+
+        if (format.contains("tags")) {
+            const json& tags = format["tags"];
+            info.title = jsonTag(tags, "title", "TITLE");
+            info.artist = jsonTag(tags, "artist", "ARTIST");
+            info.album = jsonTag(tags, "album", "ALBUM");
+            info.genre = jsonTag(tags, "genre", "GENRE");
+            info.year = std::atoi(jsonTag(tags, "date", "DATE").c_str());
+            info.trackNumber = std::atoi(jsonTag(tags, "track", "TRACK").c_str());
+        }
+
+        // Attached pictures show up as video streams, which were filtered out above
+        info.hasCover = false;
+        info.valid = info.sampleRate > 0;
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to parse ffprobe output for " << filepath << ": " << e.what() << std::endl;
+        return false;
+    }
+    return info.valid;
+}
+
+AudioInfo probeAudio(const std::string& filepath) {
+    {
+        std::lock_guard<std::mutex> lock(probeMutex);
+        auto it = probeCache.find(filepath);
+        if (it != probeCache.end()) return it->second;
+    }
+
+    AudioInfo info;
+    if (!lookupMetadata(filepath, info)) {
+        if (!probeWithTagLib(filepath, info)) {
+            info = AudioInfo();
+            if (!probeWithFFprobe(filepath, info)) {
+                std::cerr << "Failed to probe: " << filepath << std::endl;
+                info = AudioInfo();
+            }
+        }
+        // Only what was read for sure: a missing backend or a transient error
+        // must not mark the file unreadable across restarts
+        if (info.valid) storeMetadata(filepath, info);
+    }
+
+    // Failed probes are cached until the file is added again, a broken file is not
+    // worth retrying every frame
+    std::lock_guard<std::mutex> lock(probeMutex);
+    probeCache[filepath] = info;
+    return info;
+}
+
+bool findProbedAudio(const std::string& filepath, AudioInfo& info) {
+    {
+        std::lock_guard<std::mutex> lock(probeMutex);
+        auto it = probeCache.find(filepath);
+        if (it != probeCache.end()) {
+            info = it->second;
+            return true;
+        }
+    }
+    return lookupMetadata(filepath, info);
+}
+
+void invalidateProbe(const std::string& filepath) {
+    std::lock_guard<std::mutex> lock(probeMutex);
+    probeCache.erase(filepath);
+}
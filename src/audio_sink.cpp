@@ -0,0 +1,424 @@
+#include "audio_sink.h"
+#include "wav_writer.h"
+#include "sample_format.h"
+#include "ring_buffer.h"
+
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <portaudio.h>
+
+// ================= PortAudio =================
+
+static const char* hostApiName(PaHostApiIndex hostApi) {
+    const PaHostApiInfo* info = Pa_GetHostApiInfo(hostApi);
+    return info ? info->name : "";
+}
+
+// Configured device, or the default output when it is not set or no longer present
+static PaDeviceIndex findOutputDevice(const SinkSettings& settings) {
+    PaHostApiIndex hostApi = Pa_GetDefaultHostApi();
+    if (!settings.hostApi.empty()) {
+        for (PaHostApiIndex i = 0; i < Pa_GetHostApiCount(); ++i) {
+            if (settings.hostApi == hostApiName(i)) hostApi = i;
+        }
+    }
+
+    if (!settings.device.empty()) {
+        for (PaDeviceIndex i = 0; i < Pa_GetDeviceCount(); ++i) {
+            const PaDeviceInfo* info = Pa_GetDeviceInfo(i);
+            if (info && info->maxOutputChannels >= settings.channels && info->hostApi == hostApi &&
+                settings.device == info->name) {
+                return i;
+            }
+        }
+        std::cerr << "Output device not found: " << settings.device << ", using the default" << std::endl;
+    }
+
+    const PaHostApiInfo* hostInfo = Pa_GetHostApiInfo(hostApi);
+    if (hostInfo && hostInfo->defaultOutputDevice != paNoDevice) {
+        return hostInfo->defaultOutputDevice;
+    }
+    return Pa_GetDefaultOutputDevice();
+}
+
+static PaSampleFormat paSampleFormat(SampleFormat format) {
+    switch (format) {
+        case SampleFormat::Float32: return paFloat32;
+        case SampleFormat::Int32: return paInt32;
+        case SampleFormat::Int24: return paInt24;
+        case SampleFormat::Int16: return paInt16;
+    }
+    return paFloat32;
+}
+
+// Integer blocks are rendered here first, then converted into the device buffer
+static const unsigned long CONVERT_FRAMES = 4096;
+
+class PortAudioSink : public AudioSink {
+public:
+    explicit PortAudioSink(const SinkSettings& settings) : settings(settings) {
+        sinkInfo.kind = "portaudio";
+    }
+
+    ~PortAudioSink() override { stop(); }
+
+    bool start(SinkRenderFunction renderFunction) override {
+        render = renderFunction;
+        PaError err = Pa_Initialize();
+        if (err != paNoError) {
+            std::cerr << "PortAudio init failed: " << Pa_GetErrorText(err) << std::endl;
+            return false;
+        }
+        initialized = true;
+
+        PaStreamParameters outputParameters;
+        outputParameters.device = findOutputDevice(settings);
+        if (outputParameters.device == paNoDevice) {
+            std::cerr << "No default output device found" << std::endl;
+            stop();
+            return false;
+        }
+
+        const PaDeviceInfo* deviceInfo = Pa_GetDeviceInfo(outputParameters.device);
+        outputParameters.channelCount = settings.channels;
+        outputParameters.suggestedLatency = settings.latencyMs > 0
+            ? settings.latencyMs / 1000.0
+            : deviceInfo->defaultLowOutputLatency;
+        outputParameters.hostApiSpecificStreamInfo = nullptr;
+        unsigned long framesPerBuffer = settings.framesPerBuffer > 0
+            ? static_cast<unsigned long>(settings.framesPerBuffer)
+            : paFramesPerBufferUnspecified;
+
+        // Preferred format first, then whatever else the device takes
+        SampleFormat format = SampleFormat::Float32;
+        err = paSampleFormatNotSupported;
+        for (SampleFormat candidate : sampleFormatCandidates(settings.sampleFormat)) {
+            outputParameters.sampleFormat = paSampleFormat(candidate);
+            if (Pa_IsFormatSupported(nullptr, &outputParameters, settings.sampleRate) != paFormatIsSupported) {
+                continue;
+            }
+            err = Pa_OpenStream(&stream,
+                                nullptr, // no input
+                                &outputParameters,
+                                settings.sampleRate,
+                                framesPerBuffer,
+                                paClipOff | paDitherOff,   // clipping and dither are ours
+                                &PortAudioSink::callback,
+                                this);
+            if (err == paNoError) {
+                format = candidate;
+                break;
+            }
+            std::cerr << "PortAudio stream open as " << sampleFormatName(candidate) << " failed: "
+                      << Pa_GetErrorText(err) << std::endl;
+        }
+        if (err != paNoError) {
+            std::cerr << "PortAudio stream open failed: " << Pa_GetErrorText(err) << std::endl;
+            stream = nullptr;
+            stop();
+            return false;
+        }
+
+        DitherMode dither = ditherModeFromName(settings.dither);
+        bool dithered = format == SampleFormat::Int16 || format == SampleFormat::Int24;
+        if (format != SampleFormat::Float32) {
+            converter = sampleConverter(format, dither);
+            ditherState = DitherState(settings.channels);
+            scratch.assign(CONVERT_FRAMES * settings.channels, 0.0f);
+            frameBytes = sampleFormatBytes(format) * settings.channels;
+        }
+
+        if (const PaStreamInfo* streamInfo = Pa_GetStreamInfo(stream)) {
+            outputLatency = streamInfo->outputLatency;
+        }
+        sinkInfo.device = deviceInfo->name;
+        sinkInfo.hostApi = hostApiName(deviceInfo->hostApi);
+        sinkInfo.framesPerBuffer = settings.framesPerBuffer;
+        sinkInfo.latencySeconds = outputLatency;
+        sinkInfo.sampleFormat = sampleFormatName(format);
+        sinkInfo.dither = dithered ? ditherModeName(dither) : "off";
+
+        err = Pa_StartStream(stream);
+        if (err != paNoError) {
+            std::cerr << "PortAudio stream start failed: " << Pa_GetErrorText(err) << std::endl;
+            stop();
+            return false;
+        }
+        return true;
+    }
+
+    void stop() override {
+        if (stream) {
+            Pa_StopStream(stream);
+            Pa_CloseStream(stream);
+            stream = nullptr;
+        }
+        converter = nullptr;
+        // PortAudio counts these, devices are rescanned once every user has terminated
+        if (initialized) {
+            Pa_Terminate();
+            initialized = false;
+        }
+    }
+
+    double time() const override {
+        return stream ? Pa_GetStreamTime(stream) : 0.0;
+    }
+
+    double cpuLoad() const override {
+        return stream ? Pa_GetStreamCpuLoad(stream) : 0.0;
+    }
+
+private:
+    static int callback(const void*, void* outputBuffer,
+                        unsigned long framesPerBuffer,
+                        const PaStreamCallbackTimeInfo* timeInfo,
+                        PaStreamCallbackFlags statusFlags,
+                        void* userData) {
+        PortAudioSink* sink = static_cast<PortAudioSink*>(userData);
+
+        SinkBlockInfo info;
+        // Some hosts report no DAC time, estimate it from the stream latency
+        info.dacTime = timeInfo ? timeInfo->outputBufferDacTime : 0.0;
+        if (info.dacTime <= 0.0 && timeInfo && timeInfo->currentTime > 0.0) {
+            info.dacTime = timeInfo->currentTime + sink->outputLatency;
+        }
+        info.underflow = (statusFlags & paOutputUnderflow) != 0;
+        info.overflow = (statusFlags & paOutputOverflow) != 0;
+        info.priming = (statusFlags & paPrimingOutput) != 0;
+
+        if (!sink->converter) {
+            sink->render(static_cast<float*>(outputBuffer), framesPerBuffer, info);
+            return paContinue;
+        }
+
+        // Integer device: render into the float scratch, convert, in slices if the host asks for more
+        uint8_t* out = static_cast<uint8_t*>(outputBuffer);
+        for (unsigned long done = 0; done < framesPerBuffer;) {
+            unsigned long frames = std::min(framesPerBuffer - done, CONVERT_FRAMES);
+            sink->render(sink->scratch.data(), frames, info);
+            sink->converter(sink->scratch.data(), out + done * sink->frameBytes, frames, sink->ditherState);
+            done += frames;
+            if (info.dacTime > 0.0) info.dacTime += frames / sink->settings.sampleRate;
+        }
+        return paContinue;
+    }
+
+    SinkSettings settings;
+    SinkRenderFunction render = nullptr;
+    SampleConverter converter = nullptr;   // null = float32, rendered straight into the device buffer
+    DitherState ditherState;
+    std::vector<float> scratch;
+    size_t frameBytes = 0;
+    PaStream* stream = nullptr;
+    bool initialized = false;
+    double outputLatency = 0.0;   // seconds, used when the host reports no DAC time
+};
+
+std::unique_ptr<AudioSink> createPortAudioSink(const SinkSettings& settings) {
+    return std::make_unique<PortAudioSink>(settings);
+}
+
+// ================= Timer driven sinks =================
+
+// Pulls a block every period on its own thread, paced by the steady clock the
+// way a sound card would. A block is "heard" one period after it is due.
+class TimerSink : public AudioSink {
+public:
+    explicit TimerSink(const SinkSettings& settings) : settings(settings) {
+        if (this->settings.framesPerBuffer <= 0) this->settings.framesPerBuffer = 512;
+        sinkInfo.kind = "null";
+        sinkInfo.device = "Null output";
+        sinkInfo.framesPerBuffer = this->settings.framesPerBuffer;
+        sinkInfo.latencySeconds = this->settings.framesPerBuffer / this->settings.sampleRate;
+    }
+
+    ~TimerSink() override { stop(); }
+
+    bool start(SinkRenderFunction renderFunction) override {
+        if (running) return true;
+        render = renderFunction;
+        startTime = std::chrono::steady_clock::now();
+        running = true;
+        thread = std::thread([this] { run(); });
+        return true;
+    }
+
+    void stop() override {
+        running = false;
+        if (thread.joinable()) thread.join();
+    }
+
+    double time() const override {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    }
+
+    double cpuLoad() const override {
+        return load.load(std::memory_order_relaxed);
+    }
+
+protected:
+    // Called on the sink thread with each rendered block
+    virtual void consume(const float*, unsigned long) {}
+
+    SinkSettings settings;
+
+private:
+    void run() {
+        using clock = std::chrono::steady_clock;
+        const unsigned long frames = static_cast<unsigned long>(settings.framesPerBuffer);
+        const double periodSeconds = frames / settings.sampleRate;
+        const auto period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(periodSeconds));
+        std::vector<float> block(frames * settings.channels);
+
+        clock::time_point due = startTime;
+        bool late = false;
+        double smoothedLoad = 0.0;
+        while (running.load(std::memory_order_relaxed)) {
+            SinkBlockInfo info;
+            info.dacTime = std::chrono::duration<double>(due - startTime).count() + periodSeconds;
+            info.underflow = late;
+
+            auto renderStart = clock::now();
+            render(block.data(), frames, info);
+            double used = std::chrono::duration<double>(clock::now() - renderStart).count() / periodSeconds;
+            smoothedLoad += (used - smoothedLoad) * 0.1;
+            load.store(smoothedLoad, std::memory_order_relaxed);
+
+            consume(block.data(), frames);
+
+            // More than a block behind means a real device would have run dry; start over from now
+            due += period;
+            late = clock::now() > due + period;
+            if (late) due = clock::now();
+            std::this_thread::sleep_until(due);
+        }
+    }
+
+    SinkRenderFunction render = nullptr;
+    std::thread thread;
+    std::atomic<bool> running{false};
+    std::atomic<double> load{0.0};
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+};
+
+// Rendered blocks go through a ring to a writer thread, so a slow disk never
+// holds up the thread that renders
+class FileSink : public TimerSink {
+public:
+    explicit FileSink(const SinkSettings& settings)
+        : TimerSink(settings),
+          writer(settings.filePath, WavFormat::Float32, static_cast<int>(settings.sampleRate), settings.channels),
+          pending(static_cast<size_t>(settings.sampleRate * FILE_BUFFER_SECONDS) * settings.channels) {
+        sinkInfo.kind = "file";
+        sinkInfo.device = settings.filePath;
+    }
+
+    ~FileSink() override {
+        // Both threads have to be gone before the writer is; the writer drains what is left
+        stop();
+        writing = false;
+        if (writerThread.joinable()) writerThread.join();
+        writer.close();
+    }
+
+    bool start(SinkRenderFunction renderFunction) override {
+        if (!writer.isOpen()) {
+            std::cerr << "Could not open output file: " << settings.filePath << std::endl;
+            return false;
+        }
+        if (!writerThread.joinable()) {
+            writing = true;
+            writerThread = std::thread([this] { writeLoop(); });
+        }
+        return TimerSink::start(renderFunction);
+    }
+
+protected:
+    void consume(const float* samples, unsigned long frames) override {
+        size_t count = frames * settings.channels;
+        if (pending.writeAvailable() < count) {
+            dropped.fetch_add(frames, std::memory_order_relaxed);
+            return;
+        }
+        pending.write(samples, count);
+    }
+
+private:
+    static constexpr double FILE_BUFFER_SECONDS = 2.0;
+
+    void writeLoop() {
+        const size_t channels = static_cast<size_t>(settings.channels);
+        const auto period = std::chrono::duration<double>(settings.framesPerBuffer / settings.sampleRate);
+        std::vector<float> chunk(pending.capacity() / 2 / channels * channels);
+        bool failed = false;
+        bool reportedDrop = false;
+
+        while (true) {
+            // Read the flag first so nothing written before stop() is left behind
+            bool last = !writing.load();
+            size_t count = pending.readAvailable() / channels * channels;
+            if (count > 0) {
+                count = pending.read(chunk.data(), std::min(count, chunk.size()));
+                if (!failed && !writer.write(chunk.data(), count / channels)) {
+                    failed = true;
+                    std::cerr << "Writing to " << settings.filePath << " failed" << std::endl;
+                }
+                continue;
+            }
+            if (!reportedDrop && dropped.load(std::memory_order_relaxed) > 0) {
+                reportedDrop = true;
+                std::cerr << "Writing to " << settings.filePath << " fell behind, audio was dropped" << std::endl;
+            }
+            if (last) break;
+            std::this_thread::sleep_for(period);
+        }
+    }
+
+    WavWriter writer;
+    RingBuffer<float> pending;
+    std::thread writerThread;
+    std::atomic<bool> writing{false};
+    std::atomic<unsigned long> dropped{0};
+};
+
+std::unique_ptr<AudioSink> createNullSink(const SinkSettings& settings) {
+    return std::make_unique<TimerSink>(settings);
+}
+
+std::unique_ptr<AudioSink> createFileSink(const SinkSettings& settings) {
+    return std::make_unique<FileSink>(settings);
+}
+
+// ================= Device lists =================
+
+std::vector<std::string> listHostApis() {
+    std::vector<std::string> names;
+    if (Pa_Initialize() != paNoError) return names;
+    for (PaHostApiIndex i = 0; i < Pa_GetHostApiCount(); ++i) {
+        names.push_back(hostApiName(i));
+    }
+    Pa_Terminate();
+    return names;
+}
+
+std::vector<OutputDeviceInfo> listOutputDevices(int channels) {
+    std::vector<OutputDeviceInfo> devices;
+    if (Pa_Initialize() != paNoError) return devices;
+    for (PaDeviceIndex i = 0; i < Pa_GetDeviceCount(); ++i) {
+        const PaDeviceInfo* info = Pa_GetDeviceInfo(i);
+        if (!info || info->maxOutputChannels < channels) continue;
+
+        OutputDeviceInfo device;
+        device.name = info->name;
+        device.hostApi = hostApiName(info->hostApi);
+        device.defaultLowLatencyMs = info->defaultLowOutputLatency * 1000.0;
+        device.defaultHighLatencyMs = info->defaultHighOutputLatency * 1000.0;
+        devices.push_back(device);
+    }
+    Pa_Terminate();
+    return devices;
+}
@@ -0,0 +1,172 @@
+#include "audio_stats.h"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+// ================= Histogram =================
+
+static int highestBit(uint32_t value) {
+    int bit = 0;
+    while (value >>= 1) ++bit;
+    return bit;
+}
+
+int TimingHistogram::bucketIndex(uint32_t value) {
+    int shift = std::max(highestBit(value) - SUB_BUCKET_BITS, 0);
+    return shift * SUB_BUCKETS + static_cast<int>(value >> shift);
+}
+
+uint32_t TimingHistogram::bucketUpperBound(int index) {
+    if (index < 2 * SUB_BUCKETS) return static_cast<uint32_t>(index);
+    int shift = index / SUB_BUCKETS - 1;
+    uint64_t mantissa = index % SUB_BUCKETS + SUB_BUCKETS;
+    return static_cast<uint32_t>(std::min<uint64_t>(((mantissa + 1) << shift) - 1, UINT32_MAX));
+}
+
+void TimingHistogram::record(uint32_t nanos) {
+    std::atomic<uint32_t>& bucket = counts[bucketIndex(nanos)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    total.store(total.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    sum.store(sum.load(std::memory_order_relaxed) + nanos, std::memory_order_relaxed);
+    if (nanos > maxValue.load(std::memory_order_relaxed)) {
+        maxValue.store(nanos, std::memory_order_relaxed);
+    }
+}
+
+void TimingHistogram::reset() {
+    for (auto& bucket : counts) bucket.store(0, std::memory_order_relaxed);
+    total.store(0, std::memory_order_relaxed);
+    sum.store(0, std::memory_order_relaxed);
+    maxValue.store(0, std::memory_order_relaxed);
+}
+
+uint64_t TimingHistogram::count() const {
+    return total.load(std::memory_order_relaxed);
+}
+
+double TimingHistogram::mean() const {
+    uint64_t n = count();
+    return n ? static_cast<double>(sum.load(std::memory_order_relaxed)) / n : 0.0;
+}
+
+uint32_t TimingHistogram::percentile(double p) const {
+    // Buckets are read one by one while the writer goes on, the sum is taken from them
+    uint64_t n = 0;
+    for (const auto& bucket : counts) n += bucket.load(std::memory_order_relaxed);
+    if (n == 0) return 0;
+
+    uint64_t rank = static_cast<uint64_t>(std::clamp(p, 0.0, 100.0) / 100.0 * (n - 1)) + 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; ++i) {
+        seen += counts[i].load(std::memory_order_relaxed);
+        if (seen >= rank) return std::min(bucketUpperBound(i), max());
+    }
+    return max();
+}
+
+// ================= Callback stats =================
+
+static TimingHistogram callbackTimes;
+static TimingHistogram equalizerTimes;
+static std::atomic<uint32_t> lastBudget{0};
+static std::atomic<uint64_t> overruns{0};
+static std::atomic<uint64_t> underflows{0};
+static std::atomic<uint64_t> overflows{0};
+static std::atomic<uint64_t> primingCallbacks{0};
+static std::atomic<bool> resetRequested{false};
+
+// Single writer, so a plain load + store is enough
+static void bump(std::atomic<uint64_t>& counter) {
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+void recordCallbackStats(uint32_t callbackNanos, uint32_t equalizerNanos, uint32_t budgetNanos,
+                         bool underflow, bool overflow, bool priming) {
+    if (resetRequested.load(std::memory_order_relaxed)) {
+        resetRequested.store(false, std::memory_order_relaxed);
+        callbackTimes.reset();
+        equalizerTimes.reset();
+        overruns.store(0, std::memory_order_relaxed);
+        underflows.store(0, std::memory_order_relaxed);
+        overflows.store(0, std::memory_order_relaxed);
+        primingCallbacks.store(0, std::memory_order_relaxed);
+    }
+
+    callbackTimes.record(callbackNanos);
+    equalizerTimes.record(equalizerNanos);
+    lastBudget.store(budgetNanos, std::memory_order_relaxed);
+    if (callbackNanos > budgetNanos) bump(overruns);
+    if (underflow) bump(underflows);
+    if (overflow) bump(overflows);
+    if (priming) bump(primingCallbacks);
+}
+
+static TimingSummary summarize(const TimingHistogram& histogram) {
+    TimingSummary summary;
+    summary.count = histogram.count();
+    summary.meanUs = histogram.mean() / 1000.0;
+    summary.p50Us = histogram.percentile(50.0) / 1000.0;
+    summary.p90Us = histogram.percentile(90.0) / 1000.0;
+    summary.p99Us = histogram.percentile(99.0) / 1000.0;
+    summary.p999Us = histogram.percentile(99.9) / 1000.0;
+    summary.maxUs = histogram.max() / 1000.0;
+    return summary;
+}
+
+AudioStatsReport getAudioStats() {
+    AudioStatsReport report;
+    report.callback = summarize(callbackTimes);
+    report.equalizer = summarize(equalizerTimes);
+    report.budgetUs = lastBudget.load(std::memory_order_relaxed) / 1000.0;
+    report.overruns = overruns.load(std::memory_order_relaxed);
+    report.underflows = underflows.load(std::memory_order_relaxed);
+    report.overflows = overflows.load(std::memory_order_relaxed);
+    report.primingCallbacks = primingCallbacks.load(std::memory_order_relaxed);
+    return report;
+}
+
+void resetAudioStats() {
+    resetRequested.store(true, std::memory_order_relaxed);
+}
+
+static json summaryToJson(const TimingSummary& summary) {
+    return {
+        {"count", summary.count},
+        {"meanUs", summary.meanUs},
+        {"p50Us", summary.p50Us},
+        {"p90Us", summary.p90Us},
+        {"p99Us", summary.p99Us},
+        {"p999Us", summary.p999Us},
+        {"maxUs", summary.maxUs}
+    };
+}
+
+bool dumpAudioStats(const std::string& path, double cpuLoad) {
+    AudioStatsReport report = getAudioStats();
+    if (report.callback.count == 0) return false;
+
+    json j = {
+        {"callback", summaryToJson(report.callback)},
+        {"equalizer", summaryToJson(report.equalizer)},
+        {"budgetUs", report.budgetUs},
+        {"overruns", report.overruns},
+        {"underflows", report.underflows},
+        {"overflows", report.overflows},
+        {"primingCallbacks", report.primingCallbacks},
+        {"cpuLoad", cpuLoad}
+    };
+
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Could not write audio stats: " << path << std::endl;
+        return false;
+    }
+    file << j.dump(4);
+    std::cout << "Audio stats written to " << path << " (p99 callback " << report.callback.p99Us
+              << " us of " << report.budgetUs << " us, " << report.underflows << " underflows)" << std::endl;
+    return true;
+}
@@ -0,0 +1,101 @@
+#include "audio_stream.h"
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+// Frames pulled from the decoder per read
+static const size_t DECODE_CHUNK_FRAMES = 4096;
+
+AudioStream::AudioStream(float sr, int ch, int bufferMs, int prerollMs)
+    : sampleRate(sr), channels(ch) {
+    size_t capacityFrames = static_cast<size_t>(sampleRate * bufferMs / 1000.0f);
+    capacityFrames = std::max(capacityFrames, DECODE_CHUNK_FRAMES * 2);
+    ring.resize(capacityFrames * channels);
+
+    prerollFrames = static_cast<size_t>(sampleRate * prerollMs / 1000.0f);
+    prerollFrames = std::min(prerollFrames, ring.capacity() / channels - DECODE_CHUNK_FRAMES);
+}
+
+AudioStream::~AudioStream() {
+    close();
+}
+
+bool AudioStream::open(const std::string& path, float start) {
+    close();
+
+    filepath = path;
+    startSeconds = std::max(start, 0.0f);
+    stopRequested = false;
+    endOfStream = false;
+    framesDecoded = 0;
+    framesPlayed = 0;
+    ring.resize(ring.capacity());
+
+    decoder = openDecoder(filepath, static_cast<int>(sampleRate), channels);
+    if (!decoder) {
+        return false;
+    }
+    if (startSeconds > 0.0f && !decoder->seek(startSeconds)) {
+        std::cerr << "Seek failed in: " << filepath << std::endl;
+        return false;
+    }
+    trackFrames = decoder->totalFrames();
+
+    decoderThread = std::thread(&AudioStream::decodeLoop, this);
+    return true;
+}
+
+void AudioStream::close() {
+    stopRequested = true;
+    if (decoderThread.joinable()) {
+        decoderThread.join();
+    }
+    decoder.reset();
+}
+
+void AudioStream::decodeLoop() {
+    std::vector<float> chunk(DECODE_CHUNK_FRAMES * channels);
+
+    while (!stopRequested) {
+        // Wait for the callback to free some space
+        if (ring.writeAvailable() < chunk.size()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            continue;
+        }
+
+        size_t frames = decoder->read(chunk.data(), DECODE_CHUNK_FRAMES);
+        ring.write(chunk.data(), frames * channels);
+        framesDecoded += frames;
+
+        if (frames == 0) {
+            break;
+        }
+    }
+
+    endOfStream = true;
+
+    if (!stopRequested) {
+        std::cout << "Stream decoded: " << framesDecoded.load() << " frames ("
+                  << framesDecoded.load() / sampleRate << "s)" << std::endl;
+    }
+}
+
+size_t AudioStream::read(float* out, size_t frames) {
+    size_t framesRead = ring.read(out, frames * channels) / channels;
+    framesPlayed.fetch_add(framesRead, std::memory_order_relaxed);
+    return framesRead;
+}
+
+bool AudioStream::isReady() const {
+    return endOfStream.load() || bufferedFrames() >= prerollFrames;
+}
+
+bool AudioStream::isFinished() const {
+    return endOfStream.load() && ring.readAvailable() == 0;
+}
+
+size_t AudioStream::bufferedFrames() const {
+    return ring.readAvailable() / channels;
+}
@@ -0,0 +1,388 @@
+#include "decoder.h"
+#include "audio_probe.h"
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+// ================= FFmpeg fallback =================
+
+// One argument for popen's shell, whatever the path contains
+static std::string shellQuote(const std::string& text) {
+#ifdef _WIN32
+    return "\"" + text + "\"";   // cmd.exe; Windows paths can't contain quotes
+#else
+    std::string quoted = "'";
+    for (char c : text) {
+        if (c == '\'') quoted += "'\\''";
+        else quoted += c;
+    }
+    return quoted + "'";
+#endif
+}
+
+// Decodes through an ffmpeg subprocess writing float32 PCM to a pipe
+class FFmpegDecoder : public Decoder {
+public:
+    FFmpegDecoder(int sampleRate, int channels) {
+        rate = sampleRate;
+        channelCount = channels;
+    }
+
+    ~FFmpegDecoder() override {
+        closePipe();
+    }
+
+    bool open(const std::string& path) override {
+        filepath = path;
+        frameCount = probeFrames();
+        if (!startAt(0.0)) return false;
+
+        // ffmpeg starts for any path; only decoded audio tells it could read the file
+        peeked.resize(PEEK_FRAMES * channelCount);
+        peeked.resize(fread(peeked.data(), sizeof(float), peeked.size(), pipe) / channelCount * channelCount);
+        peekedPos = 0;
+        if (peeked.empty()) {
+            std::cerr << "ffmpeg could not decode: " << filepath << std::endl;
+            closePipe();
+            return false;
+        }
+        return true;
+    }
+
+    size_t read(float* out, size_t frames) override {
+        if (!pipe) return 0;
+        size_t wanted = frames * channelCount;
+        size_t samples = std::min(wanted, peeked.size() - peekedPos);
+        std::copy(peeked.begin() + peekedPos, peeked.begin() + peekedPos + samples, out);
+        peekedPos += samples;
+        if (samples < wanted) {
+            samples += fread(out + samples, sizeof(float), wanted - samples, pipe);
+        }
+        return samples / channelCount;
+    }
+
+    bool seek(double seconds) override {
+        return startAt(seconds);
+    }
+
+    const char* name() const override { return "ffmpeg"; }
+
+private:
+    static const size_t PEEK_FRAMES = 1024;
+
+    bool startAt(double seconds) {
+        closePipe();
+        peeked.clear();
+        peekedPos = 0;
+
+        // -ss before -i makes ffmpeg seek in the input instead of decoding up to the position
+        std::string command = "ffmpeg -v quiet";
+        if (seconds > 0.0) command += " -ss " + std::to_string(seconds);
+        command += " -i " + shellQuote(filepath) + " -f f32le -acodec pcm_f32le -ac " + std::to_string(channelCount)
+                 + " -ar " + std::to_string(rate) + " - 2>/dev/null";
+
+        pipe = popen(command.c_str(), "r");
+        if (!pipe) {
+            std::cerr << "Failed to start ffmpeg for: " << filepath << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    uint64_t probeFrames() {
+        AudioInfo info = probeAudio(filepath);
+        return info.duration > 0.0f ? static_cast<uint64_t>(info.duration * rate) : 0;
+    }
+
+    void closePipe() {
+        if (pipe) {
+            // ffmpeg gets EPIPE on its next write and exits
+            pclose(pipe);
+            pipe = nullptr;
+        }
+    }
+
+    std::string filepath;
+    FILE* pipe = nullptr;
+    std::vector<float> peeked;   // first block, read by open()
+    size_t peekedPos = 0;
+};
+
+std::unique_ptr<Decoder> createFFmpegDecoder(int sampleRate, int channels) {
+    return std::make_unique<FFmpegDecoder>(sampleRate, channels);
+}
+
+// ================= Format conversion =================
+
+// Windowed-sinc interpolation kernel, tabulated
+static const int SINC_HALF_TAPS = 16;
+static const int SINC_PHASES = 256;
+
+// Converts any backend's output to the engine sample rate and channel count
+class ConvertingDecoder : public Decoder {
+public:
+    ConvertingDecoder(std::unique_ptr<Decoder> src, int sampleRate, int channels)
+        : source(std::move(src)) {
+        rate = sampleRate;
+        channelCount = channels;
+        frameCount = source->sampleRate() > 0
+            ? static_cast<uint64_t>(static_cast<double>(source->totalFrames()) * rate / source->sampleRate())
+            : 0;
+
+        buildChannelMatrix();
+
+        resampling = source->sampleRate() != rate;
+        if (resampling) {
+            step = static_cast<double>(source->sampleRate()) / rate;
+            buildKernel(std::min(1.0, 1.0 / step));
+            resetResampler();
+        }
+    }
+
+    bool open(const std::string&) override { return true; }
+
+    size_t read(float* out, size_t frames) override {
+        if (!resampling) {
+            return readMapped(out, frames);
+        }
+
+        size_t produced = 0;
+        while (produced < frames) {
+            size_t ipos = static_cast<size_t>(pos);
+            if (sourceDone && ipos >= inputEnd) break;
+
+            // Need SINC_HALF_TAPS frames of look-ahead after the current position
+            if (ipos + SINC_HALF_TAPS >= bufferedFrames()) {
+                fillInput();
+                continue;
+            }
+
+            double frac = pos - ipos;
+            float* dst = out + produced * channelCount;
+            std::fill(dst, dst + channelCount, 0.0f);
+
+            for (int k = -SINC_HALF_TAPS + 1; k <= SINC_HALF_TAPS; ++k) {
+                float w = kernelAt(k - frac);
+                const float* src = &input[(ipos + k) * channelCount];
+                for (int ch = 0; ch < channelCount; ++ch) {
+                    dst[ch] += src[ch] * w;
+                }
+            }
+
+            ++produced;
+            pos += step;
+        }
+
+        // Drop consumed input, keeping the left half of the kernel as history
+        size_t consumed = static_cast<size_t>(pos);
+        if (consumed > 4096 + SINC_HALF_TAPS) {
+            size_t drop = consumed - SINC_HALF_TAPS;
+            input.erase(input.begin(), input.begin() + drop * channelCount);
+            pos -= drop;
+            inputEnd -= std::min(inputEnd, drop);
+        }
+
+        return produced;
+    }
+
+    bool seek(double seconds) override {
+        if (!source->seek(seconds)) return false;
+        if (resampling) resetResampler();
+        return true;
+    }
+
+    const char* name() const override { return source->name(); }
+
+private:
+    // Reads from the source and maps its channels to ours
+    size_t readMapped(float* out, size_t frames) {
+        int srcChannels = source->channels();
+        if (srcChannels == channelCount) {
+            return source->read(out, frames);
+        }
+
+        native.resize(frames * srcChannels);
+        size_t got = source->read(native.data(), frames);
+        for (size_t i = 0; i < got; ++i) {
+            const float* src = &native[i * srcChannels];
+            float* dst = &out[i * channelCount];
+            for (int ch = 0; ch < channelCount; ++ch) {
+                float sum = 0.0f;
+                for (int s = 0; s < srcChannels; ++s) {
+                    sum += src[s] * matrix[ch * srcChannels + s];
+                }
+                dst[ch] = sum;
+            }
+        }
+        return got;
+    }
+
+    // Appends decoded frames to the resampler input, pads with silence at the end
+    void fillInput() {
+        const size_t chunk = 2048;
+        size_t old = bufferedFrames();
+        input.resize((old + chunk) * channelCount);
+
+        size_t got = readMapped(&input[old * channelCount], chunk);
+        if (got == 0) {
+            // Trailing zeros let the kernel run past the last real frame
+            sourceDone = true;
+            inputEnd = old;
+            input.resize(old * channelCount);
+            input.resize((old + SINC_HALF_TAPS * 2) * channelCount, 0.0f);
+            return;
+        }
+
+        input.resize((old + got) * channelCount);
+        inputEnd = old + got;
+    }
+
+    size_t bufferedFrames() const { return input.size() / channelCount; }
+
+    void resetResampler() {
+        // Silence on the left so the first output frame has full history
+        input.assign(SINC_HALF_TAPS * channelCount, 0.0f);
+        pos = SINC_HALF_TAPS;
+        inputEnd = SINC_HALF_TAPS;
+        sourceDone = false;
+    }
+
+    void buildKernel(double cutoff) {
+        kernel.resize(SINC_HALF_TAPS * 2 * SINC_PHASES + 1);
+        for (size_t i = 0; i < kernel.size(); ++i) {
+            double x = static_cast<double>(i) / SINC_PHASES - SINC_HALF_TAPS;
+            double sinc = (x == 0.0) ? 1.0 : std::sin(M_PI * x * cutoff) / (M_PI * x * cutoff);
+            // Blackman window over [-SINC_HALF_TAPS, SINC_HALF_TAPS]
+            double t = (x + SINC_HALF_TAPS) / (2.0 * SINC_HALF_TAPS);
+            double window = 0.42 - 0.5 * std::cos(2.0 * M_PI * t) + 0.08 * std::cos(4.0 * M_PI * t);
+            kernel[i] = static_cast<float>(cutoff * sinc * window);
+        }
+    }
+
+    float kernelAt(double x) const {
+        double idx = (x + SINC_HALF_TAPS) * SINC_PHASES;
+        if (idx <= 0.0 || idx >= kernel.size() - 1) return 0.0f;
+        size_t i = static_cast<size_t>(idx);
+        float f = static_cast<float>(idx - i);
+        return kernel[i] + (kernel[i + 1] - kernel[i]) * f;
+    }
+
+    void buildChannelMatrix() {
+        int srcChannels = source->channels();
+        matrix.assign(channelCount * srcChannels, 0.0f);
+
+        if (channelCount == 1) {
+            for (int s = 0; s < srcChannels; ++s) matrix[s] = 1.0f / srcChannels;
+            return;
+        }
+
+        if (srcChannels == 1) {
+            for (int ch = 0; ch < channelCount; ++ch) matrix[ch] = 1.0f;
+            return;
+        }
+
+        // Left/right gains for each WAVE-order source channel
+        const float c = 0.7071f;
+        static const float downmix[8][2] = {
+            {1, 0}, {0, 1},   // FL, FR
+            {c, c}, {0, 0},   // FC, LFE
+            {c, 0}, {0, c},   // BL, BR
+            {c, 0}, {0, c}    // SL, SR
+        };
+
+        for (int ch = 0; ch < std::min(channelCount, 2); ++ch) {
+            float sum = 0.0f;
+            for (int s = 0; s < srcChannels && s < 8; ++s) {
+                // 7 channel layouts carry a single back centre in slot 4
+                float g = (srcChannels == 7 && s == 4) ? 0.5f : downmix[s][ch];
+                matrix[ch * srcChannels + s] = g;
+                sum += g;
+            }
+            // Keep a full-scale signal from clipping after the fold-down
+            for (int s = 0; s < srcChannels; ++s) matrix[ch * srcChannels + s] /= sum;
+        }
+    }
+
+    std::unique_ptr<Decoder> source;
+    std::vector<float> matrix;   // [channel][source channel]
+    std::vector<float> native;
+
+    bool resampling = false;
+    double step = 1.0;           // input frames per output frame
+    double pos = 0.0;            // read position in input
+    size_t inputEnd = 0;         // frames of real audio in input
+    bool sourceDone = false;
+    std::vector<float> input;
+    std::vector<float> kernel;
+};
+
+// ================= Factory =================
+
+enum class ContainerType { Unknown, Wav, Flac, Mp3, Ogg };
+
+static ContainerType detectContainer(const std::string& filepath) {
+    std::ifstream file(filepath, std::ios::binary);
+    std::array<unsigned char, 12> header{};
+    if (file.read(reinterpret_cast<char*>(header.data()), header.size())) {
+        if (!std::memcmp(header.data(), "RIFF", 4) && !std::memcmp(header.data() + 8, "WAVE", 4)) return ContainerType::Wav;
+        if (!std::memcmp(header.data(), "fLaC", 4)) return ContainerType::Flac;
+        if (!std::memcmp(header.data(), "OggS", 4)) return ContainerType::Ogg;
+        if (!std::memcmp(header.data(), "ID3", 3)) return ContainerType::Mp3;
+        if (header[0] == 0xFF && (header[1] & 0xE0) == 0xE0) return ContainerType::Mp3;
+    }
+
+    std::string ext = fs::path(filepath).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    if (ext == ".wav") return ContainerType::Wav;
+    if (ext == ".flac") return ContainerType::Flac;
+    if (ext == ".mp3") return ContainerType::Mp3;
+    if (ext == ".ogg" || ext == ".oga") return ContainerType::Ogg;
+    return ContainerType::Unknown;
+}
+
+std::unique_ptr<Decoder> createDecoder(const std::string& filepath, int fallbackRate, int fallbackChannels) {
+    std::unique_ptr<Decoder> decoder;
+    switch (detectContainer(filepath)) {
+        case ContainerType::Wav:  decoder = createWavDecoder(); break;
+        case ContainerType::Flac: decoder = createFlacDecoder(); break;
+        case ContainerType::Mp3:  decoder = createMp3Decoder(); break;
+        case ContainerType::Ogg:  decoder = createVorbisDecoder(); break;
+        default: break;
+    }
+
+    if (decoder && decoder->open(filepath) && decoder->channels() > 0 && decoder->sampleRate() > 0) {
+        return decoder;
+    }
+
+    // Exotic container or a backend that is not compiled in
+    decoder = createFFmpegDecoder(fallbackRate, fallbackChannels);
+    if (decoder->open(filepath)) {
+        return decoder;
+    }
+    return nullptr;
+}
+
+std::unique_ptr<Decoder> openDecoder(const std::string& filepath, int sampleRate, int channels) {
+    std::unique_ptr<Decoder> decoder = createDecoder(filepath, sampleRate, channels);
+    if (!decoder) {
+        std::cerr << "No decoder could open: " << filepath << std::endl;
+        return nullptr;
+    }
+
+    std::cout << "Decoder: " << decoder->name() << " (" << decoder->sampleRate() << " Hz, "
+              << decoder->channels() << " ch)" << std::endl;
+
+    if (decoder->sampleRate() == sampleRate && decoder->channels() == channels) {
+        return decoder;
+    }
+    return std::make_unique<ConvertingDecoder>(std::move(decoder), sampleRate, channels);
+}
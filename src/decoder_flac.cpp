@@ -0,0 +1,125 @@
+#include "decoder.h"
+
+#ifdef YABOKU_HAVE_FLAC
+
+#include <FLAC/stream_decoder.h>
+
+#include <vector>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+
+// libFLAC stream decoder, one FLAC frame is decoded at a time into a pending buffer
+class FlacDecoder : public Decoder {
+public:
+    ~FlacDecoder() override {
+        if (decoder) {
+            FLAC__stream_decoder_finish(decoder);
+            FLAC__stream_decoder_delete(decoder);
+        }
+    }
+
+    bool open(const std::string& filepath) override {
+        decoder = FLAC__stream_decoder_new();
+        if (!decoder) return false;
+
+        FLAC__StreamDecoderInitStatus status = FLAC__stream_decoder_init_file(
+            decoder, filepath.c_str(), writeCallback, metadataCallback, errorCallback, this);
+        if (status != FLAC__STREAM_DECODER_INIT_STATUS_OK) {
+            std::cerr << "FLAC init failed: " << FLAC__StreamDecoderInitStatusString[status] << std::endl;
+            return false;
+        }
+
+        // STREAMINFO is mandatory and always the first metadata block
+        if (!FLAC__stream_decoder_process_until_end_of_metadata(decoder)) return false;
+        return rate > 0 && channelCount > 0;
+    }
+
+    size_t read(float* out, size_t frames) override {
+        size_t produced = 0;
+        while (produced < frames) {
+            size_t available = pending.size() / channelCount - pendingPos;
+            if (available == 0) {
+                pending.clear();
+                pendingPos = 0;
+                if (FLAC__stream_decoder_get_state(decoder) == FLAC__STREAM_DECODER_END_OF_STREAM) break;
+                if (!FLAC__stream_decoder_process_single(decoder)) break;
+                if (pending.empty() && FLAC__stream_decoder_get_state(decoder) == FLAC__STREAM_DECODER_END_OF_STREAM) break;
+                continue;
+            }
+
+            size_t count = std::min(available, frames - produced);
+            std::memcpy(out + produced * channelCount, &pending[pendingPos * channelCount],
+                        count * channelCount * sizeof(float));
+            pendingPos += count;
+            produced += count;
+        }
+        return produced;
+    }
+
+    bool seek(double seconds) override {
+        pending.clear();
+        pendingPos = 0;
+        FLAC__uint64 target = static_cast<FLAC__uint64>(seconds * rate);
+        if (frameCount > 0) target = std::min<FLAC__uint64>(target, frameCount - 1);
+
+        // The write callback receives the frame containing the target sample
+        if (!FLAC__stream_decoder_seek_absolute(decoder, target)) {
+            if (FLAC__stream_decoder_get_state(decoder) == FLAC__STREAM_DECODER_SEEK_ERROR) {
+                FLAC__stream_decoder_flush(decoder);
+            }
+            return false;
+        }
+        return true;
+    }
+
+    const char* name() const override { return "flac"; }
+
+private:
+    static FLAC__StreamDecoderWriteStatus writeCallback(const FLAC__StreamDecoder*, const FLAC__Frame* frame,
+                                                        const FLAC__int32* const buffer[], void* clientData) {
+        auto* self = static_cast<FlacDecoder*>(clientData);
+        unsigned blocksize = frame->header.blocksize;
+        unsigned channels = std::min<unsigned>(frame->header.channels, self->channelCount);
+        float scale = 1.0f / static_cast<float>(1u << (frame->header.bits_per_sample - 1));
+
+        size_t base = self->pending.size();
+        self->pending.resize(base + blocksize * self->channelCount, 0.0f);
+        float* dst = &self->pending[base];
+        for (unsigned i = 0; i < blocksize; ++i) {
+            for (unsigned ch = 0; ch < channels; ++ch) {
+                dst[i * self->channelCount + ch] = buffer[ch][i] * scale;
+            }
+        }
+        return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+    }
+
+    static void metadataCallback(const FLAC__StreamDecoder*, const FLAC__StreamMetadata* metadata, void* clientData) {
+        auto* self = static_cast<FlacDecoder*>(clientData);
+        if (metadata->type == FLAC__METADATA_TYPE_STREAMINFO) {
+            self->rate = metadata->data.stream_info.sample_rate;
+            self->channelCount = metadata->data.stream_info.channels;
+            self->frameCount = metadata->data.stream_info.total_samples;
+        }
+    }
+
+    static void errorCallback(const FLAC__StreamDecoder*, FLAC__StreamDecoderErrorStatus status, void*) {
+        std::cerr << "FLAC decode error: " << FLAC__StreamDecoderErrorStatusString[status] << std::endl;
+    }
+
+    FLAC__StreamDecoder* decoder = nullptr;
+    std::vector<float> pending;
+    size_t pendingPos = 0;
+};
+
+std::unique_ptr<Decoder> createFlacDecoder() {
+    return std::make_unique<FlacDecoder>();
+}
+
+#else
+
+std::unique_ptr<Decoder> createFlacDecoder() {
+    return nullptr;
+}
+
+#endif
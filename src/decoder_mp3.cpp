@@ -0,0 +1,109 @@
+#include "decoder.h"
+
+#ifdef YABOKU_HAVE_MPG123
+
+#include <mpg123.h>
+
+#include <vector>
+#include <mutex>
+#include <iostream>
+
+// libmpg123 decoder. Encoder delay and padding are removed (gapless flag is
+// on by default), output is float when the library supports it.
+class Mp3Decoder : public Decoder {
+public:
+    ~Mp3Decoder() override {
+        if (handle) {
+            mpg123_close(handle);
+            mpg123_delete(handle);
+        }
+    }
+
+    bool open(const std::string& filepath) override {
+        static std::once_flag initFlag;
+        std::call_once(initFlag, []() { mpg123_init(); });
+
+        int err = MPG123_OK;
+        handle = mpg123_new(nullptr, &err);
+        if (!handle) return false;
+
+        mpg123_param(handle, MPG123_ADD_FLAGS, MPG123_QUIET, 0.0);
+        if (mpg123_open(handle, filepath.c_str()) != MPG123_OK) {
+            std::cerr << "mpg123 open failed: " << mpg123_strerror(handle) << std::endl;
+            return false;
+        }
+
+        long sampleRate = 0;
+        int channels = 0;
+        int encoding = 0;
+        if (mpg123_getformat(handle, &sampleRate, &channels, &encoding) != MPG123_OK) return false;
+
+        // Lock the output format so it can't change mid-stream
+        mpg123_format_none(handle);
+        if (mpg123_format(handle, sampleRate, channels, MPG123_ENC_FLOAT_32) == MPG123_OK) {
+            floatOutput = true;
+        } else if (mpg123_format(handle, sampleRate, channels, MPG123_ENC_SIGNED_16) != MPG123_OK) {
+            return false;
+        }
+
+        rate = static_cast<int>(sampleRate);
+        channelCount = channels;
+
+        // Exact from the Xing/LAME header when present, estimated otherwise
+        off_t length = mpg123_length(handle);
+        frameCount = length > 0 ? static_cast<uint64_t>(length) : 0;
+        return true;
+    }
+
+    size_t read(float* out, size_t frames) override {
+        size_t produced = 0;
+        while (produced < frames) {
+            size_t done = 0;
+            int result;
+            if (floatOutput) {
+                size_t bytes = (frames - produced) * channelCount * sizeof(float);
+                result = mpg123_read(handle, reinterpret_cast<unsigned char*>(out + produced * channelCount), bytes, &done);
+                produced += done / (channelCount * sizeof(float));
+            } else {
+                scratch.resize((frames - produced) * channelCount);
+                result = mpg123_read(handle, reinterpret_cast<unsigned char*>(scratch.data()),
+                                     scratch.size() * sizeof(int16_t), &done);
+                size_t samples = done / sizeof(int16_t);
+                float* dst = out + produced * channelCount;
+                for (size_t i = 0; i < samples; ++i) dst[i] = scratch[i] / 32768.0f;
+                produced += samples / channelCount;
+            }
+
+            if (result == MPG123_DONE) break;
+            if (result != MPG123_OK && result != MPG123_NEW_FORMAT) {
+                std::cerr << "mpg123 read error: " << mpg123_strerror(handle) << std::endl;
+                break;
+            }
+        }
+        return produced;
+    }
+
+    bool seek(double seconds) override {
+        off_t target = static_cast<off_t>(seconds * rate);
+        return mpg123_seek(handle, target, SEEK_SET) >= 0;
+    }
+
+    const char* name() const override { return "mpg123"; }
+
+private:
+    mpg123_handle* handle = nullptr;
+    bool floatOutput = false;
+    std::vector<int16_t> scratch;
+};
+
+std::unique_ptr<Decoder> createMp3Decoder() {
+    return std::make_unique<Mp3Decoder>();
+}
+
+#else
+
+std::unique_ptr<Decoder> createMp3Decoder() {
+    return nullptr;
+}
+
+#endif
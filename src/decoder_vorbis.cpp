@@ -0,0 +1,88 @@
+#include "decoder.h"
+
+#ifdef YABOKU_HAVE_VORBIS
+
+#include <vorbis/vorbisfile.h>
+
+#include <iostream>
+
+// Ogg Vorbis through libvorbisfile. Vorbis channel order is remapped to WAVE order.
+class VorbisDecoder : public Decoder {
+public:
+    ~VorbisDecoder() override {
+        if (opened) ov_clear(&file);
+    }
+
+    bool open(const std::string& filepath) override {
+        if (ov_fopen(filepath.c_str(), &file) != 0) return false;
+        opened = true;
+
+        vorbis_info* info = ov_info(&file, -1);
+        if (!info) return false;
+        rate = static_cast<int>(info->rate);
+        channelCount = info->channels;
+
+        ogg_int64_t total = ov_pcm_total(&file, -1);
+        frameCount = total > 0 ? static_cast<uint64_t>(total) : 0;
+        return channelCount > 0 && channelCount <= 8;
+    }
+
+    size_t read(float* out, size_t frames) override {
+        static const int order[9][8] = {
+            {},
+            {0},
+            {0, 1},
+            {0, 2, 1},                   // L C R         -> L R C
+            {0, 1, 2, 3},                // FL FR RL RR
+            {0, 2, 1, 3, 4},             // FL C FR RL RR -> FL FR C RL RR
+            {0, 2, 1, 5, 3, 4},          // + LFE last    -> FL FR C LFE RL RR
+            {0, 2, 1, 6, 5, 3, 4},       // FL C FR SL SR RC LFE -> FL FR C LFE RC SL SR
+            {0, 2, 1, 7, 5, 6, 3, 4}     // FL C FR SL SR RL RR LFE -> FL FR C LFE RL RR SL SR
+        };
+        const int* map = order[channelCount];
+
+        size_t produced = 0;
+        while (produced < frames) {
+            float** pcm = nullptr;
+            long got = ov_read_float(&file, &pcm, static_cast<int>(frames - produced), &section);
+            if (got == OV_HOLE) continue;   // recoverable gap in the data
+            if (got <= 0) break;
+
+            // Chained streams may switch layout, we stop instead of guessing
+            vorbis_info* info = ov_info(&file, -1);
+            if (info && info->channels != channelCount) break;
+
+            float* dst = out + produced * channelCount;
+            for (long i = 0; i < got; ++i) {
+                for (int ch = 0; ch < channelCount; ++ch) {
+                    dst[i * channelCount + ch] = pcm[map[ch]][i];
+                }
+            }
+            produced += got;
+        }
+        return produced;
+    }
+
+    bool seek(double seconds) override {
+        return ov_pcm_seek(&file, static_cast<ogg_int64_t>(seconds * rate)) == 0;
+    }
+
+    const char* name() const override { return "vorbis"; }
+
+private:
+    OggVorbis_File file{};
+    bool opened = false;
+    int section = 0;
+};
+
+std::unique_ptr<Decoder> createVorbisDecoder() {
+    return std::make_unique<VorbisDecoder>();
+}
+
+#else
+
+std::unique_ptr<Decoder> createVorbisDecoder() {
+    return nullptr;
+}
+
+#endif
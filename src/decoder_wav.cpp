@@ -0,0 +1,162 @@
+#include "decoder.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <cstdint>
+#include <iostream>
+#include <algorithm>
+
+// RIFF/WAVE reader: PCM 8/16/24/32 bit, IEEE float 32/64 bit, WAVE_FORMAT_EXTENSIBLE
+class WavDecoder : public Decoder {
+public:
+    ~WavDecoder() override {
+        if (file) fclose(file);
+    }
+
+    bool open(const std::string& filepath) override {
+        file = fopen(filepath.c_str(), "rb");
+        if (!file) return false;
+
+        char riff[12];
+        if (fread(riff, 1, 12, file) != 12 || std::memcmp(riff, "RIFF", 4) || std::memcmp(riff + 8, "WAVE", 4)) {
+            return false;
+        }
+
+        bool haveFormat = false;
+        char id[4];
+        uint32_t size;
+        while (fread(id, 1, 4, file) == 4 && readU32(size)) {
+            long next = ftell(file) + size + (size & 1);
+
+            if (!std::memcmp(id, "fmt ", 4)) {
+                haveFormat = parseFormat(size);
+            } else if (!std::memcmp(id, "data", 4)) {
+                if (!haveFormat) return false;
+                dataStart = ftell(file);
+                dataBytes = size;
+                // Streams written on the fly often leave the size at 0 or 0xFFFFFFFF
+                if (dataBytes == 0 || dataBytes == 0xFFFFFFFF) {
+                    fseek(file, 0, SEEK_END);
+                    dataBytes = ftell(file) - dataStart;
+                    fseek(file, dataStart, SEEK_SET);
+                }
+                frameCount = dataBytes / frameBytes;
+                return true;
+            }
+
+            if (fseek(file, next, SEEK_SET) != 0) break;
+        }
+        return false;
+    }
+
+    size_t read(float* out, size_t frames) override {
+        frames = std::min<uint64_t>(frames, frameCount - framePos);
+        if (frames == 0) return 0;
+
+        raw.resize(frames * frameBytes);
+        size_t got = fread(raw.data(), frameBytes, frames, file);
+        size_t samples = got * channelCount;
+        const unsigned char* p = raw.data();
+
+        switch (sampleFormat) {
+            case Format::U8:
+                for (size_t i = 0; i < samples; ++i) out[i] = (p[i] - 128) / 128.0f;
+                break;
+            case Format::S16:
+                for (size_t i = 0; i < samples; ++i, p += 2)
+                    out[i] = static_cast<int16_t>(p[0] | (p[1] << 8)) / 32768.0f;
+                break;
+            case Format::S24:
+                for (size_t i = 0; i < samples; ++i, p += 3)
+                    out[i] = (static_cast<int32_t>((p[0] << 8) | (p[1] << 16) | (static_cast<uint32_t>(p[2]) << 24)) >> 8) / 8388608.0f;
+                break;
+            case Format::S32:
+                for (size_t i = 0; i < samples; ++i, p += 4) {
+                    int32_t v;
+                    std::memcpy(&v, p, 4);
+                    out[i] = v / 2147483648.0f;
+                }
+                break;
+            case Format::F32:
+                std::memcpy(out, p, samples * sizeof(float));
+                break;
+            case Format::F64:
+                for (size_t i = 0; i < samples; ++i, p += 8) {
+                    double v;
+                    std::memcpy(&v, p, 8);
+                    out[i] = static_cast<float>(v);
+                }
+                break;
+        }
+
+        framePos += got;
+        return got;
+    }
+
+    bool seek(double seconds) override {
+        uint64_t frame = std::min<uint64_t>(static_cast<uint64_t>(seconds * rate), frameCount);
+        if (fseek(file, dataStart + static_cast<long>(frame * frameBytes), SEEK_SET) != 0) return false;
+        framePos = frame;
+        return true;
+    }
+
+    const char* name() const override { return "wav"; }
+
+private:
+    enum class Format { U8, S16, S24, S32, F32, F64 };
+
+    bool readU32(uint32_t& v) {
+        unsigned char b[4];
+        if (fread(b, 1, 4, file) != 4) return false;
+        v = b[0] | (b[1] << 8) | (b[2] << 16) | (static_cast<uint32_t>(b[3]) << 24);
+        return true;
+    }
+
+    bool parseFormat(uint32_t size) {
+        if (size < 16) return false;
+        std::vector<unsigned char> fmt(size);
+        if (fread(fmt.data(), 1, size, file) != size) return false;
+
+        uint16_t tag = fmt[0] | (fmt[1] << 8);
+        channelCount = fmt[2] | (fmt[3] << 8);
+        rate = fmt[4] | (fmt[5] << 8) | (fmt[6] << 16) | (fmt[7] << 24);
+        uint16_t blockAlign = fmt[12] | (fmt[13] << 8);
+        uint16_t bits = fmt[14] | (fmt[15] << 8);
+
+        // WAVE_FORMAT_EXTENSIBLE keeps the real format tag in the sub-format GUID
+        if (tag == 0xFFFE && size >= 40) {
+            tag = fmt[24] | (fmt[25] << 8);
+        }
+
+        if (tag == 1) {
+            if (bits == 8) sampleFormat = Format::U8;
+            else if (bits == 16) sampleFormat = Format::S16;
+            else if (bits == 24) sampleFormat = Format::S24;
+            else if (bits == 32) sampleFormat = Format::S32;
+            else return false;
+        } else if (tag == 3) {
+            if (bits == 32) sampleFormat = Format::F32;
+            else if (bits == 64) sampleFormat = Format::F64;
+            else return false;
+        } else {
+            std::cerr << "Unsupported WAV format tag: " << tag << std::endl;
+            return false;
+        }
+
+        frameBytes = blockAlign;
+        return channelCount > 0 && rate > 0 && frameBytes == static_cast<size_t>(channelCount * (bits / 8));
+    }
+
+    FILE* file = nullptr;
+    Format sampleFormat = Format::S16;
+    size_t frameBytes = 0;
+    long dataStart = 0;
+    uint64_t dataBytes = 0;
+    uint64_t framePos = 0;
+    std::vector<unsigned char> raw;
+};
+
+std::unique_ptr<Decoder> createWavDecoder() {
+    return std::make_unique<WavDecoder>();
+}
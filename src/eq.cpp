@@ -2,208 +2,718 @@
 #include <cmath>
 #include <algorithm>
 #include <iostream>
+#include <cstring>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define YABOKU_EQ_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define YABOKU_EQ_NEON
+#endif
 
 std::unique_ptr<Equalizer> g_equalizer = nullptr;
 
-BiquadFilter::BiquadFilter() : b0(1.0f), b1(0.0f), b2(0.0f), a1(0.0f), a2(0.0f),
-                               x1(0.0f), x2(0.0f), y1(0.0f), y2(0.0f) {}
+// ================= Filters =================
+
+static const EqFilterType FILTER_TYPES[] = {
+    EqFilterType::Peak, EqFilterType::LowShelf, EqFilterType::HighShelf, EqFilterType::LowPass,
+    EqFilterType::HighPass, EqFilterType::Notch, EqFilterType::AllPass
+};
+
+const char* eqFilterTypeName(EqFilterType type) {
+    switch (type) {
+        case EqFilterType::Peak: return "peak";
+        case EqFilterType::LowShelf: return "low-shelf";
+        case EqFilterType::HighShelf: return "high-shelf";
+        case EqFilterType::LowPass: return "low-pass";
+        case EqFilterType::HighPass: return "high-pass";
+        case EqFilterType::Notch: return "notch";
+        case EqFilterType::AllPass: return "all-pass";
+    }
+    return "peak";
+}
 
-void BiquadFilter::setPeakingEQ(float frequency, float sampleRate, float gainDB, float Q) {
-    float A = std::pow(10.0f, gainDB / 40.0f);
-    float omega = 2.0f * M_PI * frequency / sampleRate;
-    float sin_omega = std::sin(omega);
-    float cos_omega = std::cos(omega);
-    float alpha = sin_omega / (2.0f * Q);
+bool eqFilterTypeFromName(const std::string& name, EqFilterType& type) {
+    for (EqFilterType candidate : FILTER_TYPES) {
+        if (name == eqFilterTypeName(candidate)) {
+            type = candidate;
+            return true;
+        }
+    }
+    return false;
+}
 
-    float a0 = 1.0f + alpha / A;
+bool eqFilterTypeHasGain(EqFilterType type) {
+    return type == EqFilterType::Peak || type == EqFilterType::LowShelf || type == EqFilterType::HighShelf;
+}
 
-    b0 = (1.0f + alpha * A) / a0;
-    b1 = (-2.0f * cos_omega) / a0;
-    b2 = (1.0f - alpha * A) / a0;
-    a1 = (-2.0f * cos_omega) / a0;
-    a2 = (1.0f - alpha / A) / a0;
+std::vector<EqBand> graphicEqualizerBands(const float gains[EQ_BANDS]) {
+    std::vector<EqBand> bands(EQ_BANDS);
+    for (int band = 0; band < EQ_BANDS; ++band) {
+        bands[band].frequency = EQ_FREQUENCIES[band];
+        bands[band].gainDB = gains[band];
+        if (band == 0) {
+            // First band - Low Shelf
+            bands[band].type = EqFilterType::LowShelf;
+            bands[band].q = 0.707f;
+        } else if (band == EQ_BANDS - 1) {
+            // Last band - High Shelf
+            bands[band].type = EqFilterType::HighShelf;
+            bands[band].q = 0.707f;
+        } else {
+            // Rest - Peaking EQ
+            bands[band].type = EqFilterType::Peak;
+            bands[band].q = 1.0f;
+        }
+    }
+    return bands;
 }
 
-void BiquadFilter::setLowShelf(float frequency, float sampleRate, float gainDB, float Q) {
-    float A = std::pow(10.0f, gainDB / 40.0f);
-    float omega = 2.0f * M_PI * frequency / sampleRate;
-    float sin_omega = std::sin(omega);
-    float cos_omega = std::cos(omega);
-    float S = 1.0f; // shelf slope parameter (1 is max.)
-    float beta = std::sqrt(A) / Q;
+BiquadFilter::BiquadFilter() : b0(1.0f), b1(0.0f), b2(0.0f), a1(0.0f), a2(0.0f),
+                               s1(0.0f), s2(0.0f) {}
+
+void BiquadFilter::setNormalized(double nb0, double nb1, double nb2, double na0, double na1, double na2) {
+    b0 = static_cast<float>(nb0 / na0);
+    b1 = static_cast<float>(nb1 / na0);
+    b2 = static_cast<float>(nb2 / na0);
+    a1 = static_cast<float>(na1 / na0);
+    a2 = static_cast<float>(na2 / na0);
+}
 
-    float a0 = (A + 1.0f) + (A - 1.0f) * cos_omega + beta * sin_omega;
+void BiquadFilter::setPeakingEQ(float frequency, float sampleRate, float gainDB, float Q) {
+    double A = std::pow(10.0, gainDB / 40.0);
+    double omega = 2.0 * M_PI * frequency / sampleRate;
+    double sin_omega = std::sin(omega);
+    double cos_omega = std::cos(omega);
+    double alpha = sin_omega / (2.0 * Q);
+
+    setNormalized(1.0 + alpha * A, -2.0 * cos_omega, 1.0 - alpha * A,
+                  1.0 + alpha / A, -2.0 * cos_omega, 1.0 - alpha / A);
+}
 
-    b0 = (A * ((A + 1.0f) - (A - 1.0f) * cos_omega + beta * sin_omega)) / a0;
-    b1 = (2.0f * A * ((A - 1.0f) - (A + 1.0f) * cos_omega)) / a0;
-    b2 = (A * ((A + 1.0f) - (A - 1.0f) * cos_omega - beta * sin_omega)) / a0;
-    a1 = (-2.0f * ((A - 1.0f) + (A + 1.0f) * cos_omega)) / a0;
-    a2 = ((A + 1.0f) + (A - 1.0f) * cos_omega - beta * sin_omega) / a0;
+void BiquadFilter::setLowShelf(float frequency, float sampleRate, float gainDB, float Q) {
+    double A = std::pow(10.0, gainDB / 40.0);
+    double omega = 2.0 * M_PI * frequency / sampleRate;
+    double sin_omega = std::sin(omega);
+    double cos_omega = std::cos(omega);
+    double beta = std::sqrt(A) / Q;
+
+    setNormalized(A * ((A + 1.0) - (A - 1.0) * cos_omega + beta * sin_omega),
+                  2.0 * A * ((A - 1.0) - (A + 1.0) * cos_omega),
+                  A * ((A + 1.0) - (A - 1.0) * cos_omega - beta * sin_omega),
+                  (A + 1.0) + (A - 1.0) * cos_omega + beta * sin_omega,
+                  -2.0 * ((A - 1.0) + (A + 1.0) * cos_omega),
+                  (A + 1.0) + (A - 1.0) * cos_omega - beta * sin_omega);
 }
 
 void BiquadFilter::setHighShelf(float frequency, float sampleRate, float gainDB, float Q) {
-    float A = std::pow(10.0f, gainDB / 40.0f);
-    float omega = 2.0f * M_PI * frequency / sampleRate;
-    float sin_omega = std::sin(omega);
-    float cos_omega = std::cos(omega);
-    float S = 1.0f; // shelf slope parameter (1 is max.)
-    float beta = std::sqrt(A) / Q;
+    double A = std::pow(10.0, gainDB / 40.0);
+    double omega = 2.0 * M_PI * frequency / sampleRate;
+    double sin_omega = std::sin(omega);
+    double cos_omega = std::cos(omega);
+    double beta = std::sqrt(A) / Q;
+
+    setNormalized(A * ((A + 1.0) + (A - 1.0) * cos_omega + beta * sin_omega),
+                  -2.0 * A * ((A - 1.0) + (A + 1.0) * cos_omega),
+                  A * ((A + 1.0) + (A - 1.0) * cos_omega - beta * sin_omega),
+                  (A + 1.0) - (A - 1.0) * cos_omega + beta * sin_omega,
+                  2.0 * ((A - 1.0) - (A + 1.0) * cos_omega),
+                  (A + 1.0) - (A - 1.0) * cos_omega - beta * sin_omega);
+}
 
-    float a0 = (A + 1.0f) - (A - 1.0f) * cos_omega + beta * sin_omega;
+void BiquadFilter::setLowPass(float frequency, float sampleRate, float Q) {
+    double omega = 2.0 * M_PI * frequency / sampleRate;
+    double cos_omega = std::cos(omega);
+    double alpha = std::sin(omega) / (2.0 * Q);
+    setNormalized((1.0 - cos_omega) / 2.0, 1.0 - cos_omega, (1.0 - cos_omega) / 2.0,
+                  1.0 + alpha, -2.0 * cos_omega, 1.0 - alpha);
+}
 
-    b0 = (A * ((A + 1.0f) + (A - 1.0f) * cos_omega + beta * sin_omega)) / a0;
-    b1 = (-2.0f * A * ((A - 1.0f) + (A + 1.0f) * cos_omega)) / a0;
-    b2 = (A * ((A + 1.0f) + (A - 1.0f) * cos_omega - beta * sin_omega)) / a0;
-    a1 = (2.0f * ((A - 1.0f) - (A + 1.0f) * cos_omega)) / a0;
-    a2 = ((A + 1.0f) - (A - 1.0f) * cos_omega - beta * sin_omega) / a0;
+void BiquadFilter::setHighPass(float frequency, float sampleRate, float Q) {
+    double omega = 2.0 * M_PI * frequency / sampleRate;
+    double cos_omega = std::cos(omega);
+    double alpha = std::sin(omega) / (2.0 * Q);
+    setNormalized((1.0 + cos_omega) / 2.0, -(1.0 + cos_omega), (1.0 + cos_omega) / 2.0,
+                  1.0 + alpha, -2.0 * cos_omega, 1.0 - alpha);
 }
 
-float BiquadFilter::process(float input) {
-    float output = b0 * input + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+void BiquadFilter::setNotch(float frequency, float sampleRate, float Q) {
+    double omega = 2.0 * M_PI * frequency / sampleRate;
+    double cos_omega = std::cos(omega);
+    double alpha = std::sin(omega) / (2.0 * Q);
+    setNormalized(1.0, -2.0 * cos_omega, 1.0,
+                  1.0 + alpha, -2.0 * cos_omega, 1.0 - alpha);
+}
+
+void BiquadFilter::setAllPass(float frequency, float sampleRate, float Q) {
+    double omega = 2.0 * M_PI * frequency / sampleRate;
+    double cos_omega = std::cos(omega);
+    double alpha = std::sin(omega) / (2.0 * Q);
+    setNormalized(1.0 - alpha, -2.0 * cos_omega, 1.0 + alpha,
+                  1.0 + alpha, -2.0 * cos_omega, 1.0 - alpha);
+}
+
+void BiquadFilter::setGain(float gainDB) {
+    setNormalized(std::pow(10.0, gainDB / 20.0), 0.0, 0.0, 1.0, 0.0, 0.0);
+}
+
+void BiquadFilter::setPassThrough() {
+    setNormalized(1.0, 0.0, 0.0, 1.0, 0.0, 0.0);
+}
 
-    x2 = x1;
-    x1 = input;
-    y2 = y1;
-    y1 = output;
+void BiquadFilter::design(const EqBand& band, float sampleRate) {
+    if (!band.enabled) {
+        setPassThrough();
+        return;
+    }
+    // Just under Nyquist, the bilinear transform folds anything above it back down
+    float frequency = std::clamp(band.frequency, 1.0f, sampleRate * 0.499f);
+    float q = std::clamp(band.q, 0.025f, 40.0f);
+    switch (band.type) {
+        case EqFilterType::Peak: setPeakingEQ(frequency, sampleRate, band.gainDB, q); break;
+        case EqFilterType::LowShelf: setLowShelf(frequency, sampleRate, band.gainDB, q); break;
+        case EqFilterType::HighShelf: setHighShelf(frequency, sampleRate, band.gainDB, q); break;
+        case EqFilterType::LowPass: setLowPass(frequency, sampleRate, q); break;
+        case EqFilterType::HighPass: setHighPass(frequency, sampleRate, q); break;
+        case EqFilterType::Notch: setNotch(frequency, sampleRate, q); break;
+        case EqFilterType::AllPass: setAllPass(frequency, sampleRate, q); break;
+    }
+}
 
+float BiquadFilter::process(float input) {
+    // Keep the operation order in step with processStereo
+    float output = b0 * input + s1;
+    s1 = (b1 * input + s2) - a1 * output;
+    s2 = b2 * input - a2 * output;
     return output;
 }
 
 void BiquadFilter::reset() {
-    x1 = x2 = y1 = y2 = 0.0f;
+    s1 = s2 = 0.0f;
 }
 
-Equalizer::Equalizer() : enabled(false), sampleRate(44100.0f), initialized(false) {
-    for (int i = 0; i < EQ_BANDS; ++i) {
-        bandGains[i] = 0.0f;
+// ================= Settings =================
+
+// A flat stage whose state is below this has rung out and can leave the chain
+static const float SETTLED_STATE = 1e-8f;
+
+Equalizer::Equalizer() : preampDB(0.0f), writerBank(0), middleBank(1), readerBank(2), rampingBands(0),
+                         chainLength(0), chainDraining(false), stereoKernel(nullptr),
+                         enabled(false), sampleRate(44100.0f), initialized(false) {
+    const float flat[EQ_BANDS] = {};
+    bands = graphicEqualizerBands(flat);
+    for (int stage = 0; stage < MAX_STAGES; ++stage) {
+        latest.flat[stage] = true;
+        revisions[stage] = 0;
+        rampSteps[stage] = 0;
     }
+    std::memset(coefficients, 0, sizeof(coefficients));
+    std::memset(state, 0, sizeof(state));
 }
 
 Equalizer::~Equalizer() {
 }
 
 void Equalizer::initialize(float sr) {
+    std::lock_guard<std::mutex> lock(writerMutex);
     sampleRate = sr;
 
     // Initialize filters for each band and channel
-    for (int band = 0; band < EQ_BANDS; ++band) {
+    for (int stage = 0; stage < MAX_STAGES; ++stage) {
+        designStage(stage);
+        revisions[stage] = latest.revisions[stage];
+        rampSteps[stage] = 0;
         for (int channel = 0; channel < 2; ++channel) {
-            if (band == 0) {
-                // First band - Low Shelf
-                filters[band][channel].setLowShelf(
-                    EQ_FREQUENCIES[band],
-                    sampleRate,
-                    bandGains[band].load(),
-                    0.707f
-                );
-            } else if (band == EQ_BANDS - 1) {
-                // Last band - High Shelf
-                filters[band][channel].setHighShelf(
-                    EQ_FREQUENCIES[band],
-                    sampleRate,
-                    bandGains[band].load(),
-                    0.707f
-                );
-            } else {
-                // Rest - Peaking EQ
-                filters[band][channel].setPeakingEQ(
-                    EQ_FREQUENCIES[band],
-                    sampleRate,
-                    bandGains[band].load(),
-                    1.0f
-                );
-            }
+            filters[stage][channel] = latest.designs[stage];
+            filters[stage][channel].reset();
         }
     }
+    rampingBands = 0;
+    for (EqualizerBank& bank : banks) bank = latest;
+    middleBank = (middleBank.load() & BANK_INDEX);
+    compileChain();
 
     initialized = true;
     std::cout << "Equalizer initialized with sample rate: " << sampleRate << std::endl;
 }
 
-void Equalizer::setBandGain(int band, float gainDB) {
-    if (band < 0 || band >= EQ_BANDS) return;
+// Stages past the band count pass through
+void Equalizer::designStage(int stage) {
+    BiquadFilter design;
+    bool flat = true;
+    if (stage == PREAMP_STAGE) {
+        design.setGain(preampDB);
+        flat = preampDB == 0.0f;
+    } else if (stage < static_cast<int>(bands.size())) {
+        const EqBand& band = bands[stage];
+        design.design(band, sampleRate);
+        flat = !band.enabled || (eqFilterTypeHasGain(band.type) && band.gainDB == 0.0f);
+    }
 
-    // Gain range
-    gainDB = std::clamp(gainDB, -30.0f, 30.0f);
-    bandGains[band] = gainDB;
+    BiquadFilter& target = latest.designs[stage];
+    if (flat != latest.flat[stage] || design.b0 != target.b0 || design.b1 != target.b1 ||
+        design.b2 != target.b2 || design.a1 != target.a1 || design.a2 != target.a2) {
+        target = design;
+        latest.flat[stage] = flat;
+        ++latest.revisions[stage];
+    }
+}
 
-    if (initialized) {
-        // Apply filters
-        for (int channel = 0; channel < 2; ++channel) {
-            if (band == 0) {
-                // First band - Low Shelf
-                filters[band][channel].setLowShelf(
-                    EQ_FREQUENCIES[band],
-                    sampleRate,
-                    gainDB,
-                    0.707f
-                );
-            } else if (band == EQ_BANDS - 1) {
-                // Last band - High Shelf
-                filters[band][channel].setHighShelf(
-                    EQ_FREQUENCIES[band],
-                    sampleRate,
-                    gainDB,
-                    0.707f
-                );
-            } else {
-                // Rest - Peaking EQ
-                filters[band][channel].setPeakingEQ(
-                    EQ_FREQUENCIES[band],
-                    sampleRate,
-                    gainDB,
-                    1.0f
-                );
-            }
-        }
+// Whole bank into the writer's spare, then swapped into the middle; the one
+// that comes back is free, the audio thread only ever holds another
+void Equalizer::publish() {
+    banks[writerBank] = latest;
+    writerBank = middleBank.exchange(writerBank | BANK_NEW, std::memory_order_acq_rel) & BANK_INDEX;
+}
+
+void Equalizer::setBands(const std::vector<EqBand>& newBands, float newPreampDB) {
+    std::lock_guard<std::mutex> lock(writerMutex);
+    bands.assign(newBands.begin(), newBands.begin() + std::min<size_t>(newBands.size(), EQ_MAX_BANDS));
+    for (EqBand& band : bands) {
+        band.gainDB = std::clamp(band.gainDB, -30.0f, 30.0f);
     }
+    preampDB = std::clamp(newPreampDB, -30.0f, 30.0f);
+    if (!initialized) return;
+
+    for (int stage = 0; stage < MAX_STAGES; ++stage) {
+        designStage(stage);
+    }
+    publish();
+}
+
+std::vector<EqBand> Equalizer::getBands() const {
+    std::lock_guard<std::mutex> lock(writerMutex);
+    return bands;
+}
+
+void Equalizer::setBandGain(int band, float gainDB) {
+    std::lock_guard<std::mutex> lock(writerMutex);
+    if (band < 0 || band >= static_cast<int>(bands.size())) return;
 
-    std::string filterType = (band == 0) ? "Low Shelf" : 
-                            (band == EQ_BANDS - 1) ? "High Shelf" : "Peaking";
-    std::cout << "EQ Band " << band << " (" << EQ_FREQUENCIES[band] << "Hz, " 
-              << filterType << ") set to " << gainDB << "dB" << std::endl;
+    // Gain range
+    bands[band].gainDB = std::clamp(gainDB, -30.0f, 30.0f);
+    if (!initialized) return;
+
+    designStage(band);
+    publish();
 }
 
 float Equalizer::getBandGain(int band) const {
-    if (band < 0 || band >= EQ_BANDS) return 0.0f;
-    return bandGains[band].load();
+    std::lock_guard<std::mutex> lock(writerMutex);
+    if (band < 0 || band >= static_cast<int>(bands.size())) return 0.0f;
+    return bands[band].gainDB;
 }
 
 void Equalizer::setEnabled(bool en) {
     enabled = en;
-    std::cout << "Equalizer " << (en ? "enabled" : "disabled") << std::endl;
 }
 
 bool Equalizer::isEnabled() const {
     return enabled.load();
 }
 
+bool Equalizer::isBypassed() const {
+    if (!enabled.load() || !initialized) return true;
+    return chainLength == 0 && !(middleBank.load(std::memory_order_relaxed) & BANK_NEW);
+}
+
+// Gains and preamp back to 0 dB, the layout stays; flat bands ring out and
+// leave the chain by themselves
 void Equalizer::reset() {
-    for (int band = 0; band < EQ_BANDS; ++band) {
-        setBandGain(band, 0.0f);
-        for (int channel = 0; channel < 2; ++channel) {
-            filters[band][channel].reset();
+    {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        for (EqBand& band : bands) band.gainDB = 0.0f;
+        preampDB = 0.0f;
+        if (initialized) {
+            for (int stage = 0; stage < MAX_STAGES; ++stage) {
+                designStage(stage);
+            }
+            publish();
         }
     }
     std::cout << "Equalizer reset" << std::endl;
 }
 
-void Equalizer::processBuffer(float* buffer, int frames, int channels) {
-    if (!enabled.load() || !initialized) return;
+// ================= Glide =================
+
+// Stages whose design changed glide there from wherever they are now.
+// Stable biquads form a convex set in (a1, a2) (|a2| < 1, |a1| < 1 + a2), so
+// every point on a straight line between two of them is stable too, also
+// between different filter types; retargeting halfway starts from such a
+// point and stays inside as well.
+void Equalizer::adoptPublishedBank() {
+    if (!(middleBank.load(std::memory_order_relaxed) & BANK_NEW)) return;
+    readerBank = middleBank.exchange(readerBank, std::memory_order_acq_rel) & BANK_INDEX;
+
+    const EqualizerBank& bank = banks[readerBank];
+    bool changed = false;
+    for (int stage = 0; stage < MAX_STAGES; ++stage) {
+        if (bank.revisions[stage] == revisions[stage]) continue;
+        revisions[stage] = bank.revisions[stage];
+        if (rampSteps[stage] == 0) ++rampingBands;
+        rampSteps[stage] = RAMP_STEPS;
+        changed = true;
+    }
+    if (changed) compileChain();
+}
+
+// One step of every gliding stage, the last one lands exactly on the target
+void Equalizer::advanceRamps() {
+    const EqualizerBank& bank = banks[readerBank];
+    for (int stage = 0; stage < MAX_STAGES; ++stage) {
+        if (rampSteps[stage] == 0) continue;
+        const BiquadFilter& target = bank.designs[stage];
+        float fraction = 1.0f / rampSteps[stage];
+        for (int channel = 0; channel < 2; ++channel) {
+            BiquadFilter& filter = filters[stage][channel];
+            if (rampSteps[stage] == 1) {
+                filter.b0 = target.b0;
+                filter.b1 = target.b1;
+                filter.b2 = target.b2;
+                filter.a1 = target.a1;
+                filter.a2 = target.a2;
+            } else {
+                filter.b0 += (target.b0 - filter.b0) * fraction;
+                filter.b1 += (target.b1 - filter.b1) * fraction;
+                filter.b2 += (target.b2 - filter.b2) * fraction;
+                filter.a1 += (target.a1 - filter.a1) * fraction;
+                filter.a2 += (target.a2 - filter.a2) * fraction;
+            }
+        }
+        if (--rampSteps[stage] == 0) --rampingBands;
+    }
+    loadCoefficients();
+}
+
+// ================= Chain =================
 
+// A flat stage passes the signal through, but right after being flattened
+// it still rings with what it held before; cutting it off then would click
+bool Equalizer::isSettled(int stage) const {
+    for (int channel = 0; channel < 2; ++channel) {
+        const BiquadFilter& filter = filters[stage][channel];
+        if (!(std::fabs(filter.s1) < SETTLED_STATE && std::fabs(filter.s2) < SETTLED_STATE)) return false;
+    }
+    return true;
+}
+
+// The cascade is a pipeline with one filter per stage: at step t stage s works
+// on frame t - s, so every vector runs two neighbouring stages at once and
+// hands its output one stage down for the next step. Stages outside the
+// block (the first and last STAGES - 1 steps) must not move their state.
+//
+// The arithmetic is BiquadFilter::process lane by lane, so without fused
+// multiply-adds the output is bit-identical to the scalar cascade. Where the
+// compiler fuses the scalar code (ARM) the two differ by a few ulp.
+#if defined(YABOKU_EQ_SSE) || defined(YABOKU_EQ_NEON)
+
+namespace {
+
+#if defined(YABOKU_EQ_SSE)
+using Vec = __m128;
+inline Vec vload(const float* p) { return _mm_load_ps(p); }
+inline void vstore(float* p, Vec v) { _mm_store_ps(p, v); }
+inline Vec vzero() { return _mm_setzero_ps(); }
+inline Vec vmul(Vec a, Vec b) { return _mm_mul_ps(a, b); }
+inline Vec vadd(Vec a, Vec b) { return _mm_add_ps(a, b); }
+inline Vec vsub(Vec a, Vec b) { return _mm_sub_ps(a, b); }
+// Lanes 0-1 where lo is set, 2-3 where hi is set, b elsewhere
+inline Vec vselect(bool lo, bool hi, Vec a, Vec b) {
+    Vec mask = _mm_castsi128_ps(_mm_setr_epi32(-lo, -lo, -hi, -hi));
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+// {frame, low half of v}
+inline Vec vinsertFrame(const float* frame, Vec v) {
+    return _mm_movelh_ps(_mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(frame)), v);
+}
+inline void vstoreHigh(float* frame, Vec v) { _mm_storeh_pi(reinterpret_cast<__m64*>(frame), v); }
+// {high half of a, low half of b}
+inline Vec vshift(Vec a, Vec b) { return _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 0, 3, 2)); }
+#else
+using Vec = float32x4_t;
+inline Vec vload(const float* p) { return vld1q_f32(p); }
+inline void vstore(float* p, Vec v) { vst1q_f32(p, v); }
+inline Vec vzero() { return vdupq_n_f32(0.0f); }
+inline Vec vmul(Vec a, Vec b) { return vmulq_f32(a, b); }
+inline Vec vadd(Vec a, Vec b) { return vaddq_f32(a, b); }
+inline Vec vsub(Vec a, Vec b) { return vsubq_f32(a, b); }
+inline Vec vselect(bool lo, bool hi, Vec a, Vec b) {
+    uint32x4_t mask = vcombine_u32(vdup_n_u32(lo ? 0xFFFFFFFFu : 0u), vdup_n_u32(hi ? 0xFFFFFFFFu : 0u));
+    return vbslq_f32(mask, a, b);
+}
+inline Vec vinsertFrame(const float* frame, Vec v) { return vcombine_f32(vld1_f32(frame), vget_low_f32(v)); }
+inline void vstoreHigh(float* frame, Vec v) { vst1_f32(frame, vget_high_f32(v)); }
+inline Vec vshift(Vec a, Vec b) { return vcombine_f32(vget_high_f32(a), vget_low_f32(b)); }
+#endif
+
+template <int PAIRS>
+struct Cascade {
+    static constexpr int STAGES = PAIRS * 2;
+    Vec c[PAIRS][5];
+    Vec s1[PAIRS], s2[PAIRS], in[PAIRS], out[PAIRS];
+};
+
+// Stage pair p at step t; EDGE keeps the state of stages with no frame at t
+template <bool EDGE, int PAIRS>
+inline void pairStep(Cascade<PAIRS>& k, int p, int t, int frames) {
+    Vec x = k.in[p];
+    Vec y = vadd(vmul(k.c[p][0], x), k.s1[p]);
+    Vec n1 = vsub(vadd(vmul(k.c[p][1], x), k.s2[p]), vmul(k.c[p][3], y));
+    Vec n2 = vsub(vmul(k.c[p][2], x), vmul(k.c[p][4], y));
+    if (EDGE) {
+        int lo = t - p * 2, hi = lo - 1;
+        bool loValid = lo >= 0 && lo < frames;
+        bool hiValid = hi >= 0 && hi < frames;
+        n1 = vselect(loValid, hiValid, n1, k.s1[p]);
+        n2 = vselect(loValid, hiValid, n2, k.s2[p]);
+    }
+    k.s1[p] = n1;
+    k.s2[p] = n2;
+    k.out[p] = y;
+}
+
+// Shift down one stage: {L, R} of the lower half moves to the upper half,
+// the upper half of the pair before moves into the lower
+template <int PAIRS>
+inline void pairShift(Cascade<PAIRS>& k, int p) {
+    k.in[p] = p == 0 ? k.out[0] : vshift(k.out[p - 1], k.out[p]);
+}
+
+// The pairs are expanded at compile time so the whole cascade stays in registers
+template <bool EDGE, int PAIRS, size_t... P>
+inline void cascadeStep(Cascade<PAIRS>& k, float* buffer, int t, int frames, std::index_sequence<P...>) {
+    static const float silence[2] = {0.0f, 0.0f};
+    k.in[0] = vinsertFrame(t < frames ? buffer + t * 2 : silence, k.in[0]);
+    (pairStep<EDGE>(k, P, t, frames), ...);
+    int done = t - (Cascade<PAIRS>::STAGES - 1);
+    if (!EDGE || (done >= 0 && done < frames)) {
+        vstoreHigh(buffer + done * 2, k.out[PAIRS - 1]);
+    }
+    (pairShift(k, P), ...);
+}
+
+// One kernel per chain length, a chain of n bands runs (n + 1) / 2 pairs
+template <int PAIRS>
+void stereoCascade(const float* coefficients, float* state, float* buffer, int frames) {
+    constexpr int STAGES = Cascade<PAIRS>::STAGES;
+    Cascade<PAIRS> k;
+    for (int p = 0; p < PAIRS; ++p) {
+        for (int i = 0; i < 5; ++i) k.c[p][i] = vload(coefficients + (p * 5 + i) * 4);
+        k.s1[p] = vload(state + (p * 2) * 4);
+        k.s2[p] = vload(state + (p * 2 + 1) * 4);
+        k.in[p] = vzero();
+    }
+
+    auto pairs = std::make_index_sequence<PAIRS>();
+    int t = 0;
+    for (; t < STAGES - 1; ++t) cascadeStep<true>(k, buffer, t, frames, pairs);
+    for (; t < frames; ++t) cascadeStep<false>(k, buffer, t, frames, pairs);
+    for (; t < frames + STAGES - 1; ++t) cascadeStep<true>(k, buffer, t, frames, pairs);
+
+    for (int p = 0; p < PAIRS; ++p) {
+        vstore(state + (p * 2) * 4, k.s1[p]);
+        vstore(state + (p * 2 + 1) * 4, k.s2[p]);
+    }
+}
+
+using StereoKernel = void (*)(const float*, float*, float*, int);
+
+template <size_t... P>
+constexpr std::array<StereoKernel, sizeof...(P)> stereoKernels(std::index_sequence<P...>) {
+    return {{&stereoCascade<static_cast<int>(P) + 1>...}};
+}
+
+// STEREO_KERNELS[n - 1] runs n pairs
+constexpr int MAX_PAIRS = (EqualizerBank::STAGES + 1) / 2;
+const std::array<StereoKernel, MAX_PAIRS> STEREO_KERNELS = stereoKernels(std::make_index_sequence<MAX_PAIRS>());
+
+} // namespace
+
+#endif
+
+void Equalizer::compileChain() {
+    const EqualizerBank& bank = banks[readerBank];
+    chainLength = 0;
+    chainDraining = false;
+    for (int stage = 0; stage < MAX_STAGES; ++stage) {
+        bool flat = bank.flat[stage];
+        if (!flat || rampSteps[stage] > 0 || !isSettled(stage)) {
+            chain[chainLength++] = stage;
+            chainDraining = chainDraining || flat;
+        } else {
+            // Anything left below the threshold goes, the stage restarts clean
+            filters[stage][0].reset();
+            filters[stage][1].reset();
+        }
+    }
+
+    loadCoefficients();
+#if defined(YABOKU_EQ_SSE) || defined(YABOKU_EQ_NEON)
+    stereoKernel = chainLength > 0 ? STEREO_KERNELS[(chainLength + 1) / 2 - 1] : nullptr;
+#endif
+}
+
+void Equalizer::loadCoefficients() {
+    // Vector bank: stage i in pair i / 2, lanes 0-1 for even stages, 2-3 for
+    // odd; the unused half of an odd chain's last pair passes through
+    std::memset(coefficients, 0, sizeof(coefficients));
+    for (int stage = 0; stage < chainLength + chainLength % 2; ++stage) {
+        float values[5] = {1.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+        if (stage < chainLength) {
+            const BiquadFilter& filter = filters[chain[stage]][0];
+            values[0] = filter.b0;
+            values[1] = filter.b1;
+            values[2] = filter.b2;
+            values[3] = filter.a1;
+            values[4] = filter.a2;
+        }
+        int lane = (stage % 2) * 2;
+        for (int c = 0; c < 5; ++c) {
+            coefficients[stage / 2][c][lane] = values[c];
+            coefficients[stage / 2][c][lane + 1] = values[c];
+        }
+    }
+}
+
+void Equalizer::retireSettledBands() {
+    if (!chainDraining) return;
+    const EqualizerBank& bank = banks[readerBank];
+    for (int i = 0; i < chainLength; ++i) {
+        int stage = chain[i];
+        if (bank.flat[stage] && rampSteps[stage] == 0 && isSettled(stage)) {
+            compileChain();
+            return;
+        }
+    }
+}
+
+#if defined(YABOKU_EQ_SSE) || defined(YABOKU_EQ_NEON)
+
+void Equalizer::processStereo(float* buffer, int frames) {
+    if (!stereoKernel) return;
+
+    // The chain's state into lanes and back, the padding lanes start from zero
+    std::memset(state, 0, sizeof(state));
+    for (int stage = 0; stage < chainLength; ++stage) {
+        int lane = (stage % 2) * 2;
+        for (int channel = 0; channel < 2; ++channel) {
+            const BiquadFilter& filter = filters[chain[stage]][channel];
+            state[stage / 2][0][lane + channel] = filter.s1;
+            state[stage / 2][1][lane + channel] = filter.s2;
+        }
+    }
+
+    stereoKernel(&coefficients[0][0][0], &state[0][0][0], buffer, frames);
+
+    for (int stage = 0; stage < chainLength; ++stage) {
+        int lane = (stage % 2) * 2;
+        for (int channel = 0; channel < 2; ++channel) {
+            BiquadFilter& filter = filters[chain[stage]][channel];
+            filter.s1 = state[stage / 2][0][lane + channel];
+            filter.s2 = state[stage / 2][1][lane + channel];
+        }
+    }
+    retireSettledBands();
+}
+
+#else
+
+void Equalizer::processStereo(float* buffer, int frames) {
+    processBlocks(buffer, frames, 2);
+}
+
+#endif
+
+bool Equalizer::hasVectorPath() {
+#if defined(YABOKU_EQ_SSE) || defined(YABOKU_EQ_NEON)
+    return true;
+#else
+    return false;
+#endif
+}
+
+// One band over the whole block with its coefficients and both channels'
+// state in locals; the two channels are independent chains, interleaving
+// them lets one run while the other waits on its feedback
+void Equalizer::processBlocks(float* buffer, int frames, int channels) {
     int processChannels = std::min(channels, 2);
+    if (processChannels <= 0 || chainLength == 0) return;
+    float* left = blocks[0];
+    float* right = blocks[processChannels > 1 ? 1 : 0];
 
-    for (int frame = 0; frame < frames; ++frame) {
-        for (int channel = 0; channel < processChannels; ++channel) {
-            float sample = buffer[frame * channels + channel];
+    for (int start = 0; start < frames; start += BLOCK_FRAMES) {
+        int count = std::min(frames - start, BLOCK_FRAMES);
+        float* frame = buffer + static_cast<size_t>(start) * channels;
 
-            for (int band = 0; band < EQ_BANDS; ++band) {
-                sample = filters[band][channel].process(sample);
+        for (int i = 0; i < count; ++i) {
+            left[i] = frame[i * channels];
+            if (processChannels > 1) right[i] = frame[i * channels + 1];
+        }
+
+        for (int stage = 0; stage < chainLength; ++stage) {
+            BiquadFilter& l = filters[chain[stage]][0];
+            BiquadFilter& r = filters[chain[stage]][1];
+            const float b0 = l.b0, b1 = l.b1, b2 = l.b2, a1 = l.a1, a2 = l.a2;
+            float l1 = l.s1, l2 = l.s2;
+            float r1 = r.s1, r2 = r.s2;
+            if (processChannels > 1) {
+                for (int i = 0; i < count; ++i) {
+                    float x = left[i];
+                    float y = b0 * x + l1;
+                    l1 = (b1 * x + l2) - a1 * y;
+                    l2 = b2 * x - a2 * y;
+                    left[i] = y;
+
+                    x = right[i];
+                    y = b0 * x + r1;
+                    r1 = (b1 * x + r2) - a1 * y;
+                    r2 = b2 * x - a2 * y;
+                    right[i] = y;
+                }
+            } else {
+                for (int i = 0; i < count; ++i) {
+                    float x = left[i];
+                    float y = b0 * x + l1;
+                    l1 = (b1 * x + l2) - a1 * y;
+                    l2 = b2 * x - a2 * y;
+                    left[i] = y;
+                }
             }
+            l.s1 = l1;
+            l.s2 = l2;
+            r.s1 = r1;
+            r.s2 = r2;
+        }
 
-            sample = std::clamp(sample, -1.0f, 1.0f);
-            buffer[frame * channels + channel] = sample;
+        // Overs are left to the limiter after the EQ
+        for (int i = 0; i < count; ++i) {
+            frame[i * channels] = left[i];
+            if (processChannels > 1) frame[i * channels + 1] = right[i];
+        }
+    }
+    retireSettledBands();
+}
+
+void Equalizer::processBuffer(float* buffer, int frames, int channels) {
+    if (!enabled.load() || !initialized || frames <= 0) return;
+    adoptPublishedBank();
+
+    // Gliding, the coefficients move every RAMP_STEP_FRAMES
+    for (int done = 0; done < frames && chainLength > 0;) {
+        int count = frames - done;
+        if (rampingBands > 0) {
+            advanceRamps();
+            count = std::min(count, RAMP_STEP_FRAMES);
         }
+        float* slice = buffer + static_cast<size_t>(done) * channels;
+        if (channels == 2 && hasVectorPath()) {
+            processStereo(slice, count);
+        } else {
+            processBlocks(slice, count, channels);
+        }
+        done += count;
     }
 }
 
@@ -229,12 +739,26 @@ bool isEqualizerEnabled() {
     return g_equalizer ? g_equalizer->isEnabled() : false;
 }
 
+bool isEqualizerBypassed() {
+    return g_equalizer ? g_equalizer->isBypassed() : true;
+}
+
 void setEqualizerBand(int band, float gainDB) {
     if (g_equalizer) {
         g_equalizer->setBandGain(band, gainDB);
     }
 }
 
+void setEqualizerBands(const std::vector<EqBand>& bands, float preampDB) {
+    if (g_equalizer) {
+        g_equalizer->setBands(bands, preampDB);
+    }
+}
+
+std::vector<EqBand> getEqualizerBands() {
+    return g_equalizer ? g_equalizer->getBands() : std::vector<EqBand>();
+}
+
 float getEqualizerBand(int band) {
     return g_equalizer ? g_equalizer->getBandGain(band) : 0.0f;
 }
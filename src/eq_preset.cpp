@@ -0,0 +1,125 @@
+#include "eq_preset.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <cctype>
+#include <cstdlib>
+
+static std::string lowercase(std::string text) {
+    for (char& c : text) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return text;
+}
+
+static bool parseNumber(const std::string& text, float& value) {
+    char* end = nullptr;
+    float parsed = std::strtof(text.c_str(), &end);
+    if (end == text.c_str() || *end != '\0' || !std::isfinite(parsed)) return false;
+    value = parsed;
+    return true;
+}
+
+// APO filter codes; the ones without a Q (LS, HS, LP, HP) take the default
+static bool filterTypeFromCode(const std::string& code, EqFilterType& type) {
+    if (code == "pk" || code == "peq" || code == "modal") type = EqFilterType::Peak;
+    else if (code == "ls" || code == "lsc" || code == "lsq") type = EqFilterType::LowShelf;
+    else if (code == "hs" || code == "hsc" || code == "hsq") type = EqFilterType::HighShelf;
+    else if (code == "lp" || code == "lpq") type = EqFilterType::LowPass;
+    else if (code == "hp" || code == "hpq") type = EqFilterType::HighPass;
+    else if (code == "no") type = EqFilterType::Notch;
+    else if (code == "ap") type = EqFilterType::AllPass;
+    else return false;
+    return true;
+}
+
+// Tokens after the filter label: ON|OFF, the type, then key/value pairs in
+// any order (Fc 105 Hz Gain -2.3 dB Q 0.70, or BW Oct 1.0 instead of Q)
+static bool parseFilter(const std::vector<std::string>& tokens, EqBand& band) {
+    size_t i = 1;
+    while (i < tokens.size() && tokens[i] != "on" && tokens[i] != "off") ++i;
+    if (i + 1 >= tokens.size()) return false;
+    band = EqBand();
+    band.enabled = tokens[i] == "on";
+    if (!filterTypeFromCode(tokens[i + 1], band.type)) return false;
+
+    bool hasFrequency = false;
+    for (i += 2; i < tokens.size(); ++i) {
+        const std::string& key = tokens[i];
+        if (i + 1 >= tokens.size()) break;
+        if (key == "fc") {
+            hasFrequency = parseNumber(tokens[++i], band.frequency);
+        } else if (key == "gain") {
+            parseNumber(tokens[++i], band.gainDB);
+        } else if (key == "q") {
+            parseNumber(tokens[++i], band.q);
+        } else if (key == "bw") {
+            if (tokens[i + 1] == "oct") ++i;
+            float octaves;
+            if (i + 1 < tokens.size() && parseNumber(tokens[++i], octaves) && octaves > 0.0f) {
+                float ratio = std::pow(2.0f, octaves);
+                band.q = std::sqrt(ratio) / (ratio - 1.0f);
+            }
+        }
+    }
+    return hasFrequency && band.frequency > 0.0f && band.q > 0.0f;
+}
+
+bool parseEqPreset(std::istream& input, EqPreset& preset) {
+    preset = EqPreset();
+    bool hasPreamp = false;
+    std::string line;
+    int lineNumber = 0;
+
+    while (std::getline(input, line)) {
+        ++lineNumber;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) line.erase(comment);
+
+        std::istringstream stream(lowercase(line));
+        std::vector<std::string> tokens;
+        std::string token;
+        while (stream >> token) tokens.push_back(token);
+        if (tokens.empty()) continue;
+
+        if (tokens[0] == "preamp:") {
+            // Several preamp lines add up, as in Equalizer APO
+            float gain;
+            if (tokens.size() > 1 && parseNumber(tokens[1], gain)) {
+                preset.preampDB += gain;
+                hasPreamp = true;
+            } else {
+                std::cerr << "EQ preset line " << lineNumber << ": bad preamp" << std::endl;
+            }
+        } else if (tokens[0].compare(0, 6, "filter") == 0) {
+            EqBand band;
+            if (!parseFilter(tokens, band)) {
+                std::cerr << "EQ preset line " << lineNumber << ": unsupported filter, skipped" << std::endl;
+            } else if (static_cast<int>(preset.bands.size()) >= EQ_MAX_BANDS) {
+                std::cerr << "EQ preset line " << lineNumber << ": more than " << EQ_MAX_BANDS
+                          << " filters, the rest is skipped" << std::endl;
+                break;
+            } else {
+                preset.bands.push_back(band);
+            }
+        } else {
+            std::cerr << "EQ preset line " << lineNumber << ": ignored" << std::endl;
+        }
+    }
+    return hasPreamp || !preset.bands.empty();
+}
+
+bool loadEqPreset(const std::string& path, EqPreset& preset) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Could not open EQ preset: " << path << std::endl;
+        return false;
+    }
+    if (!parseEqPreset(file, preset)) {
+        std::cerr << "No filters found in EQ preset: " << path << std::endl;
+        return false;
+    }
+    std::cout << "Loaded EQ preset " << path << " (" << preset.bands.size() << " filters, preamp "
+              << preset.preampDB << " dB)" << std::endl;
+    return true;
+}
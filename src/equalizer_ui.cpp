@@ -1,37 +1,56 @@
 #include "equalizer_ui.h"
 #include "eq.h"
+#include "eq_preset.h"
 #include "imgui.h"
 #include "player.h"
+#include "tinyfiledialogs.h"
 
 #include <vector>
 #include <string>
 #include <cstdio>
 #include <fstream>
 #include <iostream>
+#include <algorithm>
 #include <filesystem>                                                                                                                                                                                                                                    
 
 namespace fs = std::filesystem;
 
 static bool eqLoaded = false;  // Flag to load config once
 static bool enabled = true; // Global flag to save state between launches
-static std::string eqConfigPath = (configPath / "eq.cfg").string();
+static std::string eqConfigPath = (configPath / "eq.json").string();
+static std::string legacyEqConfigPath = (configPath / "eq.cfg").string();
 static std::vector<float> eqBands = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
 
+// Parametric mode runs its own bands, the graphic sliders are kept for switching back
+static bool parametric = false;
+static std::vector<EqBand> parametricBands;
+static float parametricPreamp = 0.0f;
+
 const char* freqLabels[] = { "30Hz", "150Hz", "350Hz", "600Hz", "1KHz", "3.5KHz", "7KHz", "11KHz", "16KHz" };
 const int bandCount = (int)eqBands.size();
 
-void loadEQConfig() {
-    std::ifstream file(eqConfigPath);
-    if (!file.is_open()) {
-        std::cerr << "Could not open EQ config file for reading: " << eqConfigPath << std::endl;
-        return;
+// In EqFilterType order
+static const char* filterTypeLabels[] = { "Peak", "Low shelf", "High shelf", "Low pass", "High pass", "Notch", "All pass" };
+static const int filterTypeCount = sizeof(filterTypeLabels) / sizeof(filterTypeLabels[0]);
+
+// Whichever layout is active, as a whole
+static void applyEqualizerLayout() {
+    if (parametric) {
+        sendEqualizerBands(parametricBands, parametricPreamp);
+    } else {
+        sendEqualizerBands(graphicEqualizerBands(eqBands.data()), 0.0f);
     }
+}
+
+// Settings from before eq.json: the enabled flag and the graphic gains
+static bool loadLegacyEQConfig() {
+    std::ifstream file(legacyEqConfigPath);
+    if (!file.is_open()) return false;
 
     if (!(file >> enabled)) {
         std::cerr << "Error reading EQ enabled state\n";
         enabled = true;
     }
-    setEqualizerEnabled(enabled);
 
     // Get eq bands
     for (size_t i = 0; i < eqBands.size(); ++i) {
@@ -41,28 +60,192 @@ void loadEQConfig() {
             break;
         }
         eqBands[i] = val;
-        setEqualizerBand(i, val); // Apply
     }
-    file.close();
+    return true;
+}
+
+void loadEQConfig() {
+    std::ifstream file(eqConfigPath);
+    if (!file.is_open()) {
+        if (!loadLegacyEQConfig()) {
+            std::cerr << "Could not open EQ config file for reading: " << eqConfigPath << std::endl;
+            return;
+        }
+        std::cout << "EQ settings moved from " << legacyEqConfigPath << " to " << eqConfigPath << std::endl;
+        saveEQConfig();
+    } else {
+        try {
+            json j;
+            file >> j;
+            enabled = j.value("enabled", true);
+            parametric = j.value("mode", std::string("graphic")) == "parametric";
+            if (j.contains("graphic") && j["graphic"].is_array()) {
+                for (size_t i = 0; i < eqBands.size() && i < j["graphic"].size(); ++i) {
+                    eqBands[i] = std::clamp(j["graphic"][i].get<float>(), -30.0f, 30.0f);
+                }
+            }
+            parametricPreamp = std::clamp(j.value("preamp", 0.0f), -30.0f, 30.0f);
+            parametricBands.clear();
+            if (j.contains("bands") && j["bands"].is_array()) {
+                for (const json& item : j["bands"]) {
+                    if ((int)parametricBands.size() >= EQ_MAX_BANDS) break;
+                    EqBand band;
+                    eqFilterTypeFromName(item.value("type", std::string("peak")), band.type);
+                    band.frequency = item.value("frequency", band.frequency);
+                    band.q = item.value("q", band.q);
+                    band.gainDB = item.value("gain", band.gainDB);
+                    band.enabled = item.value("enabled", band.enabled);
+                    parametricBands.push_back(band);
+                }
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Error loading EQ config: " << e.what() << std::endl;
+        }
+    }
+
+    sendEqualizerEnabled(enabled);
+    applyEqualizerLayout();
 }
 
 void saveEQConfig() {
+    fs::path configDir = fs::path(eqConfigPath).parent_path();
+    if (!fs::exists(configDir)) fs::create_directories(configDir);
+
+    json bands = json::array();
+    for (const EqBand& band : parametricBands) {
+        bands.push_back({
+            {"type", eqFilterTypeName(band.type)},
+            {"frequency", band.frequency},
+            {"q", band.q},
+            {"gain", band.gainDB},
+            {"enabled", band.enabled}
+        });
+    }
+
+    json j = {
+        {"enabled", enabled},
+        {"mode", parametric ? "parametric" : "graphic"},
+        {"graphic", eqBands},
+        {"preamp", parametricPreamp},
+        {"bands", bands}
+    };
+
     std::ofstream file(eqConfigPath);
     if (!file.is_open()) {
         std::cerr << "Could not open EQ config file for writing: " << eqConfigPath << std::endl;
         return;
     }
+    file << j.dump(4);
+}
 
-    // Save enabled
-    file << enabled << "\n";
+// Band table, applied while dragging and saved once the edit is done
+static void drawParametricEqualizer() {
+    bool changed = false;
+    bool done = false;
+
+    changed |= ImGui::SliderFloat("Preamp", &parametricPreamp, -30.0f, 30.0f, "%.1f dB");
+    done |= ImGui::IsItemDeactivatedAfterEdit();
+
+    int removeBand = -1;
+    float tableHeight = std::max(100.0f, ImGui::GetContentRegionAvail().y - ImGui::GetFrameHeight() * 2.0f - 20.0f);
+    if (ImGui::BeginTable("##bands", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg |
+                          ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_ScrollY, ImVec2(0, tableHeight))) {
+        ImGui::TableSetupColumn("On");
+        ImGui::TableSetupColumn("Type");
+        ImGui::TableSetupColumn("Frequency");
+        ImGui::TableSetupColumn("Q");
+        ImGui::TableSetupColumn("Gain");
+        ImGui::TableSetupColumn("");
+        ImGui::TableHeadersRow();
+
+        for (int i = 0; i < (int)parametricBands.size(); ++i) {
+            EqBand& band = parametricBands[i];
+            ImGui::PushID(i);
+            ImGui::TableNextRow();
+
+            ImGui::TableNextColumn();
+            if (ImGui::Checkbox("##enabled", &band.enabled)) {
+                changed = done = true;
+            }
+
+            ImGui::TableNextColumn();
+            int type = static_cast<int>(band.type);
+            ImGui::SetNextItemWidth(110.0f);
+            if (ImGui::Combo("##type", &type, filterTypeLabels, filterTypeCount)) {
+                band.type = static_cast<EqFilterType>(type);
+                changed = done = true;
+            }
+
+            ImGui::TableNextColumn();
+            ImGui::SetNextItemWidth(140.0f);
+            changed |= ImGui::SliderFloat("##frequency", &band.frequency, 10.0f, 22000.0f, "%.0f Hz", ImGuiSliderFlags_Logarithmic);
+            done |= ImGui::IsItemDeactivatedAfterEdit();
+
+            ImGui::TableNextColumn();
+            ImGui::SetNextItemWidth(90.0f);
+            changed |= ImGui::SliderFloat("##q", &band.q, 0.1f, 20.0f, "%.2f", ImGuiSliderFlags_Logarithmic);
+            done |= ImGui::IsItemDeactivatedAfterEdit();
+
+            // Pass, notch and all-pass filters have no gain
+            ImGui::TableNextColumn();
+            ImGui::BeginDisabled(!eqFilterTypeHasGain(band.type));
+            ImGui::SetNextItemWidth(110.0f);
+            changed |= ImGui::SliderFloat("##gain", &band.gainDB, -30.0f, 30.0f, "%.1f dB");
+            done |= ImGui::IsItemDeactivatedAfterEdit();
+            ImGui::EndDisabled();
+
+            ImGui::TableNextColumn();
+            if (ImGui::SmallButton("Remove")) {
+                removeBand = i;
+            }
+
+            ImGui::PopID();
+        }
+        ImGui::EndTable();
+    }
 
-    // Sabe bands
-    for (float val : eqBands) {
-        file << val << " ";
+    if (removeBand >= 0) {
+        parametricBands.erase(parametricBands.begin() + removeBand);
+        changed = done = true;
     }
-    file << std::endl;
 
-    file.close();
+    ImGui::BeginDisabled((int)parametricBands.size() >= EQ_MAX_BANDS);
+    if (ImGui::Button("Add band")) {
+        parametricBands.push_back(EqBand());
+        changed = done = true;
+    }
+    ImGui::EndDisabled();
+
+    ImGui::SameLine();
+    if (ImGui::Button("Import preset...")) {
+        const char* filters[] = { "*.txt" };
+        const char* file = tinyfd_openFileDialog("Import EQ preset", "", 1, filters, "Equalizer APO / AutoEq preset", 0);
+        EqPreset preset;
+        if (file && loadEqPreset(file, preset)) {
+            parametricBands = preset.bands;
+            parametricPreamp = std::clamp(preset.preampDB, -30.0f, 30.0f);
+            changed = done = true;
+        }
+    }
+
+    ImGui::SameLine();
+    if (ImGui::Button("From graphic EQ")) {
+        parametricBands = graphicEqualizerBands(eqBands.data());
+        parametricPreamp = 0.0f;
+        changed = done = true;
+    }
+
+    ImGui::SameLine();
+    ImGui::TextDisabled("%d of %d bands", (int)parametricBands.size(), EQ_MAX_BANDS);
+
+    if (changed) {
+        sendEqualizerBands(parametricBands, parametricPreamp);
+    }
+    if (done) {
+        saveEQConfig();
+        std::cout << "Parametric EQ: " << parametricBands.size() << " bands, preamp "
+                  << parametricPreamp << "dB" << std::endl;
+    }
 }
 
 void drawEqualizerUI() {
@@ -72,7 +255,7 @@ void drawEqualizerUI() {
     }
 
     if (ImGui::Checkbox("Enable Equalizer", &enabled)) {
-        setEqualizerEnabled(enabled);
+        sendEqualizerEnabled(enabled);
         saveEQConfig();
     }
 
@@ -96,6 +279,23 @@ void drawEqualizerUI() {
         return;
     }
 
+    if (ImGui::RadioButton("Graphic", !parametric) && parametric) {
+        parametric = false;
+        applyEqualizerLayout();
+        saveEQConfig();
+    }
+    ImGui::SameLine();
+    if (ImGui::RadioButton("Parametric", parametric) && !parametric) {
+        parametric = true;
+        applyEqualizerLayout();
+        saveEQConfig();
+    }
+
+    if (parametric) {
+        drawParametricEqualizer();
+        return;
+    }
+
     const float sliderWidth = 20.0f;
     const float sliderHeight = 150.0f;
     const float spacing = 50.0f;
@@ -137,7 +337,7 @@ void drawEqualizerUI() {
         if (ImGui::VSliderFloat("##eq", ImVec2(sliderWidth, sliderHeight), &eqBands[i], -30.0f, 30.0f, "")) {
             if (eqBands[i] < -30.0f) eqBands[i] = -30.0f;
             if (eqBands[i] > 30.0f) eqBands[i] = 30.0f;
-            setEqualizerBand(i, eqBands[i]);
+            sendEqualizerBand(i, eqBands[i]);
             saveEQConfig();
         }
 
@@ -173,7 +373,7 @@ void drawEqualizerUI() {
         float rockPreset[] = { 5.0f, 3.0f, 2.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f };
         for (int i = 0; i < bandCount; ++i) {
             eqBands[i] = rockPreset[i];
-            setEqualizerBand(i, eqBands[i]);
+            sendEqualizerBand(i, eqBands[i]);
         }
         saveEQConfig();
     }
@@ -186,7 +386,7 @@ void drawEqualizerUI() {
     if (ImGui::Button("Reset", ImVec2(120, 40))) {
         for (int i = 0; i < bandCount; ++i) {
             eqBands[i] = 0.0f;
-            setEqualizerBand(i, 0.0f);
+            sendEqualizerBand(i, 0.0f);
         }
         saveEQConfig();
     }
@@ -200,7 +400,7 @@ void drawEqualizerUI() {
         float classicalPreset[] = { 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 2.0f, 5.0f, 6.0f };
         for (int i = 0; i < bandCount; ++i) {
             eqBands[i] = classicalPreset[i];
-            setEqualizerBand(i, eqBands[i]);
+            sendEqualizerBand(i, eqBands[i]);
         }
         saveEQConfig();
     }
@@ -0,0 +1,24 @@
+#include "file_identity.h"
+
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+uint64_t hashPath(const std::string& path) {
+    uint64_t h = 1469598103934665603ull;
+    for (unsigned char c : path) {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+bool statFile(const std::string& filepath, uint64_t& size, int64_t& mtime) {
+    std::error_code ec;
+    size = fs::file_size(filepath, ec);
+    if (ec) return false;
+    auto time = fs::last_write_time(filepath, ec);
+    if (ec) return false;
+    mtime = static_cast<int64_t>(time.time_since_epoch().count());
+    return true;
+}
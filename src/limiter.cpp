@@ -0,0 +1,291 @@
+#include "limiter.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define YABOKU_LIMITER_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define YABOKU_LIMITER_NEON
+#endif
+
+static const double PI = 3.14159265358979323846;
+static const int CHANNELS = 2;
+
+// ================= Setup =================
+
+void Limiter::initialize(float rate) {
+    sampleRate = rate;
+    size_t maxAttack = static_cast<size_t>(std::ceil(MAX_LOOKAHEAD_MS * 0.001f * sampleRate));
+    minValues.assign(maxAttack + 2, 1.0f);
+    minIndices.assign(maxAttack + 2, 0);
+    averageWindow.assign(maxAttack, 1.0f);
+    delay.assign((maxAttack + TAPS) * CHANNELS, 0.0f);
+    delayed.assign(CHUNK_FRAMES * CHANNELS, 0.0f);
+    history.assign(CHANNELS * (TAPS - 1 + CHUNK_FRAMES), 0.0f);
+    initialized = true;
+
+    // Force the derived state to be rebuilt for the new rate
+    LimiterSettings current = settings;
+    phases = 0;
+    setSettings(current);
+}
+
+void Limiter::setSettings(const LimiterSettings& next) {
+    if (!initialized) {
+        settings = next;
+        return;
+    }
+
+    LimiterSettings clamped = next;
+    clamped.ceilingDb = std::clamp(clamped.ceilingDb, -12.0f, 0.0f);
+    clamped.releaseMs = std::clamp(clamped.releaseMs, 1.0f, 2000.0f);
+    clamped.lookaheadMs = std::clamp(clamped.lookaheadMs, 0.1f, MAX_LOOKAHEAD_MS);
+
+    ceiling = std::pow(10.0f, clamped.ceilingDb / 20.0f);
+    releaseCoefficient = std::exp(-1.0 / (clamped.releaseMs * 0.001 * sampleRate));
+
+    // Oversampling only where it finds anything, above 176.4 kHz the samples are close enough
+    int nextPhases = 1;
+    if (clamped.truePeak) {
+        nextPhases = sampleRate < 88200.0f ? 4 : sampleRate < 176400.0f ? 2 : 1;
+    }
+    size_t nextAttack = static_cast<size_t>(std::lround(clamped.lookaheadMs * 0.001f * sampleRate));
+    nextAttack = std::clamp<size_t>(nextAttack, 1, averageWindow.size());
+
+    bool restart = nextPhases != phases || nextAttack != attackFrames || clamped.enabled != settings.enabled;
+    settings = clamped;
+    if (!restart) return;
+
+    phases = nextPhases;
+    attackFrames = nextAttack;
+    // Interpolated peaks sit up to a sample after the one they are reported for, hold one longer
+    detectorDelay = phases > 1 ? TAPS / 2 : 0;
+    holdFrames = attackFrames + (phases > 1 ? 1 : 0);
+    delayFrames = settings.enabled ? attackFrames - 1 + detectorDelay : 0;
+
+    // Windowed sinc, phase p interpolates at TAPS / 2 - p / phases samples back
+    std::memset(interpolation, 0, sizeof(interpolation));
+    for (int p = 0; p < phases; ++p) {
+        double sum = 0.0;
+        double taps[TAPS];
+        for (int k = 0; k < TAPS; ++k) {
+            double u = k - TAPS / 2 + static_cast<double>(p) / phases;
+            double sinc = u == 0.0 ? 1.0 : std::sin(PI * u) / (PI * u);
+            double window = 0.5 + 0.5 * std::cos(PI * u / (TAPS / 2 + 0.5));
+            taps[k] = sinc * window;
+            sum += taps[k];
+        }
+        for (int k = 0; k < TAPS; ++k) {
+            interpolation[k][p] = static_cast<float>(taps[k] / sum);
+        }
+    }
+
+    reset();
+}
+
+void Limiter::reset() {
+    std::fill(history.begin(), history.end(), 0.0f);
+    std::fill(delay.begin(), delay.end(), 0.0f);
+    delayPosition = 0;
+    minHead = 0;
+    minCount = 0;
+    frameIndex = 0;
+    released = 1.0;
+    std::fill(averageWindow.begin(), averageWindow.end(), 1.0f);
+    averagePosition = 0;
+    averageSum = static_cast<double>(attackFrames);
+    lastReductionDb = 0.0f;
+}
+
+// ================= Processing =================
+
+void Limiter::process(float* buffer, size_t frames) {
+    if (!initialized) return;
+
+    if (!settings.enabled) {
+        for (size_t i = 0; i < frames * CHANNELS; ++i) {
+            buffer[i] = std::clamp(buffer[i], -1.0f, 1.0f);
+        }
+        lastReductionDb = 0.0f;
+        return;
+    }
+
+    blockMinGain = 1.0f;
+    for (size_t done = 0; done < frames;) {
+        size_t count = std::min(frames - done, CHUNK_FRAMES);
+        float* chunk = buffer + done * CHANNELS;
+        detectPeaks(chunk, count);
+        computeGains(count);
+        delayAndApply(chunk, count);
+        done += count;
+    }
+    lastReductionDb = blockMinGain < 1.0f ? 20.0f * std::log10(blockMinGain) : 0.0f;
+}
+
+void Limiter::detectPeaks(const float* buffer, size_t frames) {
+    if (phases == 1) {
+        size_t i = 0;
+#if defined(YABOKU_LIMITER_SSE)
+        const __m128 signMask = _mm_set1_ps(-0.0f);
+        for (; i + 2 <= frames; i += 2) {
+            __m128 v = _mm_andnot_ps(signMask, _mm_loadu_ps(buffer + i * CHANNELS));
+            // Lanes 0 and 2 end up with the larger channel of each frame
+            v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+            peaks[i] = _mm_cvtss_f32(v);
+            peaks[i + 1] = _mm_cvtss_f32(_mm_movehl_ps(v, v));
+        }
+#elif defined(YABOKU_LIMITER_NEON)
+        for (; i + 2 <= frames; i += 2) {
+            float32x4_t v = vabsq_f32(vld1q_f32(buffer + i * CHANNELS));
+            float32x2_t m = vpmax_f32(vget_low_f32(v), vget_high_f32(v));
+            vst1_f32(peaks + i, m);
+        }
+#endif
+        for (; i < frames; ++i) {
+            peaks[i] = std::max(std::fabs(buffer[i * CHANNELS]), std::fabs(buffer[i * CHANNELS + 1]));
+        }
+        return;
+    }
+
+    // Deinterleave behind the last TAPS - 1 samples of the previous chunk
+    const size_t stride = TAPS - 1 + CHUNK_FRAMES;
+    float* left = history.data();
+    float* right = history.data() + stride;
+    for (size_t i = 0; i < frames; ++i) {
+        left[TAPS - 1 + i] = buffer[i * CHANNELS];
+        right[TAPS - 1 + i] = buffer[i * CHANNELS + 1];
+    }
+
+    // All phases of both channels at once, one vector lane per phase
+    for (size_t i = 0; i < frames; ++i) {
+        const float* l = left + TAPS - 1 + i;
+        const float* r = right + TAPS - 1 + i;
+#if defined(YABOKU_LIMITER_SSE)
+        __m128 accLeft = _mm_setzero_ps();
+        __m128 accRight = _mm_setzero_ps();
+        for (int k = 0; k < TAPS; ++k) {
+            __m128 h = _mm_loadu_ps(interpolation[k]);
+            accLeft = _mm_add_ps(accLeft, _mm_mul_ps(h, _mm_set1_ps(l[-k])));
+            accRight = _mm_add_ps(accRight, _mm_mul_ps(h, _mm_set1_ps(r[-k])));
+        }
+        const __m128 signMask = _mm_set1_ps(-0.0f);
+        __m128 m = _mm_max_ps(_mm_andnot_ps(signMask, accLeft), _mm_andnot_ps(signMask, accRight));
+        m = _mm_max_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+        m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+        peaks[i] = _mm_cvtss_f32(m);
+#elif defined(YABOKU_LIMITER_NEON)
+        float32x4_t accLeft = vdupq_n_f32(0.0f);
+        float32x4_t accRight = vdupq_n_f32(0.0f);
+        for (int k = 0; k < TAPS; ++k) {
+            float32x4_t h = vld1q_f32(interpolation[k]);
+            accLeft = vmlaq_n_f32(accLeft, h, l[-k]);
+            accRight = vmlaq_n_f32(accRight, h, r[-k]);
+        }
+        float32x4_t m = vmaxq_f32(vabsq_f32(accLeft), vabsq_f32(accRight));
+        float32x2_t half = vpmax_f32(vget_low_f32(m), vget_high_f32(m));
+        peaks[i] = vget_lane_f32(vpmax_f32(half, half), 0);
+#else
+        float peak = 0.0f;
+        for (int p = 0; p < phases; ++p) {
+            float accLeft = 0.0f;
+            float accRight = 0.0f;
+            for (int k = 0; k < TAPS; ++k) {
+                accLeft += interpolation[k][p] * l[-k];
+                accRight += interpolation[k][p] * r[-k];
+            }
+            peak = std::max(peak, std::max(std::fabs(accLeft), std::fabs(accRight)));
+        }
+        peaks[i] = peak;
+#endif
+    }
+
+    std::memmove(left, left + frames, (TAPS - 1) * sizeof(float));
+    std::memmove(right, right + frames, (TAPS - 1) * sizeof(float));
+}
+
+void Limiter::computeGains(size_t frames) {
+    const size_t capacity = minValues.size();
+    for (size_t i = 0; i < frames; ++i) {
+        float required = peaks[i] > ceiling ? ceiling / peaks[i] : 1.0f;
+
+        // Smallest gain any peak in the hold window needs
+        size_t index = frameIndex++;
+        while (minCount > 0 && minValues[(minHead + minCount - 1) % capacity] >= required) {
+            --minCount;
+        }
+        size_t back = (minHead + minCount) % capacity;
+        minValues[back] = required;
+        minIndices[back] = index;
+        ++minCount;
+        if (minIndices[minHead] + holdFrames <= index) {
+            minHead = (minHead + 1) % capacity;
+            --minCount;
+        }
+        float held = minValues[minHead];
+
+        // Instant attack (the average below smooths it), exponential release
+        released = held < released ? held : held + (released - held) * releaseCoefficient;
+
+        averageSum += released - averageWindow[averagePosition];
+        averageWindow[averagePosition] = static_cast<float>(released);
+        if (++averagePosition == attackFrames) {
+            // Re-sum once per window so rounding cannot build up
+            averagePosition = 0;
+            averageSum = 0.0;
+            for (size_t k = 0; k < attackFrames; ++k) averageSum += averageWindow[k];
+        }
+
+        float gain = std::min(static_cast<float>(averageSum / attackFrames), 1.0f);
+        gains[i] = gain;
+        blockMinGain = std::min(blockMinGain, gain);
+    }
+}
+
+void Limiter::delayAndApply(float* buffer, size_t frames) {
+    const float* source = buffer;
+    if (delayFrames > 0) {
+        // Swap the chunk with the oldest frames of the delay line, in runs up to its wrap
+        for (size_t done = 0; done < frames;) {
+            size_t run = std::min(frames - done, delayFrames - delayPosition);
+            float* slot = delay.data() + delayPosition * CHANNELS;
+            std::memcpy(delayed.data() + done * CHANNELS, slot, run * CHANNELS * sizeof(float));
+            std::memcpy(slot, buffer + done * CHANNELS, run * CHANNELS * sizeof(float));
+            delayPosition += run;
+            if (delayPosition == delayFrames) delayPosition = 0;
+            done += run;
+        }
+        source = delayed.data();
+    }
+
+    // The clamp only catches rounding, the gain already keeps the peaks down
+    size_t i = 0;
+#if defined(YABOKU_LIMITER_SSE)
+    const __m128 high = _mm_set1_ps(ceiling);
+    const __m128 low = _mm_set1_ps(-ceiling);
+    for (; i + 2 <= frames; i += 2) {
+        __m128 pair = _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(gains + i)));
+        __m128 gain = _mm_unpacklo_ps(pair, pair);
+        __m128 v = _mm_mul_ps(_mm_loadu_ps(source + i * CHANNELS), gain);
+        _mm_storeu_ps(buffer + i * CHANNELS, _mm_max_ps(_mm_min_ps(v, high), low));
+    }
+#elif defined(YABOKU_LIMITER_NEON)
+    const float32x4_t high = vdupq_n_f32(ceiling);
+    const float32x4_t low = vdupq_n_f32(-ceiling);
+    for (; i + 2 <= frames; i += 2) {
+        float32x2_t pair = vld1_f32(gains + i);
+        float32x4_t gain = vcombine_f32(vdup_lane_f32(pair, 0), vdup_lane_f32(pair, 1));
+        float32x4_t v = vmulq_f32(vld1q_f32(source + i * CHANNELS), gain);
+        vst1q_f32(buffer + i * CHANNELS, vmaxq_f32(vminq_f32(v, high), low));
+    }
+#endif
+    for (; i < frames; ++i) {
+        for (int ch = 0; ch < CHANNELS; ++ch) {
+            float v = source[i * CHANNELS + ch] * gains[i];
+            buffer[i * CHANNELS + ch] = std::clamp(v, -ceiling, ceiling);
+        }
+    }
+}
@@ -0,0 +1,362 @@
+#include "loudness.h"
+#include "decoder.h"
+#include "audio_probe.h"
+#include "metadata_store.h"
+#include "waveform.h"
+
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <pthread.h>
+#else
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static const double PI = 3.14159265358979323846;
+static const double ABSOLUTE_GATE_LUFS = -70.0;
+static const double RELATIVE_GATE_LU = -10.0;
+
+static double energyToLufs(double energy) {
+    return energy > 0.0 ? -0.691 + 10.0 * std::log10(energy) : ABSOLUTE_GATE_LUFS;
+}
+
+static double lufsToEnergy(double lufs) {
+    return std::pow(10.0, (lufs + 0.691) / 10.0);
+}
+
+// ================= Meter =================
+
+LoudnessMeter::LoudnessMeter(int sampleRate, int channelCount) : channels(std::max(channelCount, 1)) {
+    const double fs = sampleRate > 0 ? sampleRate : 44100.0;
+
+    // K-weighting, BS.1770 filters derived for any rate. Stage 1: +4 dB
+    // high shelf modelling the head, stage 2: high-pass (RLB curve).
+    double f0 = 1681.974450955533;
+    double gainDb = 3.999843853973347;
+    double q = 0.7071752369554196;
+    double k = std::tan(PI * f0 / fs);
+    double vh = std::pow(10.0, gainDb / 20.0);
+    double vb = std::pow(vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+    Biquad shelfFilter{(vh + vb * k / q + k * k) / a0, 2.0 * (k * k - vh) / a0, (vh - vb * k / q + k * k) / a0,
+                       2.0 * (k * k - 1.0) / a0, (1.0 - k / q + k * k) / a0};
+
+    f0 = 38.13547087602444;
+    q = 0.5003270373238773;
+    k = std::tan(PI * f0 / fs);
+    a0 = 1.0 + k / q + k * k;
+    Biquad highPassFilter{1.0, -2.0, 1.0, 2.0 * (k * k - 1.0) / a0, (1.0 - k / q + k * k) / a0};
+
+    shelf.assign(channels, shelfFilter);
+    highPass.assign(channels, highPassFilter);
+
+    // WAVE order: LFE is left out, surrounds count 1.41 (+1.5 dB)
+    weights.assign(channels, 1.0);
+    if (channels >= 6) {
+        weights[3] = 0.0;
+        for (int c = 4; c < channels; ++c) weights[c] = 1.41;
+    }
+
+    subBlockFrames = std::max<size_t>(static_cast<size_t>(std::lround(fs / 10.0)), 1);
+    blockEnergies.reserve(static_cast<size_t>(600 * 10));   // ten minutes without reallocating
+
+    // Interpolation filter: windowed sinc split into polyphase branches
+    oversampling = fs < 96000.0 ? 4 : (fs < 192000.0 ? 2 : 1);
+    tapsPerPhase = oversampling > 1 ? 12 : 1;
+    const int length = oversampling * tapsPerPhase;
+    interpolation.assign(length, 0.0f);
+    for (int phase = 0; phase < oversampling; ++phase) {
+        double sum = 0.0;
+        std::vector<double> branch(tapsPerPhase);
+        for (int tap = 0; tap < tapsPerPhase; ++tap) {
+            int n = phase + tap * oversampling;
+            double x = (n - (length - 1) / 2.0) / oversampling;
+            double sinc = std::abs(x) < 1e-9 ? 1.0 : std::sin(PI * x) / (PI * x);
+            double window = 0.5 - 0.5 * std::cos(2.0 * PI * (n + 0.5) / length);
+            branch[tap] = sinc * window;
+            sum += branch[tap];
+        }
+        // Stored newest-last so a branch is a plain dot product with the history window
+        for (int tap = 0; tap < tapsPerPhase; ++tap) {
+            interpolation[phase * tapsPerPhase + (tapsPerPhase - 1 - tap)] =
+                static_cast<float>(sum != 0.0 ? branch[tap] / sum : branch[tap]);
+        }
+    }
+    // Every sample is written twice, the last tapsPerPhase are always contiguous
+    history.assign(static_cast<size_t>(channels) * tapsPerPhase * 2, 0.0f);
+}
+
+void LoudnessMeter::process(const float* samples, size_t frames) {
+    const size_t taps = static_cast<size_t>(tapsPerPhase);
+    for (size_t frame = 0; frame < frames; ++frame) {
+        double energy = 0.0;
+        for (int c = 0; c < channels; ++c) {
+            float x = samples[frame * channels + c];
+            double y = highPass[c].process(shelf[c].process(x));
+            energy += weights[c] * y * y;
+
+            float* window = &history[c * taps * 2];
+            window[historyPosition] = x;
+            window[historyPosition + taps] = x;
+            const float* recent = window + historyPosition + 1;
+            double framePeak = std::abs(x);
+            if (oversampling > 1) {
+                for (int phase = 0; phase < oversampling; ++phase) {
+                    const float* h = &interpolation[phase * taps];
+                    float acc = 0.0f;
+                    for (size_t tap = 0; tap < taps; ++tap) acc += h[tap] * recent[tap];
+                    framePeak = std::max(framePeak, static_cast<double>(std::abs(acc)));
+                }
+            }
+            peak = std::max(peak, framePeak);
+        }
+        historyPosition = (historyPosition + 1) % taps;
+
+        subBlockEnergy += energy;
+        if (++subBlockPosition == subBlockFrames) {
+            recentSubBlocks[subBlockCount % 4] = subBlockEnergy / subBlockFrames;
+            ++subBlockCount;
+            subBlockEnergy = 0.0;
+            subBlockPosition = 0;
+            if (subBlockCount >= 4) {
+                blockEnergies.push_back((recentSubBlocks[0] + recentSubBlocks[1] +
+                                         recentSubBlocks[2] + recentSubBlocks[3]) / 4.0);
+            }
+        }
+    }
+}
+
+double LoudnessMeter::gatedMean(double& count) const {
+    const double absoluteGate = lufsToEnergy(ABSOLUTE_GATE_LUFS);
+    double sum = 0.0;
+    count = 0.0;
+    for (double energy : blockEnergies) {
+        if (energy > absoluteGate) {
+            sum += energy;
+            count += 1.0;
+        }
+    }
+    if (count == 0.0) return 0.0;
+
+    const double relativeGate = sum / count * std::pow(10.0, RELATIVE_GATE_LU / 10.0);
+    sum = 0.0;
+    count = 0.0;
+    for (double energy : blockEnergies) {
+        if (energy > absoluteGate && energy > relativeGate) {
+            sum += energy;
+            count += 1.0;
+        }
+    }
+    return count > 0.0 ? sum / count : 0.0;
+}
+
+double LoudnessMeter::integratedLufs() const {
+    double count;
+    return std::max(energyToLufs(gatedMean(count)), ABSOLUTE_GATE_LUFS);
+}
+
+double LoudnessMeter::truePeak() const {
+    return peak;
+}
+
+uint32_t LoudnessMeter::gatedBlocks() const {
+    double count;
+    gatedMean(count);
+    return static_cast<uint32_t>(count);
+}
+
+TrackLoudness LoudnessMeter::result() const {
+    TrackLoudness loudness;
+    loudness.analyzed = true;
+    loudness.integratedLufs = static_cast<float>(integratedLufs());
+    loudness.truePeakDb = static_cast<float>(std::max(20.0 * std::log10(std::max(peak, 1e-9)), ABSOLUTE_GATE_LUFS));
+    loudness.gatedBlocks = gatedBlocks();
+    return loudness;
+}
+
+TrackLoudness combineAlbumLoudness(const std::vector<TrackLoudness>& tracks) {
+    TrackLoudness album;
+    album.analyzed = true;
+    double energy = 0.0;
+    double blocks = 0.0;
+    for (const TrackLoudness& track : tracks) {
+        if (!track.analyzed) continue;
+        energy += lufsToEnergy(track.integratedLufs) * track.gatedBlocks;
+        blocks += track.gatedBlocks;
+        album.truePeakDb = std::max(album.truePeakDb, track.truePeakDb);
+    }
+    album.gatedBlocks = static_cast<uint32_t>(blocks);
+    album.integratedLufs = blocks > 0.0
+        ? static_cast<float>(std::max(energyToLufs(energy / blocks), ABSOLUTE_GATE_LUFS))
+        : static_cast<float>(ABSOLUTE_GATE_LUFS);
+    return album;
+}
+
+// ================= Background analysis =================
+
+static std::vector<std::thread> workers;
+static std::mutex queueMutex;
+static std::condition_variable queueCondition;
+static std::deque<std::string> queue;
+static std::unordered_set<std::string> queued;   // waiting or being analyzed
+static std::unordered_set<std::string> checked;  // analyzed or found cached this session
+static bool stopping = false;
+static std::atomic<bool> paused{false};
+static std::atomic<uint32_t> resultCount{0};
+
+// Below every normal thread, the decoder threads feeding playback always win
+static void lowerThreadPriority() {
+#ifdef _WIN32
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_IDLE);
+#elif defined(__APPLE__)
+    pthread_set_qos_class_self_np(QOS_CLASS_BACKGROUND, 0);
+#else
+    // Linux applies the nice value per thread
+    setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 19);
+#endif
+}
+
+static bool isStopping() {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    return stopping;
+}
+
+static void analyzeTrack(const std::string& filepath) {
+    // One decode pass serves both, whatever is missing gets computed
+    TrackLoudness cached;
+    bool needLoudness = !getTrackLoudness(filepath, cached);
+    bool needWaveform = !hasWaveform(filepath);
+    if (!needLoudness && !needWaveform) return;
+
+    // The store only keeps loudness next to probed metadata
+    if (needLoudness && !probeAudio(filepath).valid) return;
+
+    std::unique_ptr<Decoder> decoder = createDecoder(filepath);
+    if (!decoder || decoder->channels() <= 0) {
+        std::cerr << "Loudness analysis: cannot decode " << filepath << std::endl;
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    LoudnessMeter meter(decoder->sampleRate(), decoder->channels());
+    WaveformPyramid waveform;
+    waveform.begin(decoder->sampleRate(), decoder->channels());
+    const size_t chunkFrames = 4096;
+    std::vector<float> chunk(chunkFrames * decoder->channels());
+    while (size_t frames = decoder->read(chunk.data(), chunkFrames)) {
+        if (needLoudness) meter.process(chunk.data(), frames);
+        if (needWaveform) waveform.add(chunk.data(), frames);
+        while (paused.load(std::memory_order_relaxed) && !isStopping()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        if (isStopping()) return;
+    }
+
+    if (needWaveform) {
+        waveform.finish();
+        storeWaveform(filepath, waveform);
+    }
+    if (needLoudness) {
+        TrackLoudness loudness = meter.result();
+        storeLoudness(filepath, loudness);
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Loudness: " << filepath << ": " << loudness.integratedLufs << " LUFS, peak "
+                  << loudness.truePeakDb << " dBTP (" << elapsed << "s)" << std::endl;
+    }
+    resultCount.fetch_add(1, std::memory_order_release);
+}
+
+static void workerLoop() {
+    lowerThreadPriority();
+    while (true) {
+        std::string filepath;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueCondition.wait(lock, [] { return stopping || !queue.empty(); });
+            if (stopping) return;
+            filepath = queue.front();
+            queue.pop_front();
+        }
+
+        analyzeTrack(filepath);
+
+        std::lock_guard<std::mutex> lock(queueMutex);
+        queued.erase(filepath);
+        checked.insert(filepath);
+    }
+}
+
+void startLoudnessAnalysis() {
+    if (!workers.empty()) return;
+    stopping = false;
+    // A couple of cores at most, playback and the UI keep the rest
+    unsigned int cores = std::max(std::thread::hardware_concurrency(), 1u);
+    unsigned int count = std::clamp(cores / 2, 1u, 2u);
+    for (unsigned int i = 0; i < count; ++i) {
+        workers.emplace_back(workerLoop);
+    }
+}
+
+void stopLoudnessAnalysis() {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+        queue.clear();
+        queued.clear();
+    }
+    queueCondition.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+}
+
+void queueLoudnessAnalysis(const std::string& filepath, bool first) {
+    if (workers.empty()) return;
+    // Already analyzed tracks are skipped by the worker, no file access on the caller's thread
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        if (checked.count(filepath)) return;
+        if (!queued.insert(filepath).second) {
+            // Still waiting: move it up, unless a worker has it already. Only
+            // the front request searches, the playlist's rest just returns
+            if (!first) return;
+            auto it = std::find(queue.begin(), queue.end(), filepath);
+            if (it == queue.end()) return;
+            queue.erase(it);
+        }
+        if (first) queue.push_front(filepath);
+        else queue.push_back(filepath);
+    }
+    queueCondition.notify_one();
+}
+
+void setLoudnessAnalysisPaused(bool value) {
+    paused.store(value, std::memory_order_relaxed);
+}
+
+size_t pendingLoudnessAnalyses() {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    return queued.size();
+}
+
+uint32_t loudnessResultCount() {
+    return resultCount.load(std::memory_order_acquire);
+}
+
+bool getTrackLoudness(const std::string& filepath, TrackLoudness& loudness) {
+    return lookupLoudness(filepath, loudness) && loudness.analyzed;
+}
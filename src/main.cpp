@@ -2,11 +2,18 @@
 #include "equalizer_ui.h"
 #include "player.h"
 #include "ui_style.h"
+#include "render.h"
 
 #include <ctime>
 #include <cstdlib>
+#include <string>
+
+int main(int argc, char** argv) {
+    // Headless, no window and no audio device
+    if (argc > 1 && std::string(argv[1]) == "--render") {
+        return runRenderCommand(argc, argv);
+    }
 
-int main() {
     initWindow();
 
     applyCustomStyle();
@@ -0,0 +1,514 @@
+#include "metadata_store.h"
+#include "file_identity.h"
+
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <filesystem>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace fs = std::filesystem;
+
+std::unique_ptr<MetadataStore> g_metadataStore = nullptr;
+
+// ================= On-disk layout =================
+
+static const char STORE_MAGIC[8] = {'Y', 'B', 'M', 'E', 'T', 'A', '\0', '\0'};
+static const uint32_t STORE_VERSION = 2;   // 2: loudness
+
+struct StoreHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t bucketCount;     // power of two, bucket heads follow the header
+    uint32_t reserved;
+    uint64_t recordsOffset;
+    uint64_t stringsOffset;
+    uint64_t stringsSize;
+};
+
+struct StringRef {
+    uint32_t offset;
+    uint32_t length;
+};
+
+enum RecordFlags : uint32_t {
+    RECORD_VALID = 1,
+    RECORD_HAS_COVER = 2,
+    RECORD_HAS_LOUDNESS = 4
+};
+
+struct StoreRecord {
+    uint64_t pathHash;
+    uint64_t fileSize;
+    int64_t mtime;
+    uint32_t next;            // index + 1 of the next record in the bucket, 0 ends the chain
+    uint32_t flags;
+    float sampleRate;
+    float duration;
+    int32_t channels;
+    int32_t bitrate;
+    int32_t bitDepth;
+    int32_t year;
+    int32_t trackNumber;
+    uint32_t gatedBlocks;
+    float integratedLufs;
+    float truePeakDb;
+    StringRef path;
+    StringRef codec;
+    StringRef title;
+    StringRef artist;
+    StringRef album;
+    StringRef genre;
+};
+
+static_assert(sizeof(StoreHeader) % 8 == 0, "header must keep records aligned");
+static_assert(sizeof(StoreRecord) % 8 == 0, "records must stay aligned");
+
+// ================= MetadataStore =================
+
+MetadataStore::MetadataStore() {}
+
+MetadataStore::~MetadataStore() {
+    close();
+}
+
+bool MetadataStore::open(const std::string& storePath) {
+    std::lock_guard<std::mutex> lock(mutex);
+    path = storePath;
+    if (!fs::exists(path)) {
+        std::cout << "Metadata store is empty: " << path << std::endl;
+        return true;
+    }
+    if (!mapFile()) {
+        std::cerr << "Metadata store unreadable, starting a new one: " << path << std::endl;
+        return false;
+    }
+    std::cout << "Metadata store: " << reinterpret_cast<const StoreHeader*>(data)->entryCount
+              << " entries" << std::endl;
+    return true;
+}
+
+void MetadataStore::close() {
+    save();
+    std::lock_guard<std::mutex> lock(mutex);
+    unmapFile();
+}
+
+bool MetadataStore::mapFile() {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart < (LONGLONG)sizeof(StoreHeader)) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        CloseHandle(file);
+        return false;
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    fileHandle = file;
+    mappingHandle = mapping;
+    data = static_cast<const uint8_t*>(view);
+    dataSize = static_cast<size_t>(size.QuadPart);
+#else
+    fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(StoreHeader)) {
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+    void* view = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (view == MAP_FAILED) {
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+    data = static_cast<const uint8_t*>(view);
+    dataSize = static_cast<size_t>(st.st_size);
+#endif
+
+    // Reject anything that isn't a complete store of this version
+    const StoreHeader* header = reinterpret_cast<const StoreHeader*>(data);
+    bool valid = std::memcmp(header->magic, STORE_MAGIC, 8) == 0
+        && header->version == STORE_VERSION
+        && header->bucketCount > 0 && (header->bucketCount & (header->bucketCount - 1)) == 0
+        && sizeof(StoreHeader) + header->bucketCount * sizeof(uint32_t) <= header->recordsOffset
+        && header->recordsOffset + header->entryCount * sizeof(StoreRecord) <= header->stringsOffset
+        && header->stringsOffset + header->stringsSize <= dataSize;
+    if (!valid) {
+        unmapFile();
+        return false;
+    }
+    return true;
+}
+
+void MetadataStore::unmapFile() {
+    if (!data) return;
+#ifdef _WIN32
+    UnmapViewOfFile(data);
+    CloseHandle(mappingHandle);
+    CloseHandle(fileHandle);
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+#else
+    munmap(const_cast<uint8_t*>(data), dataSize);
+    ::close(fd);
+    fd = -1;
+#endif
+    data = nullptr;
+    dataSize = 0;
+}
+
+static std::string readString(const uint8_t* data, const StoreHeader* header, StringRef ref) {
+    if (static_cast<uint64_t>(ref.offset) + ref.length > header->stringsSize) return "";
+    return std::string(reinterpret_cast<const char*>(data + header->stringsOffset + ref.offset), ref.length);
+}
+
+static bool stringEquals(const uint8_t* data, const StoreHeader* header, StringRef ref, const std::string& s) {
+    if (ref.length != s.size() || static_cast<uint64_t>(ref.offset) + ref.length > header->stringsSize) return false;
+    return std::memcmp(data + header->stringsOffset + ref.offset, s.data(), s.size()) == 0;
+}
+
+bool MetadataStore::findMapped(const std::string& filepath, Entry& entry) const {
+    if (!data) return false;
+
+    const StoreHeader* header = reinterpret_cast<const StoreHeader*>(data);
+    const uint32_t* buckets = reinterpret_cast<const uint32_t*>(data + sizeof(StoreHeader));
+    const StoreRecord* records = reinterpret_cast<const StoreRecord*>(data + header->recordsOffset);
+
+    uint64_t hash = hashPath(filepath);
+    uint32_t index = buckets[hash & (header->bucketCount - 1)];
+    while (index != 0 && index <= header->entryCount) {
+        const StoreRecord& r = records[index - 1];
+        if (r.pathHash == hash && stringEquals(data, header, r.path, filepath)) {
+            entry.fileSize = r.fileSize;
+            entry.mtime = r.mtime;
+            entry.info.valid = (r.flags & RECORD_VALID) != 0;
+            entry.info.hasCover = (r.flags & RECORD_HAS_COVER) != 0;
+            entry.info.sampleRate = r.sampleRate;
+            entry.info.duration = r.duration;
+            entry.info.channels = r.channels;
+            entry.info.bitrate = r.bitrate;
+            entry.info.bitDepth = r.bitDepth;
+            entry.info.year = r.year;
+            entry.info.trackNumber = r.trackNumber;
+            entry.info.codec = readString(data, header, r.codec);
+            entry.info.title = readString(data, header, r.title);
+            entry.info.artist = readString(data, header, r.artist);
+            entry.info.album = readString(data, header, r.album);
+            entry.info.genre = readString(data, header, r.genre);
+            entry.loudness.analyzed = (r.flags & RECORD_HAS_LOUDNESS) != 0;
+            entry.loudness.integratedLufs = r.integratedLufs;
+            entry.loudness.truePeakDb = r.truePeakDb;
+            entry.loudness.gatedBlocks = r.gatedBlocks;
+            return true;
+        }
+        index = r.next;
+    }
+    return false;
+}
+
+// Caller holds the mutex
+bool MetadataStore::findEntry(const std::string& filepath, Entry& entry, uint64_t fileSize, int64_t mtime) {
+    auto it = pending.find(filepath);
+    if (it != pending.end()) {
+        entry = it->second;
+    } else if (!findMapped(filepath, entry)) {
+        return false;
+    }
+
+    // Revalidate lazily: a modified file is a miss and gets probed again
+    if (entry.fileSize != fileSize || entry.mtime != mtime) {
+        ++staleHits;
+        return false;
+    }
+    return true;
+}
+
+bool MetadataStore::lookup(const std::string& filepath, AudioInfo& info) {
+    uint64_t fileSize;
+    int64_t mtime;
+    if (!statFile(filepath, fileSize, mtime)) return false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry entry;
+    if (!findEntry(filepath, entry, fileSize, mtime) || !entry.info.valid) return false;
+    info = entry.info;
+    return true;
+}
+
+void MetadataStore::store(const std::string& filepath, const AudioInfo& info) {
+    Entry entry;
+    if (!statFile(filepath, entry.fileSize, entry.mtime)) return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    // A re-probe of an unchanged file keeps its loudness
+    Entry existing;
+    if (findEntry(filepath, existing, entry.fileSize, entry.mtime)) {
+        entry.loudness = existing.loudness;
+    }
+    entry.info = info;
+    pending[filepath] = entry;
+}
+
+bool MetadataStore::lookupLoudness(const std::string& filepath, TrackLoudness& loudness) {
+    uint64_t fileSize;
+    int64_t mtime;
+    if (!statFile(filepath, fileSize, mtime)) return false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry entry;
+    if (!findEntry(filepath, entry, fileSize, mtime)) return false;
+    loudness = entry.loudness;
+    return true;
+}
+
+void MetadataStore::storeLoudness(const std::string& filepath, const TrackLoudness& loudness) {
+    uint64_t fileSize;
+    int64_t mtime;
+    if (!statFile(filepath, fileSize, mtime)) return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry entry;
+    if (!findEntry(filepath, entry, fileSize, mtime)) return;   // changed while it was analyzed
+    entry.loudness = loudness;
+    pending[filepath] = entry;
+}
+
+size_t MetadataStore::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t mapped = data ? reinterpret_cast<const StoreHeader*>(data)->entryCount : 0;
+    return mapped + pending.size();
+}
+
+size_t MetadataStore::pendingCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return pending.size();
+}
+
+std::unordered_map<std::string, MetadataStore::Entry> MetadataStore::collectEntries(bool dropStale, size_t& removed) const {
+    std::unordered_map<std::string, Entry> entries;
+    removed = 0;
+
+    auto keep = [&](const std::string& filepath, const Entry& entry) {
+        // Failed probes, kept by older versions, would hide the file for good
+        if (!entry.info.valid) {
+            ++removed;
+            return;
+        }
+        if (dropStale) {
+            uint64_t fileSize;
+            int64_t mtime;
+            if (!statFile(filepath, fileSize, mtime) || fileSize != entry.fileSize || mtime != entry.mtime) {
+                ++removed;
+                return;
+            }
+        }
+        entries[filepath] = entry;
+    };
+
+    if (data) {
+        const StoreHeader* header = reinterpret_cast<const StoreHeader*>(data);
+        const StoreRecord* records = reinterpret_cast<const StoreRecord*>(data + header->recordsOffset);
+        for (uint32_t i = 0; i < header->entryCount; ++i) {
+            std::string filepath = readString(data, header, records[i].path);
+            if (pending.count(filepath)) continue;   // superseded this session
+            Entry entry;
+            if (findMapped(filepath, entry)) keep(filepath, entry);
+        }
+    }
+
+    for (const auto& [filepath, entry] : pending) {
+        keep(filepath, entry);
+    }
+    return entries;
+}
+
+bool MetadataStore::writeFile(const std::unordered_map<std::string, Entry>& entries) {
+    uint32_t bucketCount = 16;
+    while (bucketCount < entries.size() * 2) bucketCount <<= 1;
+
+    std::vector<uint32_t> buckets(bucketCount, 0);
+    std::vector<StoreRecord> records;
+    std::vector<char> strings;
+    records.reserve(entries.size());
+
+    auto addString = [&](const std::string& s) {
+        StringRef ref{static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(s.size())};
+        strings.insert(strings.end(), s.begin(), s.end());
+        return ref;
+    };
+
+    for (const auto& [filepath, entry] : entries) {
+        StoreRecord r{};
+        r.pathHash = hashPath(filepath);
+        r.fileSize = entry.fileSize;
+        r.mtime = entry.mtime;
+        r.flags = 0;
+        if (entry.info.valid) r.flags |= RECORD_VALID;
+        if (entry.info.hasCover) r.flags |= RECORD_HAS_COVER;
+        if (entry.loudness.analyzed) r.flags |= RECORD_HAS_LOUDNESS;
+        r.sampleRate = entry.info.sampleRate;
+        r.duration = entry.info.duration;
+        r.channels = entry.info.channels;
+        r.bitrate = entry.info.bitrate;
+        r.bitDepth = entry.info.bitDepth;
+        r.year = entry.info.year;
+        r.trackNumber = entry.info.trackNumber;
+        r.gatedBlocks = entry.loudness.gatedBlocks;
+        r.integratedLufs = entry.loudness.integratedLufs;
+        r.truePeakDb = entry.loudness.truePeakDb;
+        r.path = addString(filepath);
+        r.codec = addString(entry.info.codec);
+        r.title = addString(entry.info.title);
+        r.artist = addString(entry.info.artist);
+        r.album = addString(entry.info.album);
+        r.genre = addString(entry.info.genre);
+
+        uint32_t bucket = r.pathHash & (bucketCount - 1);
+        r.next = buckets[bucket];
+        records.push_back(r);
+        buckets[bucket] = static_cast<uint32_t>(records.size());
+    }
+
+    StoreHeader header{};
+    std::memcpy(header.magic, STORE_MAGIC, 8);
+    header.version = STORE_VERSION;
+    header.entryCount = static_cast<uint32_t>(records.size());
+    header.bucketCount = bucketCount;
+    header.recordsOffset = (sizeof(StoreHeader) + bucketCount * sizeof(uint32_t) + 7) & ~uint64_t(7);
+    header.stringsOffset = header.recordsOffset + records.size() * sizeof(StoreRecord);
+    header.stringsSize = strings.size();
+
+    // Write next to the store and swap it in, a crash never leaves a half-written file
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cerr << "Failed to write metadata store: " << tempPath << std::endl;
+            return false;
+        }
+        std::vector<char> padding(header.recordsOffset - sizeof(StoreHeader) - bucketCount * sizeof(uint32_t), 0);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(buckets.data()), buckets.size() * sizeof(uint32_t));
+        out.write(padding.data(), padding.size());
+        out.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(StoreRecord));
+        out.write(strings.data(), strings.size());
+        if (!out) return false;
+    }
+
+    unmapFile();
+    std::error_code ec;
+    fs::rename(tempPath, path, ec);
+    if (ec) {
+        std::cerr << "Failed to replace metadata store: " << ec.message() << std::endl;
+    }
+    mapFile();
+    return !ec;
+}
+
+bool MetadataStore::save() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (path.empty() || pending.empty()) return true;
+
+    // Many stale hits this session: drop dead entries while rewriting anyway
+    size_t mapped = data ? reinterpret_cast<const StoreHeader*>(data)->entryCount : 0;
+    bool dropStale = staleHits * 10 > mapped;
+
+    size_t removed = 0;
+    auto entries = collectEntries(dropStale, removed);
+    if (!writeFile(entries)) return false;
+
+    std::cout << "Metadata store saved: " << entries.size() << " entries";
+    if (dropStale) std::cout << ", " << removed << " stale removed";
+    std::cout << std::endl;
+
+    pending.clear();
+    staleHits = 0;
+    return true;
+}
+
+size_t MetadataStore::compact() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (path.empty()) return 0;
+
+    size_t removed = 0;
+    auto entries = collectEntries(true, removed);
+    if (writeFile(entries)) {
+        pending.clear();
+        staleHits = 0;
+        std::cout << "Metadata store compacted: " << entries.size() << " entries, "
+                  << removed << " removed" << std::endl;
+    }
+    return removed;
+}
+
+// ================= For player =================
+
+void openMetadataStore(const std::string& storePath) {
+    if (!g_metadataStore) {
+        g_metadataStore = std::make_unique<MetadataStore>();
+    }
+    g_metadataStore->open(storePath);
+}
+
+void closeMetadataStore() {
+    g_metadataStore.reset();
+}
+
+bool lookupMetadata(const std::string& filepath, AudioInfo& info) {
+    return g_metadataStore ? g_metadataStore->lookup(filepath, info) : false;
+}
+
+void storeMetadata(const std::string& filepath, const AudioInfo& info) {
+    if (g_metadataStore) {
+        g_metadataStore->store(filepath, info);
+    }
+}
+
+bool lookupLoudness(const std::string& filepath, TrackLoudness& loudness) {
+    return g_metadataStore ? g_metadataStore->lookupLoudness(filepath, loudness) : false;
+}
+
+void storeLoudness(const std::string& filepath, const TrackLoudness& loudness) {
+    if (g_metadataStore) {
+        g_metadataStore->storeLoudness(filepath, loudness);
+    }
+}
+
+void saveMetadataStore() {
+    if (g_metadataStore) {
+        g_metadataStore->save();
+    }
+}
+
+size_t compactMetadataStore() {
+    return g_metadataStore ? g_metadataStore->compact() : 0;
+}
+
+size_t metadataStoreSize() {
+    return g_metadataStore ? g_metadataStore->size() : 0;
+}
+
+size_t pendingMetadataCount() {
+    return g_metadataStore ? g_metadataStore->pendingCount() : 0;
+}
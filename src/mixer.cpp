@@ -0,0 +1,212 @@
+#include "mixer.h"
+
+#include <cmath>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define YABOKU_MIX_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define YABOKU_MIX_NEON
+#endif
+
+static const float HALF_PI = 1.57079632679f;
+static const float PI = 3.14159265359f;
+
+// ================= Curves =================
+
+const char* fadeCurveName(FadeCurve curve) {
+    switch (curve) {
+        case FadeCurve::Linear: return "linear";
+        case FadeCurve::EqualPower: return "equal-power";
+        case FadeCurve::SCurve: return "s-curve";
+    }
+    return "equal-power";
+}
+
+FadeCurve fadeCurveFromName(const std::string& name) {
+    if (name == "linear") return FadeCurve::Linear;
+    if (name == "s-curve") return FadeCurve::SCurve;
+    return FadeCurve::EqualPower;
+}
+
+float fadeGain(FadeCurve curve, float t) {
+    t = std::clamp(t, 0.0f, 1.0f);
+    switch (curve) {
+        case FadeCurve::Linear:
+            return t;
+        case FadeCurve::EqualPower:
+            // sin^2 + cos^2 = 1, constant power for uncorrelated material
+            return std::sin(t * HALF_PI);
+        case FadeCurve::SCurve:
+            return 0.5f - 0.5f * std::cos(t * PI);
+    }
+    return t;
+}
+
+float FadeEnvelope::gainAt(size_t pos) const {
+    if (length == 0) return fadingIn ? 1.0f : 0.0f;
+    float t = static_cast<float>(std::min(pos, length)) / static_cast<float>(length);
+    return fadeGain(curve, fadingIn ? t : 1.0f - t);
+}
+
+void FadeEnvelope::advance(size_t frames, float& gainStart, float& gainEnd) {
+    gainStart = gainAt(position);
+    position = std::min(position + frames, length);
+    gainEnd = gainAt(position);
+}
+
+// ================= Kernels =================
+
+// dst = dst + src * g (Accumulate) or dst = dst * g, g ramping per frame
+template <bool Accumulate>
+static void rampKernel(float* dst, const float* src, size_t frames, int channels, float gainStart, float gainEnd) {
+    if (frames == 0) return;
+    const float step = (gainEnd - gainStart) / static_cast<float>(frames);
+    size_t frame = 0;
+    float gain = gainStart;
+
+    if (channels == 2) {
+        // Two stereo frames per vector: gains {g, g, g + step, g + step}
+#if defined(YABOKU_MIX_SSE)
+        __m128 gains = _mm_setr_ps(gain, gain, gain + step, gain + step);
+        const __m128 gainStep = _mm_set1_ps(step * 2.0f);
+        for (; frame + 2 <= frames; frame += 2) {
+            __m128 d = _mm_loadu_ps(dst + frame * 2);
+            if (Accumulate) {
+                __m128 s = _mm_loadu_ps(src + frame * 2);
+                d = _mm_add_ps(d, _mm_mul_ps(s, gains));
+            } else {
+                d = _mm_mul_ps(d, gains);
+            }
+            _mm_storeu_ps(dst + frame * 2, d);
+            gains = _mm_add_ps(gains, gainStep);
+        }
+        gain = gainStart + step * frame;
+#elif defined(YABOKU_MIX_NEON)
+        const float initial[4] = {gain, gain, gain + step, gain + step};
+        float32x4_t gains = vld1q_f32(initial);
+        const float32x4_t gainStep = vdupq_n_f32(step * 2.0f);
+        for (; frame + 2 <= frames; frame += 2) {
+            float32x4_t d = vld1q_f32(dst + frame * 2);
+            if (Accumulate) {
+                d = vmlaq_f32(d, vld1q_f32(src + frame * 2), gains);
+            } else {
+                d = vmulq_f32(d, gains);
+            }
+            vst1q_f32(dst + frame * 2, d);
+            gains = vaddq_f32(gains, gainStep);
+        }
+        gain = gainStart + step * frame;
+#endif
+    }
+
+    for (; frame < frames; ++frame) {
+        for (int c = 0; c < channels; ++c) {
+            size_t i = frame * channels + c;
+            if (Accumulate) {
+                dst[i] += src[i] * gain;
+            } else {
+                dst[i] *= gain;
+            }
+        }
+        gain += step;
+    }
+}
+
+void mixWithRamp(float* dst, const float* src, size_t frames, int channels, float gainStart, float gainEnd) {
+    rampKernel<true>(dst, src, frames, channels, gainStart, gainEnd);
+}
+
+void applyRamp(float* buffer, size_t frames, int channels, float gainStart, float gainEnd) {
+    rampKernel<false>(buffer, nullptr, frames, channels, gainStart, gainEnd);
+}
+
+// ================= Mixer =================
+
+Mixer::Mixer(int ch, size_t maxFrames)
+    : channels(ch), scratch(maxFrames * ch) {}
+
+bool Mixer::fadeOut(std::unique_ptr<AudioStream>& stream, size_t frames, FadeCurve curve, float gain) {
+    if (!stream) return false;
+    for (Voice& voice : voices) {
+        if (voice.stream) continue;
+        voice.stream = std::move(stream);
+        voice.envelope.curve = curve;
+        voice.envelope.length = frames;
+        voice.envelope.position = 0;
+        voice.envelope.fadingIn = false;
+        voice.gain = gain;
+        voice.done = frames == 0;
+        return true;
+    }
+    return false;
+}
+
+void Mixer::mix(float* out, size_t frames) {
+    const size_t maxFrames = scratch.size() / channels;
+
+    for (Voice& voice : voices) {
+        if (!voice.stream || voice.done) continue;
+
+        size_t offset = 0;
+        while (offset < frames && !voice.done) {
+            size_t chunk = std::min(frames - offset, maxFrames);
+            chunk = std::min(chunk, voice.envelope.length - voice.envelope.position);
+            size_t framesRead = voice.stream->read(scratch.data(), chunk);
+
+            float gainStart, gainEnd;
+            voice.envelope.advance(framesRead, gainStart, gainEnd);
+            mixWithRamp(out + offset * channels, scratch.data(), framesRead, channels,
+                        gainStart * voice.gain, gainEnd * voice.gain);
+            offset += framesRead;
+
+            if (voice.envelope.finished() || voice.stream->isFinished()) {
+                voice.done = true;
+            } else if (framesRead < chunk) {
+                break;   // decoder is behind, try again next block
+            }
+        }
+    }
+}
+
+void Mixer::stopAll() {
+    for (Voice& voice : voices) {
+        if (voice.stream) voice.done = true;
+    }
+}
+
+void Mixer::collectFinished(std::vector<std::unique_ptr<AudioStream>>& streams, bool all) {
+    for (Voice& voice : voices) {
+        if (voice.stream && (voice.done || all)) {
+            streams.push_back(std::move(voice.stream));
+            voice.done = false;
+        }
+    }
+}
+
+int Mixer::activeVoices() const {
+    int count = 0;
+    for (const Voice& voice : voices) {
+        if (voice.stream && !voice.done) ++count;
+    }
+    return count;
+}
+
+bool Mixer::hasFreeVoice() const {
+    for (const Voice& voice : voices) {
+        if (!voice.stream) return true;
+    }
+    return false;
+}
+
+AudioStream* Mixer::releaseFinished() {
+    for (Voice& voice : voices) {
+        if (voice.stream && voice.done) {
+            voice.done = false;
+            return voice.stream.release();
+        }
+    }
+    return nullptr;
+}
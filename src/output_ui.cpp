@@ -0,0 +1,280 @@
+#include "output_ui.h"
+#include "audio_config.h"
+#include "audio_stats.h"
+#include "audio_sink.h"
+#include "imgui.h"
+#include "player.h"
+#include "metadata_store.h"
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <algorithm>
+
+static const int bufferSizes[] = { 0, 64, 128, 256, 512, 1024, 2048, 4096, 8192 };
+static const int bufferSizeCount = sizeof(bufferSizes) / sizeof(bufferSizes[0]);
+
+static const char* sinkKinds[] = { "portaudio", "null", "file" };
+static const char* sinkLabels[] = { "Sound card (PortAudio)", "Null (no output)", "WAV file" };
+static const int sinkCount = sizeof(sinkKinds) / sizeof(sinkKinds[0]);
+
+static const char* sampleFormats[] = { "auto", "float32", "int32", "int24", "int16" };
+static const char* sampleFormatLabels[] = { "Auto (float when supported)", "32-bit float", "32-bit integer", "24-bit integer", "16-bit integer" };
+static const int sampleFormatCount = sizeof(sampleFormats) / sizeof(sampleFormats[0]);
+
+static const char* ditherModes[] = { "off", "tpdf", "shaped" };
+static const char* ditherLabels[] = { "Off", "Triangular (TPDF)", "Noise shaped" };
+static const int ditherCount = sizeof(ditherModes) / sizeof(ditherModes[0]);
+
+// Edited settings, applied on "Apply" since reopening the device interrupts playback briefly
+static bool settingsLoaded = false;
+static std::string sink;
+static char outputFile[512] = "";
+static std::string hostApi;
+static std::string device;
+static int framesPerBuffer = 512;
+static int latencyMs = 0;
+static std::string sampleFormat;
+static std::string dither;
+
+static bool showStatsOverlay = false;
+static int lastCompactRemoved = -1;   // -1 until "Remove missing files" ran
+
+static std::vector<std::string> hostApis;
+static std::vector<OutputDeviceInfo> devices;
+
+static void refreshDevices() {
+    hostApis = listHostApis();
+    devices = listOutputDevices(2);
+}
+
+static void loadSettings() {
+    sink = audioConfig.outputSink;
+    snprintf(outputFile, sizeof(outputFile), "%s", audioConfig.outputFile.c_str());
+    hostApi = audioConfig.outputHostApi;
+    device = audioConfig.outputDevice;
+    framesPerBuffer = audioConfig.framesPerBuffer;
+    latencyMs = audioConfig.outputLatencyMs;
+    sampleFormat = audioConfig.outputSampleFormat;
+    dither = audioConfig.outputDither;
+}
+
+// Combo over parallel value/label arrays
+static void drawChoice(const char* label, std::string& value, const char* const* values,
+                       const char* const* labels, int count) {
+    const char* current = value.c_str();
+    for (int i = 0; i < count; ++i) {
+        if (value == values[i]) current = labels[i];
+    }
+    if (ImGui::BeginCombo(label, current)) {
+        for (int i = 0; i < count; ++i) {
+            if (ImGui::Selectable(labels[i], value == values[i])) {
+                value = values[i];
+            }
+        }
+        ImGui::EndCombo();
+    }
+}
+
+static const char* bufferSizeLabel(int frames) {
+    static char label[32];
+    if (frames == 0) return "Auto";
+    snprintf(label, sizeof(label), "%d frames (%.1f ms)", frames, frames * 1000.0f / TARGET_SAMPLE_RATE);
+    return label;
+}
+
+void drawOutputUI() {
+    if (!settingsLoaded) {
+        loadSettings();
+        refreshDevices();
+        settingsLoaded = true;
+    }
+
+    OutputStatus status = getOutputStatus();
+    if (status.open && status.sink != "portaudio") {
+        ImGui::Text("Playing on: %s (%s sink)", status.device.c_str(), status.sink.c_str());
+        ImGui::Text("Buffer: %s, output latency: %.1f ms", bufferSizeLabel(status.framesPerBuffer), status.latencyMs);
+    } else if (status.open) {
+        ImGui::Text("Playing on: %s (%s)", status.device.c_str(), status.hostApi.c_str());
+        ImGui::Text("Buffer: %s, output latency: %.1f ms", bufferSizeLabel(status.framesPerBuffer), status.latencyMs);
+        if (status.dither != "off") {
+            ImGui::Text("Format: %s, %s dither", status.sampleFormat.c_str(), status.dither.c_str());
+        } else {
+            ImGui::Text("Format: %s", status.sampleFormat.c_str());
+        }
+    } else {
+        ImGui::TextDisabled("Output is not open");
+    }
+
+    ImGui::Separator();
+
+    drawChoice("Output", sink, sinkKinds, sinkLabels, sinkCount);
+    if (sink == "file") {
+        ImGui::InputText("File", outputFile, sizeof(outputFile));
+        ImGui::TextDisabled("Empty = config/output.wav. Written at real-time pace while playing,");
+        ImGui::TextDisabled("use --render for faster than real time");
+    }
+
+    // Host API
+    if (ImGui::BeginCombo("Host API", hostApi.empty() ? "Default" : hostApi.c_str())) {
+        if (ImGui::Selectable("Default", hostApi.empty())) {
+            hostApi.clear();
+            device.clear();
+        }
+        for (const std::string& name : hostApis) {
+            if (ImGui::Selectable(name.c_str(), name == hostApi)) {
+                if (name != hostApi) device.clear();
+                hostApi = name;
+            }
+        }
+        ImGui::EndCombo();
+    }
+
+    // Devices of the chosen host API
+    const OutputDeviceInfo* selected = nullptr;
+    if (ImGui::BeginCombo("Device", device.empty() ? "Default" : device.c_str())) {
+        if (ImGui::Selectable("Default", device.empty())) {
+            device.clear();
+        }
+        for (const OutputDeviceInfo& info : devices) {
+            if (!hostApi.empty() && info.hostApi != hostApi) continue;
+            std::string label = hostApi.empty() ? info.name + " (" + info.hostApi + ")" : info.name;
+            if (ImGui::Selectable(label.c_str(), info.name == device)) {
+                device = info.name;
+                if (hostApi.empty()) hostApi = info.hostApi;
+            }
+        }
+        ImGui::EndCombo();
+    }
+    for (const OutputDeviceInfo& info : devices) {
+        if (info.name == device && (hostApi.empty() || info.hostApi == hostApi)) selected = &info;
+    }
+
+    if (ImGui::BeginCombo("Buffer size", bufferSizeLabel(framesPerBuffer))) {
+        for (int i = 0; i < bufferSizeCount; ++i) {
+            if (ImGui::Selectable(bufferSizeLabel(bufferSizes[i]), bufferSizes[i] == framesPerBuffer)) {
+                framesPerBuffer = bufferSizes[i];
+            }
+        }
+        ImGui::EndCombo();
+    }
+
+    ImGui::SliderInt("Latency (ms)", &latencyMs, 0, 500, latencyMs == 0 ? "Device default" : "%d ms");
+    if (selected) {
+        ImGui::TextDisabled("Device default: %.1f ms (low), %.1f ms (high)",
+                            selected->defaultLowLatencyMs, selected->defaultHighLatencyMs);
+    }
+    ImGui::TextDisabled("Small buffers lower the latency, large ones save power and survive load better");
+
+    drawChoice("Sample format", sampleFormat, sampleFormats, sampleFormatLabels, sampleFormatCount);
+    if (sampleFormat == "int16" || sampleFormat == "int24" || sampleFormat == "auto") {
+        drawChoice("Dither", dither, ditherModes, ditherLabels, ditherCount);
+    }
+    ImGui::TextDisabled("Formats the device does not take are skipped, the next best one is used");
+
+    ImGui::Separator();
+
+    if (ImGui::Button("Apply")) {
+        audioConfig.outputSink = sink;
+        audioConfig.outputFile = outputFile;
+        audioConfig.outputHostApi = hostApi;
+        audioConfig.outputDevice = device;
+        audioConfig.framesPerBuffer = framesPerBuffer;
+        audioConfig.outputLatencyMs = latencyMs;
+        audioConfig.outputSampleFormat = sampleFormat;
+        audioConfig.outputDither = dither;
+        saveAudioConfig();
+        reopenAudioOutput();
+        refreshDevices();   // PortAudio was re-initialized, newly plugged devices show up now
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Revert")) {
+        loadSettings();
+    }
+
+    // Limiter, applied while dragging and saved once the edit is done
+    ImGui::Separator();
+    ImGui::Text("Limiter");
+    bool changed = false;
+    bool done = false;
+    done |= ImGui::Checkbox("Enabled", &audioConfig.limiterEnabled);
+    ImGui::SameLine();
+    done |= ImGui::Checkbox("True peak", &audioConfig.limiterTruePeak);
+    changed |= done;
+    changed |= ImGui::SliderFloat("Ceiling", &audioConfig.limiterCeilingDb, -6.0f, 0.0f, "%.1f dB");
+    done |= ImGui::IsItemDeactivatedAfterEdit();
+    changed |= ImGui::SliderFloat("Release", &audioConfig.limiterReleaseMs, 10.0f, 1000.0f, "%.0f ms");
+    done |= ImGui::IsItemDeactivatedAfterEdit();
+    changed |= ImGui::SliderFloat("Look-ahead", &audioConfig.limiterLookaheadMs, 0.5f, 10.0f, "%.1f ms");
+    done |= ImGui::IsItemDeactivatedAfterEdit();
+    if (changed) {
+        sendLimiterSettings();
+    }
+    if (done) {
+        saveAudioConfig();
+    }
+    if (audioConfig.limiterEnabled) {
+        ImGui::TextDisabled("Gain reduction %.1f dB, adds %.1f ms latency",
+                            status.limiterReductionDb, status.processingLatencyMs);
+    } else {
+        ImGui::TextDisabled("Off: overs after the EQ are clipped hard at 0 dBFS");
+    }
+
+    ImGui::Separator();
+    ImGui::Checkbox("Show audio callback stats", &showStatsOverlay);
+
+    // Entries of deleted or changed files are only skipped on lookup; this drops them for good
+    ImGui::Separator();
+    ImGui::Text("Track metadata: %zu entries", metadataStoreSize());
+    if (ImGui::Button("Remove missing files")) {
+        lastCompactRemoved = static_cast<int>(compactMetadataStore());
+    }
+    if (lastCompactRemoved >= 0) {
+        ImGui::SameLine();
+        ImGui::TextDisabled("%d removed", lastCompactRemoved);
+    }
+}
+
+static void drawTimingRow(const char* name, const TimingSummary& timing) {
+    ImGui::Text("%-9s p50 %7.1f  p99 %7.1f  p99.9 %7.1f  max %7.1f us",
+                name, timing.p50Us, timing.p99Us, timing.p999Us, timing.maxUs);
+}
+
+void drawAudioStatsOverlay() {
+    if (!showStatsOverlay) return;
+
+    AudioStatsReport report = getAudioStats();
+
+    ImGui::SetNextWindowBgAlpha(0.8f);
+    ImGui::SetNextWindowPos(ImVec2(ImGui::GetIO().DisplaySize.x - 10.0f, 10.0f), ImGuiCond_Always, ImVec2(1.0f, 0.0f));
+    if (ImGui::Begin("Audio stats", &showStatsOverlay,
+        ImGuiWindowFlags_NoDecoration |
+        ImGuiWindowFlags_AlwaysAutoResize |
+        ImGuiWindowFlags_NoFocusOnAppearing |
+        ImGuiWindowFlags_NoNav)) {
+        ImGui::Text("Callbacks: %llu, budget %.1f us, CPU load %.1f%%",
+                    (unsigned long long)report.callback.count, report.budgetUs, getOutputCpuLoad() * 100.0);
+        drawTimingRow("Callback", report.callback);
+        drawTimingRow("EQ", report.equalizer);
+
+        // Worst case against the deadline, red once a callback could miss it
+        float headroom = report.budgetUs > 0.0 ? static_cast<float>(report.callback.maxUs / report.budgetUs) : 0.0f;
+        ImVec4 alert(1.0f, 0.4f, 0.4f, 1.0f);
+        bool overBudget = report.callback.maxUs > report.budgetUs;
+        if (overBudget) ImGui::PushStyleColor(ImGuiCol_PlotHistogram, alert);
+        ImGui::ProgressBar(std::min(headroom, 1.0f), ImVec2(-1.0f, 0.0f), "max / budget");
+        if (overBudget) ImGui::PopStyleColor();
+
+        ImVec4 normal = ImGui::GetStyleColorVec4(ImGuiCol_Text);
+        ImGui::TextColored(report.overruns ? alert : normal, "Overruns: %llu", (unsigned long long)report.overruns);
+        ImGui::SameLine();
+        ImGui::TextColored(report.underflows ? alert : normal, "Underflows: %llu", (unsigned long long)report.underflows);
+        ImGui::SameLine();
+        ImGui::Text("Overflows: %llu", (unsigned long long)report.overflows);
+
+        if (ImGui::SmallButton("Reset")) {
+            resetAudioStats();
+        }
+    }
+    ImGui::End();
+}
@@ -1,5 +1,20 @@
 #include "eq.h"
 #include "player.h"
+#include "audio_config.h"
+#include "audio_stream.h"
+#include "audio_stats.h"
+#include "ring_buffer.h"
+#include "decoder.h"
+#include "mixer.h"
+#include "engine_command.h"
+#include "snapshot.h"
+#include "metadata_store.h"
+#include "rt_check.h"
+#include "audio_sink.h"
+#include "loudness.h"
+#include "waveform.h"
+#include "spectrum.h"
+#include "limiter.h"
 #include "ui.h"
 #include "lyrics.h"
 #include "texture_loader.h"
@@ -13,7 +28,10 @@
 #include <memory>
 #include <sstream>
 #include <random>
-#include <portaudio.h>
+#include <future>
+#include <functional>
+#include <thread>
+#include <cstdlib>
 #include <cstring>
 #include <cmath>
 #include <filesystem>
@@ -45,18 +63,83 @@ std::filesystem::path configPath = std::filesystem::path(PROJECT_ROOT_DIR) / "co
 const std::string K_PLAYLIST_FILENAME = (configPath / "playlists.json").string();
 const std::string VOLUME_CONFIG_PATH = (configPath / "volume.cfg").string();
 
-// PortAudio variables
-static PaStream* audioStream = nullptr;
-static std::vector<float> audioBuffer;
-static std::atomic<size_t> audioBufferPos{0};
-static std::atomic<bool> isPlaying{false};
-static std::atomic<bool> isPaused{false};
-static std::mutex audioMutex;
-
-// constants for audio
-static const float TARGET_SAMPLE_RATE = 44100.0f;
-static const int TARGET_CHANNELS = 2;
+// Output, PortAudio unless configured otherwise
+static std::unique_ptr<AudioSink> audioSink;
+
+// constants for audio, the engine format is in player.h
 static const int FRAMES_PER_BUFFER = 512;
+static const float GAPLESS_PREPARE_SECONDS = 10.0f;   // open the next track this long before the end
+static const float VOLUME_RAMP_FRAMES = 2205.0f;        // a full-scale volume change is spread over 50 ms
+static const float DECLICK_FRAMES = 220.0f;             // de-click fades take 5 ms, whatever the buffer size
+static const float LOUDNESS_REFERENCE_LUFS = -18.0f;    // ReplayGain 2.0 reference level
+static const double METADATA_SAVE_SECONDS = 120.0;      // new probes and loudness results reach the disk this often
+static const size_t METADATA_SAVE_ENTRIES = 1000;       // or once this many piled up
+
+// UI thread -> engine commands, engine -> UI state. The callback never locks:
+// it drains engineCommands at the start of every buffer, publishes
+// engineSnapshot at the end and sends sources it is done with back through
+// retiredSources, to be freed on the UI thread.
+struct RetiredSource {
+    AudioStream* stream = nullptr;
+    std::vector<float>* buffer = nullptr;
+};
+static RingBuffer<EngineCommand> engineCommands(256);
+static RingBuffer<RetiredSource> retiredSources(256);
+static Snapshot<EngineSnapshot> engineSnapshot;
+
+// Engine state, owned by the audio callback
+struct EngineSource {
+    uint32_t id = 0;
+    AudioStream* stream = nullptr;           // streaming mode
+    std::vector<float>* buffer = nullptr;    // whole-file mode
+    size_t bufferPos = 0;
+    uint64_t startFrames = 0;                // whole-file mode, where playback began (0 or a seek target)
+    float gain = 1.0f;                       // loudness normalization, fixed while the source is audible
+};
+struct Engine {
+    EngineSource current;
+    EngineSource next;                 // gapless/crossfade successor, streams only
+    bool playing = false;
+    bool paused = false;
+    float volume = 0.5f;               // target, set by the UI
+    float volumeGain = 0.5f;           // applied, follows volume over VOLUME_RAMP_FRAMES
+    float transportGain = 1.0f;        // de-click fade, 0 while paused or before a deferred command cuts
+    bool hasDeferred = false;          // a pause, stop or seek waiting for the fade-out to finish
+    EngineCommand deferred;
+    size_t crossfadeFrames = 0;
+    FadeCurve curve = FadeCurve::EqualPower;
+    FadeEnvelope fade;                 // fade-in of the current source
+    uint32_t finishedCount = 0;
+    uint32_t finishedId = 0;
+    uint32_t advancedCount = 0;
+    double positionTime = 0.0;         // stream time at which the last frame read reaches the DAC
+};
+static Engine engine;
+static Mixer mixer(TARGET_CHANNELS, FRAMES_PER_BUFFER * 4);   // outgoing tracks fading out
+static Limiter limiter;   // last stage, after the EQ
+
+// Transport as the UI thread sees it, changed right away when a command is sent
+static bool isPlaying = false;
+static bool isPaused = false;
+static uint32_t nextSourceId = 1;
+static uint32_t currentSourceId = 0;
+static std::string currentSourcePath;
+static size_t currentBufferSamples = 0;   // whole-file mode, size of the buffer handed to the engine
+static uint32_t seenFinishedCount = 0;
+static uint32_t seenAdvancedCount = 0;
+static uint32_t seenLoudnessResults = 0;
+static double lastMetadataSave = 0.0;
+static bool offlineRendering = false;   // renderOffline(): no device, no window
+static size_t skipFadeFrames = 0;   // set by a manual skip, used by the next playTrack()
+
+// Gapless: the upcoming track is opened ahead of time and handed to the engine
+static std::future<std::unique_ptr<AudioStream>> pendingNextStream;
+static int upcomingIndex = -1;
+static std::string upcomingPath;
+static std::vector<std::string> upcomingAlbum;   // albumCandidates() of upcomingPath
+static uint32_t upcomingSourceId = 0;   // non-zero once the engine has it
+static bool upcomingRepeat = false;
+static bool upcomingShuffle = false;
 
 void initializePaths() {
     std::cout << "PROJECT_ROOT_DIR: " << PROJECT_ROOT_DIR << std::endl;
@@ -92,6 +175,8 @@ void initializePaths() {
     }
 }
 
+static void sendVolume();
+
 // Утилиты
 float getNormalizedVolume() {
     return current_volume / 128.0f;
@@ -101,6 +186,7 @@ void setVolume(float normalized) {
     if (normalized < 0.0f) normalized = 0.0f;
     if (normalized > 1.0f) normalized = 1.0f;
     current_volume = static_cast<int>(normalized * 128);
+    sendVolume();
     saveVolumeToFile();
 }
 
@@ -109,101 +195,29 @@ double getTimeSec() {
     return duration_cast<duration<double>>(steady_clock::now().time_since_epoch()).count();
 }
 
-// Get info about audio file via ffprobe
+// Get info about audio file, cached per session
 AudioInfo getAudioInfo(const std::string& filepath) {
-    AudioInfo info;
-    
-    // Get sampling frequency
-    std::string sampleRateCmd = "ffprobe -v quiet -select_streams a:0 -show_entries stream=sample_rate -of default=noprint_wrappers=1:nokey=1 \"" + filepath + "\" 2>/dev/null";
-    std::unique_ptr<FILE, int(*)(FILE*)> pipe1(popen(sampleRateCmd.c_str(), "r"), pclose);
-    if (pipe1) {
-        char buffer[128];
-        if (fgets(buffer, sizeof(buffer), pipe1.get()) != nullptr) {
-            try {
-                float sr = std::stof(std::string(buffer));
-                if (sr > 0) {
-                    info.sampleRate = sr;
-                    info.valid = true;
-                }
-            } catch (...) {}
-        }
-    }
-    
-    // Get number of channels
-    std::string channelsCmd = "ffprobe -v quiet -select_streams a:0 -show_entries stream=channels -of default=noprint_wrappers=1:nokey=1 \"" + filepath + "\" 2>/dev/null";
-    std::unique_ptr<FILE, int(*)(FILE*)> pipe2(popen(channelsCmd.c_str(), "r"), pclose);
-    if (pipe2) {
-        char buffer[128];
-        if (fgets(buffer, sizeof(buffer), pipe2.get()) != nullptr) {
-            try {
-                int ch = std::stoi(std::string(buffer));
-                if (ch > 0) info.channels = ch;
-            } catch (...) {}
-        }
-    }
-    
-    // Get duration
-    std::string durationCmd = "ffprobe -v quiet -show_entries format=duration -of default=noprint_wrappers=1:nokey=1 \"" + filepath + "\" 2>/dev/null";
-    std::unique_ptr<FILE, int(*)(FILE*)> pipe3(popen(durationCmd.c_str(), "r"), pclose);
-    if (pipe3) {
-        char buffer[128];
-        if (fgets(buffer, sizeof(buffer), pipe3.get()) != nullptr) {
-            try {
-                float dur = std::stof(std::string(buffer));
-                if (dur > 0) info.duration = dur;
-            } catch (...) {}
-        }
-    }
-    
-    return info;
+    return probeAudio(filepath);
 }
 
-// Loading audion via ffpmeg
-std::vector<float> loadAudioWithFFmpeg(const std::string& filepath) {
-    // create temp file
-    std::string tempFile = "/tmp/audio_temp_" + std::to_string(rand()) + ".raw";
-    
-    // Extract RAW audio data in float32 format, stereo, 44100 Hz
-    std::string command = "ffmpeg -i \"" + filepath + "\" -f f32le -acodec pcm_f32le -ac 2 -ar 44100 \"" + tempFile + "\" -y 2>/dev/null";
-    
-    std::cout << "Executing: " << command << std::endl;
-    
-    int result = system(command.c_str());
-    if (result != 0) {
-        std::cerr << "FFmpeg failed to convert audio (exit code: " << result << ")" << std::endl;
-        return {};
-    }
-    
-    if (!fs::exists(tempFile)) {
-        std::cerr << "Temporary audio file was not created" << std::endl;
+// Decode the whole file into memory in the engine format
+std::vector<float> loadAudioFile(const std::string& filepath) {
+    std::unique_ptr<Decoder> decoder = openDecoder(filepath, static_cast<int>(TARGET_SAMPLE_RATE), TARGET_CHANNELS);
+    if (!decoder) {
         return {};
     }
-    
-    // Read RAW data
-    std::ifstream file(tempFile, std::ios::binary);
-    if (!file) {
-        std::cerr << "Failed to open temporary audio file: " << tempFile << std::endl;
-        fs::remove(tempFile);
-        return {};
-    }
-    
-    file.seekg(0, std::ios::end);
-    size_t fileSize = file.tellg();
-    file.seekg(0, std::ios::beg);
-    
-    if (fileSize == 0) {
-        std::cerr << "Temporary audio file is empty" << std::endl;
-        file.close();
-        fs::remove(tempFile);
-        return {};
-    }
-    
-    std::vector<float> audioData(fileSize / sizeof(float));
-    file.read(reinterpret_cast<char*>(audioData.data()), fileSize);
-    file.close();
-    
-    fs::remove(tempFile);
-    
+
+    std::vector<float> audioData;
+    audioData.reserve(decoder->totalFrames() * TARGET_CHANNELS);
+
+    const size_t chunkFrames = 16384;
+    size_t frames = 0;
+    do {
+        audioData.resize(audioData.size() + chunkFrames * TARGET_CHANNELS);
+        frames = decoder->read(&audioData[audioData.size() - chunkFrames * TARGET_CHANNELS], chunkFrames);
+        audioData.resize(audioData.size() - (chunkFrames - frames) * TARGET_CHANNELS);
+    } while (frames > 0);
+
     std::cout << "Loaded " << audioData.size() << " audio samples (" 
               << audioData.size() / 2 << " frames)" << std::endl;
     
@@ -239,112 +253,625 @@ void loadLyricsAsync(const std::string& trackPath) {
     }).detach();
 }
 
-// PortAudio callback
-static int audioCallback(const void* inputBuffer, void* outputBuffer,
-                        unsigned long framesPerBuffer,
-                        const PaStreamCallbackTimeInfo* timeInfo,
-                        PaStreamCallbackFlags statusFlags,
-                        void* userData) {
+// ================= Audio engine (callback thread) =================
+
+// Hand a source back to the UI thread for destruction
+static void retireSource(EngineSource& source) {
+    if (source.stream || source.buffer) {
+        RetiredSource retired{source.stream, source.buffer};
+        // The ring only fills up if the UI thread stopped draining it; leaking beats blocking here
+        retiredSources.write(&retired, 1);
+    }
+    source = EngineSource();
+}
+
+static void retireStream(AudioStream* stream) {
+    EngineSource source;
+    source.stream = stream;
+    retireSource(source);
+}
+
+static void applyCommand(const EngineCommand& command) {
+    switch (command.type) {
+        case EngineCommandType::Play: {
+            if (!command.stream && !command.buffer) {
+                // Promote the prepared next source, unless the engine already moved on to it
+                if (engine.current.id == command.id) break;
+                if (engine.next.id != command.id) {
+                    // Nothing to promote, report it as ended so the UI moves on
+                    retireSource(engine.current);
+                    engine.finishedId = command.id;
+                    ++engine.finishedCount;
+                    engine.playing = false;
+                    break;
+                }
+            }
+
+            // Manual skip: the old track fades out in the mixer instead of being cut
+            if (command.frames > 0 && engine.current.stream && engine.playing && !engine.paused &&
+                mixer.hasFreeVoice()) {
+                std::unique_ptr<AudioStream> outgoing(engine.current.stream);
+                mixer.fadeOut(outgoing, command.frames, engine.curve, engine.current.gain);
+                engine.current.stream = nullptr;
+            }
+            retireSource(engine.current);
+
+            if (!command.stream && !command.buffer) {
+                engine.current = engine.next;
+                engine.next = EngineSource();
+            } else {
+                engine.current.id = command.id;
+                engine.current.stream = command.stream;
+                engine.current.buffer = command.buffer;
+                engine.current.gain = command.value;
+            }
+            engine.fade = FadeEnvelope{engine.curve, command.frames, 0, true};
+            engine.playing = true;
+            engine.paused = false;
+            break;
+        }
+        case EngineCommandType::SetNext:
+            retireSource(engine.next);
+            engine.next.id = command.stream ? command.id : 0;
+            engine.next.stream = command.stream;
+            engine.next.gain = command.value;
+            break;
+        case EngineCommandType::NextGain:
+            if (engine.next.id == command.id) engine.next.gain = command.value;
+            break;
+        case EngineCommandType::Seek:
+            if (command.id != engine.current.id) {
+                // Meant for a track that already ended
+                retireStream(command.stream);
+            } else if (command.stream) {
+                retireStream(engine.current.stream);
+                engine.current.stream = command.stream;
+                engine.fade = FadeEnvelope();
+            } else if (engine.current.buffer && command.frames < engine.current.buffer->size()) {
+                engine.current.bufferPos = command.frames;
+                engine.current.startFrames = command.frames / TARGET_CHANNELS;
+            }
+            break;
+        case EngineCommandType::Pause:
+            engine.paused = engine.playing;
+            break;
+        case EngineCommandType::Resume:
+            engine.paused = false;
+            break;
+        case EngineCommandType::Stop:
+            // Already faded out by the transport gain; crossfade and skip voices go too
+            retireSource(engine.current);
+            mixer.stopAll();
+            engine.playing = false;
+            engine.paused = false;
+            break;
+        case EngineCommandType::Volume:
+            engine.volume = command.value;
+            if (!engine.playing) engine.volumeGain = command.value;   // nothing audible to smooth
+            break;
+        case EngineCommandType::EqEnabled:
+            if (g_equalizer) g_equalizer->setEnabled(command.value != 0.0f);
+            break;
+        case EngineCommandType::Crossfade:
+            engine.crossfadeFrames = command.frames;
+            engine.curve = static_cast<FadeCurve>(command.index);
+            break;
+        case EngineCommandType::Limiter:
+            limiter.setSettings(command.limiter);
+            break;
+    }
+}
+
+// Pause, stop and seek would cut the waveform mid-cycle and click; while the
+// track is audible they wait for a DECLICK_FRAMES fade-out, over as many
+// buffers as that takes. Resume fades back in from the paused silence.
+static bool needsDeclick(const EngineCommand& command) {
+    if (!engine.playing || engine.paused) return false;
+    switch (command.type) {
+        case EngineCommandType::Pause:
+        case EngineCommandType::Stop:
+            return true;
+        case EngineCommandType::Seek:
+            return command.id == engine.current.id;
+        default:
+            return false;
+    }
+}
+
+// Commands after a deferred one stay queued, so they still apply in order
+static void drainCommands() {
+    EngineCommand command;
+    while (!engine.hasDeferred && engineCommands.read(&command, 1) == 1) {
+        if (needsDeclick(command)) {
+            engine.deferred = command;
+            engine.hasDeferred = true;
+        } else {
+            applyCommand(command);
+        }
+    }
+}
+
+// The current source ran out: continue with the next one or report the end
+static bool advanceToNext() {
+    if (!engine.next.stream || !engine.next.stream->isReady()) {
+        engine.finishedId = engine.current.id;
+        ++engine.finishedCount;
+        retireSource(engine.current);
+        engine.playing = false;
+        mixer.stopAll();
+        return false;
+    }
+
+    retireSource(engine.current);
+    engine.current = engine.next;
+    engine.next = EngineSource();
+    engine.fade = FadeEnvelope();
+    ++engine.advancedCount;
+    return true;
+}
+
+static void publishSnapshot() {
+    EngineSnapshot snapshot;
+    snapshot.sourceId = engine.current.id;
+    snapshot.playing = engine.playing;
+    snapshot.paused = engine.paused;
+    snapshot.finishedCount = engine.finishedCount;
+    snapshot.finishedId = engine.finishedId;
+    snapshot.advancedCount = engine.advancedCount;
+    snapshot.fadingVoices = mixer.activeVoices();
+    snapshot.positionTime = engine.positionTime;
+    snapshot.limiterLatencyFrames = limiter.latencyFrames();
+    snapshot.limiterReductionDb = limiter.reductionDb();
+    if (AudioStream* stream = engine.current.stream) {
+        snapshot.segmentStartFrames = static_cast<uint64_t>(stream->startOffset() * TARGET_SAMPLE_RATE);
+        snapshot.positionFrames = snapshot.segmentStartFrames + stream->playedFrames();
+        snapshot.bufferedFrames = stream->bufferedFrames();
+    } else if (engine.current.buffer) {
+        snapshot.segmentStartFrames = engine.current.startFrames;
+        snapshot.positionFrames = engine.current.bufferPos / TARGET_CHANNELS;
+    }
+    engineSnapshot.publish(snapshot);
+}
+
+// Sink render callback
+static void audioCallback(float* out, unsigned long framesPerBuffer, const SinkBlockInfo& info) {
     
-    float* out = (float*)outputBuffer;
-    std::lock_guard<std::mutex> lock(audioMutex);
+    [[maybe_unused]] RtScope rtScope;   // YABOKU_RT_CHECK builds report anything here that could block
+    auto callbackStart = std::chrono::steady_clock::now();
+
+    // When the first frame of this buffer reaches the DAC, on the audioSink->time() clock
+    double dacTime = info.dacTime;
+
+    drainCommands();
     
     // set 0 default
     for (unsigned long i = 0; i < framesPerBuffer * TARGET_CHANNELS; ++i) {
         out[i] = 0.0f;
     }
-    
-    if (isPlaying && !isPaused && !audioBuffer.empty()) {
-        size_t currentPos = audioBufferPos.load();
-        float volume = getNormalizedVolume();
+
+    bool active = engine.playing && !engine.paused;
+    AudioStream* stream = engine.current.stream;
+    size_t sourceFrames = 0;   // frames of the current source written to out
+
+    // Crossfade: hand the tail of this track to the mixer and continue with the next one
+    if (active && stream && engine.crossfadeFrames > 0 && engine.next.stream && engine.next.stream->isReady() &&
+        mixer.hasFreeVoice()) {
+        uint64_t totalFrames = stream->totalFrames();
+        uint64_t playedFrames = static_cast<uint64_t>(stream->startOffset() * TARGET_SAMPLE_RATE) + stream->playedFrames();
+        if (totalFrames > playedFrames && totalFrames - playedFrames <= engine.crossfadeFrames) {
+            size_t fadeFrames = static_cast<size_t>(totalFrames - playedFrames);
+            std::unique_ptr<AudioStream> outgoing(stream);
+            mixer.fadeOut(outgoing, fadeFrames, engine.curve, engine.current.gain);
+            engine.current.stream = nullptr;
+            advanceToNext();
+            engine.fade = FadeEnvelope{engine.curve, fadeFrames, 0, true};
+            stream = engine.current.stream;
+        }
+    }
+
+    if (active && stream) {
+        // Silence until the pre-roll is buffered
+        if (stream->isReady()) {
+            size_t framesRead = stream->read(out, framesPerBuffer);
+
+            // Fade-in and loudness gain in one pass
+            float gainStart = engine.current.gain;
+            float gainEnd = engine.current.gain;
+            if (engine.fade.active()) {
+                float fadeStart, fadeEnd;
+                engine.fade.advance(framesRead, fadeStart, fadeEnd);
+                gainStart *= fadeStart;
+                gainEnd *= fadeEnd;
+            }
+            if (gainStart != 1.0f || gainEnd != 1.0f) {
+                applyRamp(out, framesRead, TARGET_CHANNELS, gainStart, gainEnd);
+            }
+
+            if (framesRead < framesPerBuffer && stream->isFinished() && advanceToNext()) {
+                // Gapless: the next track continues at the very next frame
+                float* tail = out + framesRead * TARGET_CHANNELS;
+                size_t tailFrames = engine.current.stream->read(tail, framesPerBuffer - framesRead);
+                if (engine.current.gain != 1.0f) {
+                    applyRamp(tail, tailFrames, TARGET_CHANNELS, engine.current.gain, engine.current.gain);
+                }
+                framesRead += tailFrames;
+            }
+            sourceFrames = framesRead;
+        }
+    } else if (active && engine.current.buffer) {
+        const std::vector<float>& buffer = *engine.current.buffer;
+        size_t currentPos = engine.current.bufferPos;
+        float sourceGain = engine.current.gain;
+        unsigned long filled = 0;
         
-        for (unsigned long frame = 0; frame < framesPerBuffer; ++frame) {
-            if (currentPos + 1 < audioBuffer.size()) {
-                out[frame * TARGET_CHANNELS] = audioBuffer[currentPos] * volume;         // Left
-                out[frame * TARGET_CHANNELS + 1] = audioBuffer[currentPos + 1] * volume; // Right
+        for (unsigned long frame = 0; frame < framesPerBuffer; ++frame, ++filled) {
+            if (currentPos + 1 < buffer.size()) {
+                out[frame * TARGET_CHANNELS] = buffer[currentPos];         // Left
+                out[frame * TARGET_CHANNELS + 1] = buffer[currentPos + 1]; // Right
                 currentPos += TARGET_CHANNELS;
             } else {
                 // End track
-                isPlaying = false;
+                engine.current.bufferPos = currentPos;
+                advanceToNext();
                 break;
             }
         }
         
-        audioBufferPos.store(currentPos);
+        if (engine.current.buffer) {
+            engine.current.bufferPos = currentPos;
+            sourceFrames = framesPerBuffer;
+        }
+        if (sourceGain != 1.0f) {
+            applyRamp(out, filled, TARGET_CHANNELS, sourceGain, sourceGain);
+        }
+    }
+
+    // Stays put while paused or starved, so the UI clock stops at the last frame played;
+    // the limiter's look-ahead holds everything back by its latency
+    if (sourceFrames > 0 && dacTime > 0.0) {
+        engine.positionTime = dacTime + (sourceFrames + limiter.latencyFrames()) / TARGET_SAMPLE_RATE;
+    }
+
+    // Tracks fading out play next to the main source, never on their own after a stop
+    if (engine.playing && !engine.paused) {
+        mixer.mix(out, framesPerBuffer);
+    }
+    while (retiredSources.writeAvailable() > 0) {
+        AudioStream* finished = mixer.releaseFinished();
+        if (!finished) break;
+        retireStream(finished);
+    }
+
+    // Gain stage: volume ramps per sample over the buffer, a plain multiply otherwise
+    float volumeStart = engine.volumeGain;
+    float maxStep = framesPerBuffer / VOLUME_RAMP_FRAMES;
+    engine.volumeGain += std::clamp(engine.volume - engine.volumeGain, -maxStep, maxStep);
+    if (volumeStart != 1.0f || engine.volumeGain != 1.0f) {
+        applyRamp(out, framesPerBuffer, TARGET_CHANNELS, volumeStart, engine.volumeGain);
+    }
+
+    // De-click fade: DECLICK_FRAMES for the whole way, the rest of the buffer holds the level reached
+    float transportTarget = (engine.hasDeferred || engine.paused) ? 0.0f : 1.0f;
+    float transportStart = engine.transportGain;
+    if (transportStart != transportTarget) {
+        size_t rampFrames = static_cast<size_t>(std::ceil(std::fabs(transportTarget - transportStart) * DECLICK_FRAMES));
+        if (rampFrames <= framesPerBuffer) {
+            engine.transportGain = transportTarget;
+        } else {
+            rampFrames = framesPerBuffer;
+            float step = framesPerBuffer / DECLICK_FRAMES;
+            engine.transportGain += transportTarget > transportStart ? step : -step;
+        }
+        applyRamp(out, rampFrames, TARGET_CHANNELS, transportStart, engine.transportGain);
+        if (engine.transportGain != 1.0f) {
+            applyRamp(out + rampFrames * TARGET_CHANNELS, framesPerBuffer - rampFrames, TARGET_CHANNELS,
+                      engine.transportGain, engine.transportGain);
+        }
+    } else if (transportStart == 0.0f) {
+        applyRamp(out, framesPerBuffer, TARGET_CHANNELS, 0.0f, 0.0f);
+    }
+
+    // Faded out to silence, the deferred command can cut now; playback fades back in after it
+    if (engine.hasDeferred && engine.transportGain == 0.0f) {
+        engine.hasDeferred = false;
+        applyCommand(engine.deferred);
     }
     
-    // Apply EQ
-    processEqualizerBuffer(out, framesPerBuffer, TARGET_CHANNELS);
-    
-    return paContinue;
+    // Apply EQ, not even timed while it is off or flat
+    std::chrono::steady_clock::duration equalizerTime{};
+    if (!isEqualizerBypassed()) {
+        auto equalizerStart = std::chrono::steady_clock::now();
+        processEqualizerBuffer(out, framesPerBuffer, TARGET_CHANNELS);
+        equalizerTime = std::chrono::steady_clock::now() - equalizerStart;
+    }
+
+    limiter.process(out, framesPerBuffer);
+
+    // Copy for the spectrum display, analyzed on its own thread
+    spectrumTap(out, framesPerBuffer);
+
+    publishSnapshot();
+
+    auto nanos = [](std::chrono::steady_clock::duration d) {
+        return static_cast<uint32_t>(std::min<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count(), UINT32_MAX));
+    };
+    recordCallbackStats(nanos(std::chrono::steady_clock::now() - callbackStart),
+                        nanos(equalizerTime),
+                        static_cast<uint32_t>(framesPerBuffer * 1e9 / TARGET_SAMPLE_RATE),
+                        info.underflow, info.overflow, info.priming);
 }
 
-void initAudioPlayer() {
-    PaError err = Pa_Initialize();
-    if (err != paNoError) {
-        std::cerr << "PortAudio init failed: " << Pa_GetErrorText(err) << std::endl;
-        return;
+// ================= UI thread side =================
+
+static bool sendCommand(const EngineCommand& command) {
+    if (engineCommands.write(&command, 1) == 1) {
+        return true;
     }
-    
-    PaStreamParameters outputParameters;
-    outputParameters.device = Pa_GetDefaultOutputDevice();
-    if (outputParameters.device == paNoDevice) {
-        std::cerr << "No default output device found" << std::endl;
-        return;
+    std::cerr << "Audio engine is not draining commands, dropped one" << std::endl;
+    delete command.stream;
+    delete command.buffer;
+    return false;
+}
+
+static void sendCommand(EngineCommandType type) {
+    EngineCommand command;
+    command.type = type;
+    sendCommand(command);
+}
+
+// Free what the engine sent back
+static void drainRetiredSources() {
+    RetiredSource retired;
+    while (retiredSources.read(&retired, 1) == 1) {
+        // Stream destructors join their decoder threads
+        delete retired.stream;
+        delete retired.buffer;
     }
-    
-    outputParameters.channelCount = TARGET_CHANNELS;
-    outputParameters.sampleFormat = paFloat32;
-    outputParameters.suggestedLatency = Pa_GetDeviceInfo(outputParameters.device)->defaultLowOutputLatency;
-    outputParameters.hostApiSpecificStreamInfo = nullptr;
-    
-    err = Pa_OpenStream(&audioStream,
-                       nullptr, // no input
-                       &outputParameters,
-                       static_cast<double>(TARGET_SAMPLE_RATE),
-                       FRAMES_PER_BUFFER,
-                       paClipOff,
-                       audioCallback,
-                       nullptr);
-    
-    if (err != paNoError) {
-        std::cerr << "PortAudio stream open failed: " << Pa_GetErrorText(err) << std::endl;
-        return;
+}
+
+static void sendVolume() {
+    EngineCommand command;
+    command.type = EngineCommandType::Volume;
+    command.value = getNormalizedVolume();
+    sendCommand(command);
+}
+
+static void sendCrossfadeSettings() {
+    EngineCommand command;
+    command.type = EngineCommandType::Crossfade;
+    command.frames = static_cast<size_t>(audioConfig.crossfadeSeconds * TARGET_SAMPLE_RATE);
+    command.index = static_cast<int>(fadeCurveFromName(audioConfig.crossfadeCurve));
+    sendCommand(command);
+}
+
+void sendLimiterSettings() {
+    EngineCommand command;
+    command.type = EngineCommandType::Limiter;
+    command.limiter.enabled = audioConfig.limiterEnabled;
+    command.limiter.ceilingDb = audioConfig.limiterCeilingDb;
+    command.limiter.releaseMs = audioConfig.limiterReleaseMs;
+    command.limiter.lookaheadMs = audioConfig.limiterLookaheadMs;
+    command.limiter.truePeak = audioConfig.limiterTruePeak;
+    sendCommand(command);
+}
+
+void sendEqualizerBand(int band, float gainDB) {
+    if (band < 0 || band >= EQ_BANDS) return;
+    // Designed here and published to the callback as a whole bank
+    setEqualizerBand(band, gainDB);
+
+    std::string filterType = (band == 0) ? "Low Shelf" : 
+                            (band == EQ_BANDS - 1) ? "High Shelf" : "Peaking";
+    std::cout << "EQ Band " << band << " (" << EQ_FREQUENCIES[band] << "Hz, " 
+              << filterType << ") set to " << gainDB << "dB" << std::endl;
+}
+
+// Quiet, the parametric table sends every frame while a slider is dragged
+void sendEqualizerBands(const std::vector<EqBand>& bands, float preampDB) {
+    setEqualizerBands(bands, preampDB);
+}
+
+void sendEqualizerEnabled(bool enabled) {
+    EngineCommand command;
+    command.type = EngineCommandType::EqEnabled;
+    command.value = enabled ? 1.0f : 0.0f;
+    sendCommand(command);
+    std::cout << "Equalizer " << (enabled ? "enabled" : "disabled") << std::endl;
+}
+
+// Only once nothing runs the callback any more: applies what is still queued
+// and frees every source the engine holds
+static void releaseEngine() {
+    if (engine.hasDeferred) {
+        engine.hasDeferred = false;
+        applyCommand(engine.deferred);
     }
-    
-    err = Pa_StartStream(audioStream);
-    if (err != paNoError) {
-        std::cerr << "PortAudio stream start failed: " << Pa_GetErrorText(err) << std::endl;
-        return;
+    EngineCommand command;
+    while (engineCommands.read(&command, 1) == 1) {
+        applyCommand(command);
     }
-    
-    // Init Eq
+    retireSource(engine.current);
+    retireSource(engine.next);
+    drainRetiredSources();
+    std::vector<std::unique_ptr<AudioStream>> fading;
+    mixer.collectFinished(fading, true);
+    fading.clear();
+}
+
+// ================= Output stream =================
+
+static SinkSettings sinkSettings(const AudioConfig& config) {
+    SinkSettings settings;
+    settings.sampleRate = TARGET_SAMPLE_RATE;
+    settings.channels = TARGET_CHANNELS;
+    settings.framesPerBuffer = config.framesPerBuffer;
+    settings.hostApi = config.outputHostApi;
+    settings.device = config.outputDevice;
+    settings.latencyMs = config.outputLatencyMs;
+    settings.sampleFormat = config.outputSampleFormat;
+    settings.dither = config.outputDither;
+    settings.filePath = config.outputFile.empty()
+        ? (configPath / "output.wav").string()
+        : config.outputFile;
+    return settings;
+}
+
+static std::unique_ptr<AudioSink> createSink(const std::string& kind, const SinkSettings& settings) {
+    if (kind == "null") return createNullSink(settings);
+    if (kind == "file") return createFileSink(settings);
+    if (kind != "portaudio") {
+        std::cerr << "Unknown output sink: " << kind << ", using portaudio" << std::endl;
+    }
+    return createPortAudioSink(settings);
+}
+
+static bool startSink(std::unique_ptr<AudioSink> sink) {
+    // Clock of the old sink means nothing on the new one
+    engine.positionTime = 0.0;
+    publishSnapshot();
+
+    if (!sink->start(audioCallback)) {
+        return false;
+    }
+    audioSink = std::move(sink);
+
+    const SinkInfo& info = audioSink->info();
+    std::cout << "Output: " << info.device;
+    if (!info.hostApi.empty()) std::cout << " (" << info.hostApi << ")";
+    std::cout << ", " << (info.framesPerBuffer > 0 ? std::to_string(info.framesPerBuffer) : std::string("auto"))
+              << " frames per buffer, latency " << info.latencySeconds * 1000.0 << " ms" << std::endl;
+    return true;
+}
+
+// Opens the configured sink. YABOKU_OUTPUT_SINK=null|file|portaudio in the
+// environment overrides the config, for machines without audio hardware.
+// Falls back to the default device and then to the null sink, so the player
+// keeps running (silently, but with working transport) when nothing opens.
+static bool openOutput() {
+    std::string kind = audioConfig.outputSink;
+    if (const char* env = std::getenv("YABOKU_OUTPUT_SINK")) {
+        kind = env;
+    }
+
+    if (startSink(createSink(kind, sinkSettings(audioConfig)))) {
+        return true;
+    }
+
+    if (kind == "portaudio" && (!audioConfig.outputHostApi.empty() || !audioConfig.outputDevice.empty() ||
+                                audioConfig.framesPerBuffer != AudioConfig().framesPerBuffer ||
+                                audioConfig.outputLatencyMs != 0 || audioConfig.outputSampleFormat != "auto")) {
+        std::cerr << "Falling back to the default output" << std::endl;
+        if (startSink(createPortAudioSink(sinkSettings(AudioConfig())))) {
+            return false;
+        }
+    }
+
+    std::cerr << "No audio output could be opened, playing into the null sink" << std::endl;
+    startSink(createNullSink(sinkSettings(AudioConfig())));
+    return false;
+}
+
+void initAudioPlayer() {
+    loadAudioConfig();
+    openMetadataStore((configPath / "metadata.bin").string());
+    openWaveformCache((configPath / "waveforms").string());
+    startLoudnessAnalysis();
+    startSpectrumAnalyzer(TARGET_SAMPLE_RATE, TARGET_CHANNELS);
+
+    // Init Eq and limiter, before the callback can run
     initEqualizer(TARGET_SAMPLE_RATE);
+    limiter.initialize(TARGET_SAMPLE_RATE);
+
+    openOutput();
     
     playlist.clear();
     currentTrackIndex = -1;
     loadVolumeFromFile();
+    sendVolume();
+    sendCrossfadeSettings();
+    sendLimiterSettings();
     
-    std::cout << "Audio player initialized with PortAudio (SR: " << TARGET_SAMPLE_RATE 
+    std::cout << "Audio player initialized with " << audioSink->info().kind << " output (SR: " << TARGET_SAMPLE_RATE 
               << " Hz, Channels: " << TARGET_CHANNELS << ")" << std::endl;
 }
 
 void shutdownAudio() {
-    if (audioStream) {
-        Pa_CloseStream(audioStream);
-        audioStream = nullptr;
+    if (audioSink) {
+        dumpAudioStats((configPath / "audio_stats.json").string(), audioSink->cpuLoad());
+        audioSink->stop();
+        audioSink.reset();
     }
-    Pa_Terminate();
+
+    // The callback is gone, the UI thread takes over what the engine owned
+    stop();
+    releaseEngine();
+
     shutdownEqualizer();
+    stopSpectrumAnalyzer();
+    stopLoudnessAnalysis();
+    closeMetadataStore();
+    rtCheckSummary();
     std::cout << "Audio player shutdown" << std::endl;
 }
 
-// Playlist
+double getOutputCpuLoad() {
+    return audioSink ? audioSink->cpuLoad() : 0.0;
+}
+
+OutputStatus getOutputStatus() {
+    OutputStatus status;
+    if (audioSink) {
+        const SinkInfo& info = audioSink->info();
+        status.open = true;
+        status.sink = info.kind;
+        status.device = info.device;
+        status.hostApi = info.hostApi;
+        status.framesPerBuffer = info.framesPerBuffer;
+        status.latencyMs = info.latencySeconds * 1000.0;
+        status.sampleFormat = info.sampleFormat;
+        status.dither = info.dither;
+    }
+    EngineSnapshot snapshot = engineSnapshot.read();
+    status.processingLatencyMs = snapshot.limiterLatencyFrames * 1000.0 / TARGET_SAMPLE_RATE;
+    status.limiterReductionDb = snapshot.limiterReductionDb;
+    return status;
+}
+
+// Reopen the output with the current audioConfig settings. The engine keeps
+// its sources and positions across the switch, playback resumes where it was.
+bool reopenAudioOutput() {
+    bool wasAudible = isPlaying && !isPaused;
+    if (audioSink) {
+        // Fade out before the device stops, then wait for the engine to get there
+        if (wasAudible) {
+            sendCommand(EngineCommandType::Pause);
+            for (int i = 0; i < 50 && !engineSnapshot.read().paused; ++i) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+        }
+        // Once the last PortAudio user terminates, the next open rescans devices plugged in since startup
+        audioSink->stop();
+        audioSink.reset();
+    }
+
+    bool opened = openOutput();
+
+    if (wasAudible) {
+        sendCommand(EngineCommandType::Resume);
+    }
+    return opened;
+}
+
 void addTrack(const std::string& filepath) {
+    // Dropping a file again retries it if it failed before or was replaced;
+    // unchanged files are still answered by the metadata store
+    invalidateProbe(filepath);
+
     Track t;
     t.filepath = filepath;
     t.durationSeconds = getTrackDuration(filepath);
     playlist.push_back(t);
+    queueLoudnessAnalysis(filepath);
 
     if (selectedPlaylistIndex >= 0 && selectedPlaylistIndex < (int)playlists.size()) {
         playlists[selectedPlaylistIndex].tracks.push_back(t);
@@ -365,26 +892,118 @@ void clearPlaylist() {
 
 void pause() {
     if (!isPlaying || isPaused) return;
+    sendCommand(EngineCommandType::Pause);
     isPaused = true;
     std::cout << "Playback paused" << std::endl;
 }
 
 void resume() {
     if (!isPlaying || !isPaused) return;
+    sendCommand(EngineCommandType::Resume);
     isPaused = false;
     std::cout << "Playback resumed" << std::endl;
 }
 
+static void cancelUpcoming();
+
 void stop() {
-    std::lock_guard<std::mutex> lock(audioMutex);
+    cancelUpcoming();
+    sendCommand(EngineCommandType::Stop);
+
     isPlaying = false;
     isPaused = false;
-    audioBufferPos = 0;
-    audioBuffer.clear();
+    currentSourceId = 0;
+    currentSourcePath.clear();
+    currentBufferSamples = 0;
     currentTrackPosition = 0.0f;
+    drainRetiredSources();
     std::cout << "Playback stopped" << std::endl;
 }
 
+static std::unique_ptr<AudioStream> openAudioStream(const std::string& filepath, float startSeconds) {
+    auto stream = std::make_unique<AudioStream>(TARGET_SAMPLE_RATE, TARGET_CHANNELS,
+                                                audioConfig.streamBufferMs, audioConfig.streamPrerollMs);
+    if (!stream->open(filepath, startSeconds)) {
+        return nullptr;
+    }
+    return stream;
+}
+
+// Next track for automatic advance, -1 at the end of the playlist
+static int pickNextTrackIndex() {
+    if (playlist.empty()) return -1;
+
+    if (shuffleEnabled) {
+        if ((int)shuffleHistory.size() >= (int)playlist.size()) shuffleHistory.clear();
+
+        int newIndex = currentTrackIndex;
+        int attempts = 0;
+        while ((std::find(shuffleHistory.begin(), shuffleHistory.end(), newIndex) != shuffleHistory.end()
+                || newIndex == currentTrackIndex) && attempts++ < 100) {
+            newIndex = rand() % playlist.size();
+        }
+        return newIndex;
+    }
+
+    int nextIndex = currentTrackIndex + 1;
+    if (nextIndex >= (int)playlist.size()) {
+        return repeatEnabled ? 0 : -1;
+    }
+    return nextIndex;
+}
+
+static void cancelUpcoming() {
+    if (pendingNextStream.valid()) {
+        pendingNextStream.get().reset();
+    }
+
+    if (upcomingSourceId != 0) {
+        EngineCommand command;
+        command.type = EngineCommandType::SetNext;
+        sendCommand(command);
+    }
+    upcomingIndex = -1;
+    upcomingPath.clear();
+    upcomingAlbum.clear();
+    upcomingSourceId = 0;
+}
+
+// Album mode: the playlist's tracks in the same folder, which the album tag
+// narrows down once they are probed. Built once per track, not per result.
+static std::vector<std::string> albumCandidates(const std::string& filepath) {
+    std::vector<std::string> candidates;
+    if (audioConfig.loudnessMode != "album") return candidates;
+    fs::path folder = fs::path(filepath).parent_path();
+    for (const Track& track : playlist) {
+        if (fs::path(track.filepath).parent_path() == folder) candidates.push_back(track.filepath);
+    }
+    return candidates;
+}
+
+// Start opening the track that plays after the current one, on a worker thread
+static void prepareUpcoming() {
+    if (!audioConfig.gaplessEnabled || !audioConfig.streamingEnabled || !isPlaying || currentTrackIndex < 0) return;
+    if (upcomingIndex >= 0) return;
+    float prepareSeconds = std::max(GAPLESS_PREPARE_SECONDS, audioConfig.crossfadeSeconds + 5.0f);
+    if (currentTrackDuration - currentTrackPosition > prepareSeconds) return;
+
+    // Same rule as updatePlayback(): repeat replays the current track
+    int index = repeatEnabled ? currentTrackIndex : pickNextTrackIndex();
+    if (index < 0) return;
+
+    upcomingIndex = index;
+    upcomingPath = playlist[index].filepath;
+    upcomingAlbum = albumCandidates(upcomingPath);
+    upcomingRepeat = repeatEnabled;
+    upcomingShuffle = shuffleEnabled;
+
+    std::string path = upcomingPath;
+    pendingNextStream = std::async(std::launch::async, [path]() {
+        return openAudioStream(path, 0.0f);
+    });
+    std::cout << "Preparing next track: " << path << std::endl;
+}
+
 bool isPlaying_f() {
     return isPlaying && !isPaused;
 }
@@ -393,11 +1012,111 @@ bool isPaused_f() {
     return isPlaying && isPaused;
 }
 
+// Linear gain that brings the track (or its album) to the reference loudness,
+// 1 until the background analysis has a result for it
+static float loudnessGain(const std::string& filepath, const std::vector<std::string>& album) {
+    if (audioConfig.loudnessMode == "off") return 1.0f;
+    TrackLoudness loudness;
+    if (!getTrackLoudness(filepath, loudness)) return 1.0f;
+
+    AudioInfo info;
+    if (audioConfig.loudnessMode == "album" && findProbedAudio(filepath, info) && !info.album.empty()) {
+        // The album is the candidates with the same tag, track gain is used
+        // until all of them are analyzed. Nothing is probed here, the analysis
+        // probes every track it measures.
+        std::vector<TrackLoudness> tracks;
+        bool complete = true;
+        for (const std::string& path : album) {
+            AudioInfo other;
+            if (!findProbedAudio(path, other)) {
+                complete = false;
+                break;
+            }
+            if (other.album != info.album) continue;
+            TrackLoudness otherLoudness;
+            complete = getTrackLoudness(path, otherLoudness);
+            if (!complete) break;
+            tracks.push_back(otherLoudness);
+        }
+        if (complete && !tracks.empty()) {
+            loudness = combineAlbumLoudness(tracks);
+        }
+    }
+
+    if (loudness.gatedBlocks == 0) return 1.0f;   // silence, nothing to normalize
+    float gainDb = LOUDNESS_REFERENCE_LUFS - loudness.integratedLufs + audioConfig.loudnessPreampDb;
+    // Never push the true peak over 0 dBTP
+    gainDb = std::min(gainDb, -loudness.truePeakDb);
+    return std::pow(10.0f, gainDb / 20.0f);
+}
+
+std::shared_ptr<const WaveformPyramid> getCurrentWaveform() {
+    static std::string loadedPath;
+    static uint32_t loadedResults = 0;
+    static std::shared_ptr<const WaveformPyramid> current;
+
+    if (currentTrackIndex < 0 || currentTrackIndex >= (int)playlist.size()) return nullptr;
+    const std::string& path = playlist[currentTrackIndex].filepath;
+    // A missing overview is retried whenever the analysis stores something
+    uint32_t results = loudnessResultCount();
+    if (path != loadedPath || (!current && results != loadedResults)) {
+        loadedPath = path;
+        loadedResults = results;
+        current = loadWaveform(path);
+    }
+    return current;
+}
+
+// Analysis order: the playing track, the ones after it, then the rest
+static void queuePlaylistLoudness(int fromIndex) {
+    for (size_t i = 0; i < playlist.size(); ++i) {
+        queueLoudnessAnalysis(playlist[(fromIndex + i) % playlist.size()].filepath, i == 0);
+    }
+}
+
+// State updates once a track has started, from playTrack() or a gapless advance
+static void onTrackStarted(int index, const AudioInfo& audioInfo) {
+    const auto& track = playlist[index];
+
+    currentTrackIndex = index;
+    selectedTrack = index;
+    currentTrackDuration = audioInfo.duration;
+    currentTrackPosition = 0.0f;
+    
+    if (!offlineRendering) {
+        // Load cover
+        std::string coverPath;
+        if (extractCoverFromMP3(track.filepath, coverPath))
+            loadTrackCover(coverPath);
+        else
+            loadTrackCover((resourcePath / "unknown.png").string().c_str());
+
+        // Load lyrics
+        if (!loadingLyrics)
+            loadLyricsAsync(track.filepath);
+    }
+    
+    // Update shuffle
+    if (shuffleEnabled) {
+        if (std::find(shuffleHistory.begin(), shuffleHistory.end(), index) == shuffleHistory.end())
+            shuffleHistory.push_back(index);
+    }
+
+    queuePlaylistLoudness(index);
+    
+    std::cout << "Now playing: " << track.filepath << std::endl;
+}
+
+// Manual skip: the playing track fades out in the mixer instead of being cut
+static void requestSkipFade() {
+    skipFadeFrames = 0;
+    if (audioConfig.skipFadeMs <= 0 || !isPlaying || isPaused) return;
+    skipFadeFrames = static_cast<size_t>(audioConfig.skipFadeMs * TARGET_SAMPLE_RATE / 1000.0f);
+}
+
 void playTrack(int index) {
     if (index < 0 || index >= (int)playlist.size()) return;
     
-    stop();
-    
     const auto& track = playlist[index];
     
     std::cout << "Loading track: " << track.filepath << std::endl;
@@ -405,68 +1124,94 @@ void playTrack(int index) {
     AudioInfo audioInfo = getAudioInfo(track.filepath);
     if (!audioInfo.valid) {
         std::cerr << "Failed to get audio info for: " << track.filepath << std::endl;
+        stop();
         return;
     }
     
     std::cout << "  Audio info - SR: " << audioInfo.sampleRate 
               << " Hz, Channels: " << audioInfo.channels 
-              << ", Duration: " << audioInfo.duration << "s" << std::endl;
+              << ", Duration: " << audioInfo.duration << "s"
+              << ", Codec: " << audioInfo.codec
+              << ", Bitrate: " << audioInfo.bitrate << " kbps" << std::endl;
+
+    EngineCommand command;
+    command.type = EngineCommandType::Play;
+    command.id = nextSourceId++;
+    command.frames = skipFadeFrames;
+    command.value = loudnessGain(track.filepath, albumCandidates(track.filepath));
+    bool promote = false;
+    size_t bufferSamples = 0;
     
-    // Loading audio data via ffmpeg
-    std::vector<float> rawAudioData = loadAudioWithFFmpeg(track.filepath);
-    if (rawAudioData.empty()) {
-        std::cerr << "Failed to load audio data for: " << track.filepath << std::endl;
-        return;
-    }
+    if (audioConfig.streamingEnabled) {
+        // Streaming: playback starts as soon as the pre-roll is decoded
+        std::unique_ptr<AudioStream> stream;
+        if (index == upcomingIndex && track.filepath == upcomingPath) {
+            if (pendingNextStream.valid()) {
+                stream = pendingNextStream.get();
+            } else if (upcomingSourceId != 0) {
+                // The engine already holds it as its next source
+                command.id = upcomingSourceId;
+                promote = true;
+            }
+        }
+        if (!promote && !stream) {
+            stream = openAudioStream(track.filepath, 0.0f);
+        }
+        if (!promote && !stream) {
+            std::cerr << "Failed to start audio stream for: " << track.filepath << std::endl;
+            stop();
+            return;
+        }
+        command.stream = stream.release();
+    } else {
+        // Loading the whole track before playback
+        std::vector<float> rawAudioData = loadAudioFile(track.filepath);
+        if (rawAudioData.empty()) {
+            std::cerr << "Failed to load audio data for: " << track.filepath << std::endl;
+            stop();
+            return;
+        }
     
-    {
-        std::lock_guard<std::mutex> lock(audioMutex);
-        
-        audioBuffer = std::move(rawAudioData);
-        audioBufferPos = 0;
-        
-        float calculatedDuration = static_cast<float>(audioBuffer.size() / TARGET_CHANNELS) / TARGET_SAMPLE_RATE;
-        
-        std::cout << "  Loaded buffer: " << audioBuffer.size() / TARGET_CHANNELS 
+        float calculatedDuration = static_cast<float>(rawAudioData.size() / TARGET_CHANNELS) / TARGET_SAMPLE_RATE;
+    
+        std::cout << "  Loaded buffer: " << rawAudioData.size() / TARGET_CHANNELS 
                   << " frames (" << calculatedDuration << "s)" << std::endl;
-        
+    
         // Checking the duration compliance
         if (std::abs(calculatedDuration - audioInfo.duration) > 1.0f) {
             std::cout << "  WARNING: Duration mismatch - calculated: " << calculatedDuration 
                       << "s, expected: " << audioInfo.duration << "s" << std::endl;
         }
+
+        bufferSamples = rawAudioData.size();
+        command.buffer = new std::vector<float>(std::move(rawAudioData));
     }
+
+    if (promote) {
+        // Play takes it out of the engine's next slot, nothing to clear there
+        upcomingIndex = -1;
+        upcomingPath.clear();
+        upcomingAlbum.clear();
+        upcomingSourceId = 0;
+    } else {
+        cancelUpcoming();
+    }
+    sendCommand(command);
+    drainRetiredSources();
     
     // Updating the state
-    currentTrackIndex = index;
-    selectedTrack = index;
-    currentTrackDuration = audioInfo.duration;
-    currentTrackPosition = 0.0f;
+    currentSourceId = command.id;
+    currentSourcePath = track.filepath;
+    currentBufferSamples = bufferSamples;
+    skipFadeFrames = 0;
     isPlaying = true;
     isPaused = false;
-    
-    // Load cover
-    std::string coverPath;
-    if (extractCoverFromMP3(track.filepath, coverPath))
-        loadTrackCover(coverPath);
-    else
-        loadTrackCover((resourcePath / "unknown.png").string().c_str());
-
-    // Load lyrics
-    if (!loadingLyrics)
-        loadLyricsAsync(track.filepath);
-    
-    // Update shuffle
-    if (shuffleEnabled) {
-        if (std::find(shuffleHistory.begin(), shuffleHistory.end(), index) == shuffleHistory.end())
-            shuffleHistory.push_back(index);
-    }
-    
-    std::cout << "Now playing: " << track.filepath << std::endl;
+    onTrackStarted(index, audioInfo);
 }
 
 void playPrevious() {
     if (playlist.empty()) return;
+    requestSkipFade();
     
     if (shuffleEnabled) {
         int newIndex = currentTrackIndex;
@@ -485,28 +1230,14 @@ void playPrevious() {
 void playNext() {
     if (playlist.empty()) return;
 
-    if (shuffleEnabled) {
-        if ((int)shuffleHistory.size() >= (int)playlist.size()) shuffleHistory.clear();
-        
-        int newIndex = currentTrackIndex;
-        int attempts = 0;
-        while ((std::find(shuffleHistory.begin(), shuffleHistory.end(), newIndex) != shuffleHistory.end()
-                || newIndex == currentTrackIndex) && attempts++ < 100) {
-            newIndex = rand() % playlist.size();
-        }
-        playTrack(newIndex);
-    } else {
-        int nextIndex = currentTrackIndex + 1;
-        if (nextIndex >= (int)playlist.size()) {
-            if (repeatEnabled) {
-                nextIndex = 0;
-            } else {
-                stop();
-                return;
-            }
-        }
-        playTrack(nextIndex);
+    // A prepared shuffle pick is reused, so the track that was pre-decoded is the one that plays
+    requestSkipFade();
+    int nextIndex = (upcomingIndex >= 0 && !upcomingRepeat) ? upcomingIndex : pickNextTrackIndex();
+    if (nextIndex < 0) {
+        stop();
+        return;
     }
+    playTrack(nextIndex);
 }
 
 void toggleShuffle() {
@@ -520,46 +1251,159 @@ bool isShuffleEnabled() {
 }
 
 void seekTo(float seconds) {
-    if (!audioBuffer.empty() && seconds >= 0.0f && seconds <= currentTrackDuration) {
-        std::lock_guard<std::mutex> lock(audioMutex);
-        
-        size_t newPos = static_cast<size_t>(seconds * TARGET_SAMPLE_RATE * TARGET_CHANNELS);
-        
-        newPos = (newPos / TARGET_CHANNELS) * TARGET_CHANNELS;
+    if (!isPlaying || currentSourceId == 0 || seconds < 0.0f || seconds > currentTrackDuration) return;
+
+    EngineCommand command;
+    command.type = EngineCommandType::Seek;
+    command.id = currentSourceId;
+
+    if (audioConfig.streamingEnabled) {
+        // Restart the stream, the decoder seeks to the new position
+        std::unique_ptr<AudioStream> stream = openAudioStream(currentSourcePath, seconds);
+        if (!stream) return;
+
+        command.stream = stream.release();
+        sendCommand(command);
+        currentTrackPosition = seconds;
+
+        std::cout << "Seeked to: " << seconds << "s (stream restarted)" << std::endl;
+        return;
+    }
+
+    size_t newPos = static_cast<size_t>(seconds * TARGET_SAMPLE_RATE * TARGET_CHANNELS);
+    
+    newPos = (newPos / TARGET_CHANNELS) * TARGET_CHANNELS;
+    
+    if (newPos < currentBufferSamples) {
+        // Applied by the callback at the next buffer
+        command.frames = newPos;
+        sendCommand(command);
+        currentTrackPosition = seconds;
         
-        if (newPos < audioBuffer.size()) {
-            audioBufferPos = newPos;
-            currentTrackPosition = seconds;
-            
-            std::cout << "Seeked to: " << seconds << "s (buffer pos: " << newPos << ")" << std::endl;
-        }
+        std::cout << "Seeked to: " << seconds << "s (buffer pos: " << newPos << ")" << std::endl;
     }
 }
 
+// Position that is audible right now: the engine's read position minus what is
+// still queued between the callback and the DAC, interpolated on the stream clock
+static double audibleFrames(const EngineSnapshot& snapshot) {
+    double frames = static_cast<double>(snapshot.positionFrames);
+    if (audioSink && snapshot.positionTime > 0.0) {
+        double queued = (snapshot.positionTime - audioSink->time()) * TARGET_SAMPLE_RATE;
+        frames -= std::max(queued, 0.0);
+    }
+    // Frames queued before a seek or track change belong to the previous position
+    return std::max(frames, static_cast<double>(snapshot.segmentStartFrames));
+}
+
 void updateTrackPosition() {
-    if (isPlaying && !isPaused && !isSeeking && !audioBuffer.empty()) {
-        size_t currentPos = audioBufferPos.load();
-        float bufferPosition = static_cast<float>(currentPos / TARGET_CHANNELS) / TARGET_SAMPLE_RATE;
-        
-        currentTrackPosition = bufferPosition;
-        
-        if (currentTrackPosition > currentTrackDuration) {
-            currentTrackPosition = currentTrackDuration;
-        }
+    if (!isPlaying || isSeeking) return;
+
+    // Commands not yet applied leave the snapshot on the previous source
+    EngineSnapshot snapshot = engineSnapshot.read();
+    if (snapshot.sourceId != currentSourceId) return;
+
+    currentTrackPosition = static_cast<float>(audibleFrames(snapshot) / TARGET_SAMPLE_RATE);
+    if (currentTrackPosition > currentTrackDuration) {
+        currentTrackPosition = currentTrackDuration;
     }
 }
 
 void updatePlayback() {
+    // Free streams and buffers the engine is done with
+    drainRetiredSources();
+
     if (isSeeking) return;
 
+    EngineSnapshot snapshot = engineSnapshot.read();
+
+    // The engine moved on to the prepared track
+    if (snapshot.advancedCount != seenAdvancedCount) {
+        seenAdvancedCount = snapshot.advancedCount;
+        if (upcomingSourceId != 0 && snapshot.sourceId == upcomingSourceId) {
+            int index = upcomingIndex;
+            currentSourceId = upcomingSourceId;
+            currentSourcePath = upcomingPath;
+            upcomingIndex = -1;
+            upcomingPath.clear();
+            upcomingAlbum.clear();
+            upcomingSourceId = 0;
+            std::cout << "Track finished, continuing with the prepared track" << std::endl;
+            if (index >= 0 && index < (int)playlist.size()) {
+                onTrackStarted(index, getAudioInfo(playlist[index].filepath));
+            }
+        }
+    }
+
+    // Playlist, shuffle or repeat changed after the next track was picked
+    if (upcomingIndex >= 0 && (upcomingIndex >= (int)playlist.size()
+            || playlist[upcomingIndex].filepath != upcomingPath
+            || upcomingRepeat != repeatEnabled || upcomingShuffle != shuffleEnabled)) {
+        cancelUpcoming();
+    }
+
+    // Hand the opened stream to the engine
+    if (pendingNextStream.valid() &&
+        pendingNextStream.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+        std::unique_ptr<AudioStream> stream = pendingNextStream.get();
+        if (stream) {
+            EngineCommand command;
+            command.type = EngineCommandType::SetNext;
+            command.id = nextSourceId++;
+            command.value = loudnessGain(upcomingPath, upcomingAlbum);
+            command.stream = stream.release();
+            if (sendCommand(command)) {
+                upcomingSourceId = command.id;
+            }
+        } else {
+            std::cerr << "Failed to prepare next track: " << upcomingPath << std::endl;
+        }
+    }
+
+    prepareUpcoming();
+
+    // The prepared track was analyzed after it went to the engine. The playing
+    // one keeps its gain, a jump in the middle of a track is worse than none.
+    uint32_t loudnessResults = loudnessResultCount();
+    if (loudnessResults != seenLoudnessResults) {
+        seenLoudnessResults = loudnessResults;
+        if (upcomingSourceId != 0) {
+            EngineCommand command;
+            command.type = EngineCommandType::NextGain;
+            command.id = upcomingSourceId;
+            command.value = loudnessGain(upcomingPath, upcomingAlbum);
+            sendCommand(command);
+        }
+    }
+
+    // A crash must not cost a library worth of probes and loudness analysis
+    size_t pendingMetadata = pendingMetadataCount();
+    double now = getTimeSec();
+    if (lastMetadataSave == 0.0) lastMetadataSave = now;
+    if (pendingMetadata >= METADATA_SAVE_ENTRIES ||
+        (pendingMetadata > 0 && now - lastMetadataSave >= METADATA_SAVE_SECONDS)) {
+        saveMetadataStore();
+        lastMetadataSave = now;
+    }
+
+    // Analysis yields while the decoder has barely anything buffered
+    size_t prerollFrames = static_cast<size_t>(audioConfig.streamPrerollMs * TARGET_SAMPLE_RATE / 1000.0f);
+    setLoudnessAnalysisPaused(audioConfig.streamingEnabled && snapshot.playing && !snapshot.paused &&
+                              snapshot.bufferedFrames < prerollFrames);
+
     // Check if the track is over
-    if (isPlaying && !isPaused && !audioBuffer.empty() && 
-        audioBufferPos >= audioBuffer.size() - TARGET_CHANNELS) {
+    bool finished = snapshot.finishedCount != seenFinishedCount;
+    seenFinishedCount = snapshot.finishedCount;
+    if (finished && isPlaying && snapshot.finishedId == currentSourceId) {
         
         std::cout << "Track finished" << std::endl;
+        isPlaying = false;
         
         if (currentTrackIndex >= 0) {
-            if (repeatEnabled) {
+            if (upcomingIndex >= 0) {
+                // Prepared but not spliced in time, still skips the decoder startup
+                playTrack(upcomingIndex);
+            } else if (repeatEnabled) {
                 playTrack(currentTrackIndex);
             } else {
                 playNext();
@@ -571,19 +1415,107 @@ void updatePlayback() {
 }
 
 void verifyPlayback() {
-    if (!audioBuffer.empty() && isPlaying) {
-        size_t currentPos = audioBufferPos.load();
-        float expectedDuration = static_cast<float>(audioBuffer.size() / TARGET_CHANNELS) / TARGET_SAMPLE_RATE;
-        float currentTime = static_cast<float>(currentPos / TARGET_CHANNELS) / TARGET_SAMPLE_RATE;
+    if (currentBufferSamples > 0 && isPlaying) {
+        EngineSnapshot snapshot = engineSnapshot.read();
+        float expectedDuration = static_cast<float>(currentBufferSamples / TARGET_CHANNELS) / TARGET_SAMPLE_RATE;
+        float currentTime = static_cast<float>(snapshot.positionFrames) / TARGET_SAMPLE_RATE;
         
         std::cout << "Playback verification:" << std::endl;
-        std::cout << "  Buffer size: " << audioBuffer.size() << " samples" << std::endl;
+        std::cout << "  Buffer size: " << currentBufferSamples << " samples" << std::endl;
         std::cout << "  Expected duration: " << expectedDuration << "s" << std::endl;
         std::cout << "  Current time: " << currentTime << "s" << std::endl;
         std::cout << "  Track duration: " << currentTrackDuration << "s" << std::endl;
     }
 }
 
+// ================= Offline rendering =================
+
+// A source the next block would starve on; a device would play silence, offline we wait
+static bool sourceStarving(const AudioStream* stream, size_t frames) {
+    return stream && !stream->isDecodeComplete() && (!stream->isReady() || stream->bufferedFrames() < frames);
+}
+
+bool renderOffline(const std::vector<std::string>& files, float volume,
+                   const std::function<bool(const float*, size_t)>& write) {
+    offlineRendering = true;
+    loadAudioConfig();
+    openMetadataStore((configPath / "metadata.bin").string());
+    initEqualizer(TARGET_SAMPLE_RATE);
+    limiter.initialize(TARGET_SAMPLE_RATE);
+    sendCrossfadeSettings();
+    sendLimiterSettings();
+
+    EngineCommand volumeCommand;
+    volumeCommand.type = EngineCommandType::Volume;
+    volumeCommand.value = std::clamp(volume, 0.0f, 1.0f);
+    sendCommand(volumeCommand);
+
+    // Played in order, once
+    repeatEnabled = false;
+    shuffleEnabled = false;
+    playlist.clear();
+    for (const std::string& file : files) {
+        if (!getAudioInfo(file).valid) {
+            std::cerr << "Skipping unreadable file: " << file << std::endl;
+            continue;
+        }
+        Track track;
+        track.filepath = file;
+        track.durationSeconds = getTrackDuration(file);
+        playlist.push_back(track);
+    }
+
+    std::vector<float> block(FRAMES_PER_BUFFER * TARGET_CHANNELS);
+    bool ok = true;
+    bool started = false;
+    size_t leadIn = 0;
+    playTrack(0);
+    while (isPlaying && ok) {
+        // The next track is handed over at the same block every run, not when its thread happens to finish
+        if (pendingNextStream.valid()) {
+            pendingNextStream.wait();
+        }
+        updateTrackPosition();
+        updatePlayback();
+        if (!isPlaying) break;
+
+        drainCommands();
+        while (sourceStarving(engine.current.stream, FRAMES_PER_BUFFER) ||
+               sourceStarving(engine.next.stream, 1)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        audioCallback(block.data(), FRAMES_PER_BUFFER, SinkBlockInfo());
+
+        // The limiter's delay is silence at the start, cut it so the output lines up with the input
+        if (!started) {
+            started = true;
+            leadIn = limiter.latencyFrames();
+        }
+        size_t skipped = std::min<size_t>(leadIn, FRAMES_PER_BUFFER);
+        leadIn -= skipped;
+        if (skipped < FRAMES_PER_BUFFER) {
+            ok = write(block.data() + skipped * TARGET_CHANNELS, FRAMES_PER_BUFFER - skipped);
+        }
+    }
+
+    // and flush what it still holds at the end
+    size_t tailFrames = limiter.latencyFrames();
+    if (ok && started && tailFrames > 0) {
+        std::vector<float> tail(tailFrames * TARGET_CHANNELS, 0.0f);
+        limiter.process(tail.data(), tailFrames);
+        ok = write(tail.data(), tailFrames);
+    }
+
+    stop();
+    releaseEngine();
+    shutdownEqualizer();
+    closeMetadataStore();
+    rtCheckSummary();
+    offlineRendering = false;
+    return ok;
+}
+
 // Functions for working with settings
 void loadVolumeFromFile() {
     fs::path configDir = fs::path(VOLUME_CONFIG_PATH).parent_path();
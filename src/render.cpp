@@ -0,0 +1,123 @@
+#include "render.h"
+#include "player.h"
+#include "equalizer_ui.h"
+#include "eq.h"
+#include "audio_stats.h"
+#include "wav_writer.h"
+
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+
+static const int RENDER_SAMPLE_RATE = 44100;
+static const int RENDER_CHANNELS = 2;
+
+static void printUsage() {
+    std::cout << "Usage: yaboku_player --render [options] <file>...\n"
+              << "  -o, --output PATH    output file (default: render.wav)\n"
+              << "  --playlist NAME      render a saved playlist after the files\n"
+              << "  --format FORMAT      float (32-bit float WAV, default), pcm16 (dithered) or raw (headerless float)\n"
+              << "  --volume V           gain 0-1 before the EQ (default: 1)\n"
+              << "  --no-eq              bypass the saved equalizer settings\n"
+              << "Output is 44100 Hz stereo; crossfade, gapless and loudness settings come from config/audio.json." << std::endl;
+}
+
+int runRenderCommand(int argc, char** argv) {
+    std::vector<std::string> files;
+    std::string outputPath = "render.wav";
+    std::string playlistName;
+    WavFormat format = WavFormat::Float32;
+    float volume = 1.0f;
+    bool useEq = true;
+
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if ((arg == "-o" || arg == "--output") && hasValue) {
+            outputPath = argv[++i];
+        } else if (arg == "--playlist" && hasValue) {
+            playlistName = argv[++i];
+        } else if (arg == "--format" && hasValue) {
+            std::string name = argv[++i];
+            if (name == "float") format = WavFormat::Float32;
+            else if (name == "pcm16") format = WavFormat::Pcm16;
+            else if (name == "raw") format = WavFormat::Raw;
+            else {
+                std::cerr << "Unknown format: " << name << std::endl;
+                return 2;
+            }
+        } else if (arg == "--volume" && hasValue) {
+            char* end = nullptr;
+            volume = std::strtof(argv[++i], &end);
+            if (end == argv[i] || *end != '\0') {
+                std::cerr << "Invalid volume: " << argv[i] << std::endl;
+                return 2;
+            }
+        } else if (arg == "--no-eq") {
+            useEq = false;
+        } else if (arg == "-h" || arg == "--help") {
+            printUsage();
+            return 0;
+        } else if (!arg.empty() && arg[0] == '-') {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            printUsage();
+            return 2;
+        } else {
+            files.push_back(arg);
+        }
+    }
+
+    if (!playlistName.empty()) {
+        loadPlaylistsFromFile();
+        bool found = false;
+        for (const Playlist& p : getPlaylists()) {
+            if (p.name != playlistName) continue;
+            for (const Track& track : p.tracks) files.push_back(track.filepath);
+            found = true;
+        }
+        if (!found) {
+            std::cerr << "Playlist not found: " << playlistName << std::endl;
+            return 2;
+        }
+    }
+
+    if (files.empty()) {
+        printUsage();
+        return 2;
+    }
+
+    WavWriter writer(outputPath, format, RENDER_SAMPLE_RATE, RENDER_CHANNELS);
+    if (!writer.isOpen()) {
+        std::cerr << "Could not open output: " << outputPath << std::endl;
+        return 1;
+    }
+
+    // Band gains go straight to the equalizer, so it has to exist before the
+    // saved EQ is loaded; the enable flag follows as an engine command
+    initEqualizer(RENDER_SAMPLE_RATE);
+    if (useEq) {
+        loadEQConfig();
+    } else {
+        sendEqualizerEnabled(false);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    bool ok = renderOffline(files, volume, [&](const float* samples, size_t frames) {
+        return writer.write(samples, frames);
+    });
+    ok = writer.close() && ok;
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double seconds = static_cast<double>(writer.frames()) / RENDER_SAMPLE_RATE;
+    AudioStatsReport stats = getAudioStats();
+    std::cout << "Rendered " << seconds << "s of audio to " << outputPath << " in " << elapsed << "s ("
+              << (elapsed > 0.0 ? seconds / elapsed : 0.0) << "x real time)" << std::endl;
+    std::cout << "Block processing: p50 " << stats.callback.p50Us << " us, p99 " << stats.callback.p99Us
+              << " us, max " << stats.callback.maxUs << " us; EQ p50 " << stats.equalizer.p50Us << " us" << std::endl;
+
+    if (!ok) {
+        std::cerr << "Render failed, output may be incomplete" << std::endl;
+        return 1;
+    }
+    return 0;
+}
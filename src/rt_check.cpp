@@ -0,0 +1,204 @@
+#include "rt_check.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <new>
+
+#if defined(__GLIBC__)
+#include <dlfcn.h>
+#include <pthread.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#define YABOKU_RT_INTERPOSE
+#endif
+
+#if __has_include(<execinfo.h>)
+#include <execinfo.h>
+#define YABOKU_RT_BACKTRACE
+#endif
+
+static thread_local int rtDepth = 0;          // > 0 while inside an RtScope
+static thread_local bool reporting = false;   // the report itself may call hooked functions
+static std::atomic<uint64_t> violations{0};
+static std::atomic<int> abortMode{-1};
+static const uint64_t MAX_REPORTS = 20;       // later ones are only counted
+
+static void writeStderr(const char* text, size_t length) {
+#if defined(YABOKU_RT_INTERPOSE)
+    ssize_t written = ::write(2, text, length);
+    (void)written;
+#else
+    fwrite(text, 1, length, stderr);
+#endif
+}
+
+static void reportViolation(const char* what) {
+    if (rtDepth == 0 || reporting) return;
+    reporting = true;
+
+    uint64_t count = violations.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (count <= MAX_REPORTS) {
+        char line[160];
+        int length = snprintf(line, sizeof(line), "RT check: %s on the audio thread (violation %llu)\n",
+                              what, static_cast<unsigned long long>(count));
+        writeStderr(line, static_cast<size_t>(length));
+#if defined(YABOKU_RT_BACKTRACE)
+        void* frames[32];
+        int frameCount = backtrace(frames, 32);
+        backtrace_symbols_fd(frames, frameCount, 2);
+#endif
+        if (count == MAX_REPORTS) {
+            const char* more = "RT check: further violations are only counted\n";
+            writeStderr(more, strlen(more));
+        }
+    }
+
+    if (abortMode.load(std::memory_order_relaxed) == 1) {
+        abort();
+    }
+    reporting = false;
+}
+
+void rtCheckEnter() {
+    if (abortMode.load(std::memory_order_relaxed) < 0) {
+        const char* value = getenv("YABOKU_RT_CHECK_ABORT");
+        abortMode.store(value && value[0] == '1' ? 1 : 0, std::memory_order_relaxed);
+#if defined(YABOKU_RT_BACKTRACE)
+        // The first backtrace() loads libgcc and allocates, get that out of the way
+        void* frames[1];
+        backtrace(frames, 1);
+#endif
+    }
+    ++rtDepth;
+}
+
+void rtCheckLeave() {
+    --rtDepth;
+}
+
+uint64_t rtCheckViolations() {
+    return violations.load(std::memory_order_relaxed);
+}
+
+void rtCheckSummary() {
+    char line[96];
+    int length = snprintf(line, sizeof(line), "RT check: %llu violation(s) on the audio thread\n",
+                          static_cast<unsigned long long>(rtCheckViolations()));
+    writeStderr(line, static_cast<size_t>(length));
+}
+
+#if defined(YABOKU_RT_INTERPOSE)
+
+// ================= glibc interposition =================
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* ptr);
+
+void* malloc(size_t size) {
+    reportViolation("malloc");
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    reportViolation("calloc");
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    reportViolation("realloc");
+    return __libc_realloc(ptr, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+    reportViolation("aligned_alloc");
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** ptr, size_t alignment, size_t size) {
+    reportViolation("posix_memalign");
+    void* memory = __libc_memalign(alignment, size);
+    if (!memory) return ENOMEM;
+    *ptr = memory;
+    return 0;
+}
+
+void free(void* ptr) {
+    if (ptr) reportViolation("free");
+    __libc_free(ptr);
+}
+}
+
+// Forwards to the next definition (libc/libpthread) after reporting the call
+#define RT_INTERPOSE(ret, name, params, args, ...)                                      \
+    extern "C" ret name params __VA_ARGS__ {                                            \
+        reportViolation(#name);                                                         \
+        using Fn = ret (*) params;                                                      \
+        static std::atomic<Fn> next{nullptr};                                           \
+        Fn fn = next.load(std::memory_order_relaxed);                                   \
+        if (!fn) {                                                                      \
+            fn = reinterpret_cast<Fn>(dlsym(RTLD_NEXT, #name));                         \
+            next.store(fn, std::memory_order_relaxed);                                  \
+        }                                                                               \
+        return fn args;                                                                 \
+    }
+
+RT_INTERPOSE(int, pthread_mutex_lock, (pthread_mutex_t* mutex), (mutex), noexcept)
+RT_INTERPOSE(int, pthread_rwlock_rdlock, (pthread_rwlock_t* lock), (lock), noexcept)
+RT_INTERPOSE(int, pthread_rwlock_wrlock, (pthread_rwlock_t* lock), (lock), noexcept)
+RT_INTERPOSE(int, pthread_cond_wait, (pthread_cond_t* cond, pthread_mutex_t* mutex), (cond, mutex))
+RT_INTERPOSE(int, pthread_cond_timedwait,
+             (pthread_cond_t* cond, pthread_mutex_t* mutex, const struct timespec* abstime),
+             (cond, mutex, abstime))
+RT_INTERPOSE(int, pthread_join, (pthread_t thread, void** result), (thread, result))
+RT_INTERPOSE(int, nanosleep, (const struct timespec* request, struct timespec* remaining), (request, remaining))
+RT_INTERPOSE(int, usleep, (useconds_t usec), (usec))
+RT_INTERPOSE(ssize_t, read, (int fd, void* buffer, size_t count), (fd, buffer, count))
+RT_INTERPOSE(ssize_t, write, (int fd, const void* buffer, size_t count), (fd, buffer, count))
+RT_INTERPOSE(int, poll, (struct pollfd* fds, nfds_t count, int timeout), (fds, count, timeout))
+RT_INTERPOSE(size_t, fwrite, (const void* data, size_t size, size_t count, FILE* file), (data, size, count, file))
+RT_INTERPOSE(int, fflush, (FILE* file), (file))
+
+#else
+
+// ================= operator new / delete =================
+
+void* operator new(std::size_t size) {
+    reportViolation("operator new");
+    if (void* memory = std::malloc(size)) return memory;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    reportViolation("operator new[]");
+    if (void* memory = std::malloc(size)) return memory;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    if (ptr) reportViolation("operator delete");
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    if (ptr) reportViolation("operator delete[]");
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+    operator delete[](ptr);
+}
+
+#endif
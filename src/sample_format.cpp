@@ -0,0 +1,300 @@
+#include "sample_format.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define YABOKU_CONVERT_SSE
+#elif defined(__aarch64__)
+// Round-to-nearest float conversion (vcvtnq) is AArch64 only
+#include <arm_neon.h>
+#define YABOKU_CONVERT_NEON
+#endif
+
+// ================= Names =================
+
+const char* sampleFormatName(SampleFormat format) {
+    switch (format) {
+        case SampleFormat::Float32: return "float32";
+        case SampleFormat::Int32: return "int32";
+        case SampleFormat::Int24: return "int24";
+        case SampleFormat::Int16: return "int16";
+    }
+    return "float32";
+}
+
+bool sampleFormatFromName(const std::string& name, SampleFormat& format) {
+    for (SampleFormat candidate : {SampleFormat::Float32, SampleFormat::Int32, SampleFormat::Int24, SampleFormat::Int16}) {
+        if (name == sampleFormatName(candidate)) {
+            format = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t sampleFormatBytes(SampleFormat format) {
+    switch (format) {
+        case SampleFormat::Float32: return 4;
+        case SampleFormat::Int32: return 4;
+        case SampleFormat::Int24: return 3;
+        case SampleFormat::Int16: return 2;
+    }
+    return 4;
+}
+
+const char* ditherModeName(DitherMode mode) {
+    switch (mode) {
+        case DitherMode::Off: return "off";
+        case DitherMode::Triangular: return "tpdf";
+        case DitherMode::Shaped: return "shaped";
+    }
+    return "tpdf";
+}
+
+DitherMode ditherModeFromName(const std::string& name) {
+    if (name == "off") return DitherMode::Off;
+    if (name == "shaped") return DitherMode::Shaped;
+    return DitherMode::Triangular;
+}
+
+std::vector<SampleFormat> sampleFormatCandidates(const std::string& preferred) {
+    std::vector<SampleFormat> formats = {SampleFormat::Float32, SampleFormat::Int32, SampleFormat::Int24, SampleFormat::Int16};
+    SampleFormat first;
+    if (sampleFormatFromName(preferred, first)) {
+        std::rotate(formats.begin(), std::find(formats.begin(), formats.end(), first),
+                    std::find(formats.begin(), formats.end(), first) + 1);
+    }
+    return formats;
+}
+
+DitherState::DitherState(int channelCount, uint32_t seed)
+    : channels(std::clamp(channelCount, 1, MAX_CHANNELS)) {
+    for (int lane = 0; lane < 4; ++lane) {
+        uint32_t value = seed ^ (0x6C8E9CF5u * static_cast<uint32_t>(lane + 1));
+        random[lane] = value ? value : 1u;   // xorshift stays at zero forever
+    }
+}
+
+// ================= Formats =================
+
+template <SampleFormat F> struct FormatTraits;
+
+template <> struct FormatTraits<SampleFormat::Int16> {
+    static constexpr float SCALE = 32767.0f;
+    static constexpr float LIMIT = 32767.0f;
+    static void store(int32_t value, uint8_t* out, size_t index) {
+        int16_t sample = static_cast<int16_t>(value);
+        std::memcpy(out + index * 2, &sample, 2);
+    }
+};
+
+template <> struct FormatTraits<SampleFormat::Int24> {
+    static constexpr float SCALE = 8388607.0f;
+    static constexpr float LIMIT = 8388607.0f;
+    static void store(int32_t value, uint8_t* out, size_t index) {
+        uint8_t* bytes = out + index * 3;
+        bytes[0] = static_cast<uint8_t>(value);
+        bytes[1] = static_cast<uint8_t>(value >> 8);
+        bytes[2] = static_cast<uint8_t>(value >> 16);
+    }
+};
+
+template <> struct FormatTraits<SampleFormat::Int32> {
+    static constexpr float SCALE = 2147483647.0f;   // rounds to 2^31 in float
+    static constexpr float LIMIT = 2147483520.0f;   // largest float below 2^31, converts without overflow
+    static void store(int32_t value, uint8_t* out, size_t index) {
+        std::memcpy(out + index * 4, &value, 4);
+    }
+};
+
+// ================= Dither =================
+
+static inline uint32_t xorshift(uint32_t& state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+// [0, 1) from the top 23 bits, as the mantissa of a float in [1, 2)
+static inline float uniform(uint32_t value) {
+    uint32_t bits = (value >> 9) | 0x3F800000u;
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f - 1.0f;
+}
+
+// Difference of two uniforms: triangular in (-1, 1) LSB
+static inline float triangular(DitherState& state) {
+    return uniform(xorshift(state.random[0])) - uniform(xorshift(state.random[1]));
+}
+
+#if defined(YABOKU_CONVERT_SSE)
+static inline __m128i xorshiftVector(__m128i& state) {
+    state = _mm_xor_si128(state, _mm_slli_epi32(state, 13));
+    state = _mm_xor_si128(state, _mm_srli_epi32(state, 17));
+    state = _mm_xor_si128(state, _mm_slli_epi32(state, 5));
+    return state;
+}
+
+static inline __m128 uniformVector(__m128i value) {
+    __m128i bits = _mm_or_si128(_mm_srli_epi32(value, 9), _mm_set1_epi32(0x3F800000));
+    return _mm_sub_ps(_mm_castsi128_ps(bits), _mm_set1_ps(1.0f));
+}
+
+template <SampleFormat F> static inline void storeVector(__m128i q, uint8_t* out, size_t index);
+
+template <> inline void storeVector<SampleFormat::Int16>(__m128i q, uint8_t* out, size_t index) {
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(out + index * 2), _mm_packs_epi32(q, q));
+}
+
+template <> inline void storeVector<SampleFormat::Int32>(__m128i q, uint8_t* out, size_t index) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + index * 4), q);
+}
+
+template <> inline void storeVector<SampleFormat::Int24>(__m128i q, uint8_t* out, size_t index) {
+    alignas(16) int32_t values[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(values), q);
+    for (int k = 0; k < 4; ++k) {
+        FormatTraits<SampleFormat::Int24>::store(values[k], out, index + k);
+    }
+}
+#elif defined(YABOKU_CONVERT_NEON)
+static inline uint32x4_t xorshiftVector(uint32x4_t& state) {
+    state = veorq_u32(state, vshlq_n_u32(state, 13));
+    state = veorq_u32(state, vshrq_n_u32(state, 17));
+    state = veorq_u32(state, vshlq_n_u32(state, 5));
+    return state;
+}
+
+static inline float32x4_t uniformVector(uint32x4_t value) {
+    uint32x4_t bits = vorrq_u32(vshrq_n_u32(value, 9), vdupq_n_u32(0x3F800000u));
+    return vsubq_f32(vreinterpretq_f32_u32(bits), vdupq_n_f32(1.0f));
+}
+
+template <SampleFormat F> static inline void storeVector(int32x4_t q, uint8_t* out, size_t index);
+
+template <> inline void storeVector<SampleFormat::Int16>(int32x4_t q, uint8_t* out, size_t index) {
+    vst1_s16(reinterpret_cast<int16_t*>(out + index * 2), vqmovn_s32(q));
+}
+
+template <> inline void storeVector<SampleFormat::Int32>(int32x4_t q, uint8_t* out, size_t index) {
+    vst1q_s32(reinterpret_cast<int32_t*>(out + index * 4), q);
+}
+
+template <> inline void storeVector<SampleFormat::Int24>(int32x4_t q, uint8_t* out, size_t index) {
+    int32_t values[4];
+    vst1q_s32(values, q);
+    for (int k = 0; k < 4; ++k) {
+        FormatTraits<SampleFormat::Int24>::store(values[k], out, index + k);
+    }
+}
+#endif
+
+// ================= Kernels =================
+
+static void convertFloat(const float* in, void* out, size_t frames, DitherState& state) {
+    std::memcpy(out, in, frames * state.channels * sizeof(float));
+}
+
+// Scale, optional TPDF, clamp, round to nearest; four samples per vector.
+// Samples are independent here, so channels need no special handling.
+template <SampleFormat F, bool DITHER>
+static void convertInteger(const float* in, void* outBuffer, size_t frames, DitherState& state) {
+    using Traits = FormatTraits<F>;
+    uint8_t* out = static_cast<uint8_t*>(outBuffer);
+    size_t count = frames * state.channels;
+    size_t i = 0;
+
+#if defined(YABOKU_CONVERT_SSE)
+    const __m128 scale = _mm_set1_ps(Traits::SCALE);
+    const __m128 high = _mm_set1_ps(Traits::LIMIT);
+    const __m128 low = _mm_set1_ps(-Traits::LIMIT);
+    __m128i random = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state.random));
+    for (; i + 4 <= count; i += 4) {
+        __m128 v = _mm_mul_ps(_mm_loadu_ps(in + i), scale);
+        if constexpr (DITHER) {
+            __m128 a = uniformVector(xorshiftVector(random));
+            __m128 b = uniformVector(xorshiftVector(random));
+            v = _mm_add_ps(v, _mm_sub_ps(a, b));
+        }
+        v = _mm_max_ps(_mm_min_ps(v, high), low);
+        storeVector<F>(_mm_cvtps_epi32(v), out, i);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state.random), random);
+#elif defined(YABOKU_CONVERT_NEON)
+    const float32x4_t scale = vdupq_n_f32(Traits::SCALE);
+    const float32x4_t high = vdupq_n_f32(Traits::LIMIT);
+    const float32x4_t low = vdupq_n_f32(-Traits::LIMIT);
+    uint32x4_t random = vld1q_u32(state.random);
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t v = vmulq_f32(vld1q_f32(in + i), scale);
+        if constexpr (DITHER) {
+            float32x4_t a = uniformVector(xorshiftVector(random));
+            float32x4_t b = uniformVector(xorshiftVector(random));
+            v = vaddq_f32(v, vsubq_f32(a, b));
+        }
+        v = vmaxq_f32(vminq_f32(v, high), low);
+        storeVector<F>(vcvtnq_s32_f32(v), out, i);
+    }
+    vst1q_u32(state.random, random);
+#endif
+
+    for (; i < count; ++i) {
+        float v = in[i] * Traits::SCALE;
+        if constexpr (DITHER) {
+            v += triangular(state);
+        }
+        v = std::clamp(v, -Traits::LIMIT, Traits::LIMIT);
+        Traits::store(static_cast<int32_t>(std::lrint(v)), out, i);
+    }
+}
+
+// TPDF with error feedback. The 3-tap filter (Wannamaker's F-weighted
+// approximation) gives a noise transfer of 1 - H(z): about -12 dB at low
+// frequencies and +11 dB at Nyquist, where hearing is least sensitive. The
+// feedback makes each sample depend on the previous one, so this stays scalar.
+template <SampleFormat F>
+static void convertShaped(const float* in, void* outBuffer, size_t frames, DitherState& state) {
+    using Traits = FormatTraits<F>;
+    static const float H0 = 1.623f;
+    static const float H1 = -0.982f;
+    static const float H2 = 0.109f;
+    uint8_t* out = static_cast<uint8_t*>(outBuffer);
+    const int channels = state.channels;
+
+    for (size_t frame = 0; frame < frames; ++frame) {
+        for (int ch = 0; ch < channels; ++ch) {
+            size_t index = frame * channels + ch;
+            float* error = state.error[ch];
+            float shaped = in[index] * Traits::SCALE - (H0 * error[0] + H1 * error[1] + H2 * error[2]);
+            float q = std::rint(std::clamp(shaped + triangular(state), -Traits::LIMIT, Traits::LIMIT));
+            error[2] = error[1];
+            error[1] = error[0];
+            // Bounded, so clipping cannot wind the loop up
+            error[0] = std::clamp(q - shaped, -2.0f, 2.0f);
+            Traits::store(static_cast<int32_t>(q), out, index);
+        }
+    }
+}
+
+SampleConverter sampleConverter(SampleFormat format, DitherMode dither) {
+    switch (format) {
+        case SampleFormat::Float32:
+            return convertFloat;
+        case SampleFormat::Int32:
+            return convertInteger<SampleFormat::Int32, false>;
+        case SampleFormat::Int24:
+            if (dither == DitherMode::Shaped) return convertShaped<SampleFormat::Int24>;
+            if (dither == DitherMode::Triangular) return convertInteger<SampleFormat::Int24, true>;
+            return convertInteger<SampleFormat::Int24, false>;
+        case SampleFormat::Int16:
+            if (dither == DitherMode::Shaped) return convertShaped<SampleFormat::Int16>;
+            if (dither == DitherMode::Triangular) return convertInteger<SampleFormat::Int16, true>;
+            return convertInteger<SampleFormat::Int16, false>;
+    }
+    return convertFloat;
+}
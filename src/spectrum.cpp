@@ -0,0 +1,257 @@
+#include "spectrum.h"
+#include "ring_buffer.h"
+#include "snapshot.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define YABOKU_FFT_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define YABOKU_FFT_NEON
+#endif
+
+static const float PI = 3.14159265359f;
+static const int FFT_BITS = 12;
+static const size_t FFT_SIZE = size_t(1) << FFT_BITS;          // 93 ms at 44.1 kHz, 10.8 Hz per bin
+static const size_t TAP_FRAMES = 16384;                          // ~370 ms of slack for the analyzer thread
+static const auto ANALYZER_PERIOD = std::chrono::milliseconds(16);
+static const double VISIBLE_TIMEOUT = 0.5;                       // seconds without getSpectrum() before the FFT stops
+static const float FALL_DB_PER_SECOND = 40.0f;
+static const float PEAK_HOLD_SECONDS = 1.0f;
+static const float PEAK_FALL_DB_PER_SECOND = 20.0f;
+
+static int tapChannels = 2;
+static RingBuffer<float> tap(TAP_FRAMES * 2);
+static Snapshot<SpectrumFrame> spectrum;
+static std::atomic<bool> running{false};
+static std::atomic<double> lastViewed{0.0};
+static std::thread analyzerThread;
+
+static double nowSeconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+float spectrumBandEdge(int band) {
+    return SPECTRUM_MIN_HZ * std::pow(SPECTRUM_MAX_HZ / SPECTRUM_MIN_HZ, static_cast<float>(band) / SPECTRUM_BANDS);
+}
+
+// ================= FFT =================
+
+// Radix-2 complex FFT on split real/imaginary arrays. Twiddles are stored
+// per stage, contiguous, so the butterflies of every stage with at least
+// four of them run four at a time.
+class Fft {
+public:
+    Fft() : twiddleRe(FFT_SIZE), twiddleIm(FFT_SIZE), reversed(FFT_SIZE) {
+        for (size_t half = 1; half < FFT_SIZE; half <<= 1) {
+            for (size_t k = 0; k < half; ++k) {
+                float angle = -PI * static_cast<float>(k) / static_cast<float>(half);
+                twiddleRe[half - 1 + k] = std::cos(angle);
+                twiddleIm[half - 1 + k] = std::sin(angle);
+            }
+        }
+        for (size_t i = 0; i < FFT_SIZE; ++i) {
+            size_t r = 0;
+            for (int bit = 0; bit < FFT_BITS; ++bit) {
+                if (i & (size_t(1) << bit)) r |= size_t(1) << (FFT_BITS - 1 - bit);
+            }
+            reversed[i] = static_cast<uint32_t>(r);
+        }
+    }
+
+    void transform(float* re, float* im) const {
+        for (size_t i = 0; i < FFT_SIZE; ++i) {
+            size_t j = reversed[i];
+            if (j > i) {
+                std::swap(re[i], re[j]);
+                std::swap(im[i], im[j]);
+            }
+        }
+
+        for (size_t half = 1; half < FFT_SIZE; half <<= 1) {
+            const float* wr = &twiddleRe[half - 1];
+            const float* wi = &twiddleIm[half - 1];
+            for (size_t start = 0; start < FFT_SIZE; start += half * 2) {
+                float* aRe = re + start;
+                float* aIm = im + start;
+                float* bRe = aRe + half;
+                float* bIm = aIm + half;
+                size_t k = 0;
+#if defined(YABOKU_FFT_SSE)
+                for (; k + 4 <= half; k += 4) {
+                    __m128 cr = _mm_loadu_ps(wr + k), ci = _mm_loadu_ps(wi + k);
+                    __m128 xr = _mm_loadu_ps(bRe + k), xi = _mm_loadu_ps(bIm + k);
+                    __m128 tr = _mm_sub_ps(_mm_mul_ps(xr, cr), _mm_mul_ps(xi, ci));
+                    __m128 ti = _mm_add_ps(_mm_mul_ps(xr, ci), _mm_mul_ps(xi, cr));
+                    __m128 yr = _mm_loadu_ps(aRe + k), yi = _mm_loadu_ps(aIm + k);
+                    _mm_storeu_ps(bRe + k, _mm_sub_ps(yr, tr));
+                    _mm_storeu_ps(bIm + k, _mm_sub_ps(yi, ti));
+                    _mm_storeu_ps(aRe + k, _mm_add_ps(yr, tr));
+                    _mm_storeu_ps(aIm + k, _mm_add_ps(yi, ti));
+                }
+#elif defined(YABOKU_FFT_NEON)
+                for (; k + 4 <= half; k += 4) {
+                    float32x4_t cr = vld1q_f32(wr + k), ci = vld1q_f32(wi + k);
+                    float32x4_t xr = vld1q_f32(bRe + k), xi = vld1q_f32(bIm + k);
+                    float32x4_t tr = vmlsq_f32(vmulq_f32(xr, cr), xi, ci);
+                    float32x4_t ti = vmlaq_f32(vmulq_f32(xr, ci), xi, cr);
+                    float32x4_t yr = vld1q_f32(aRe + k), yi = vld1q_f32(aIm + k);
+                    vst1q_f32(bRe + k, vsubq_f32(yr, tr));
+                    vst1q_f32(bIm + k, vsubq_f32(yi, ti));
+                    vst1q_f32(aRe + k, vaddq_f32(yr, tr));
+                    vst1q_f32(aIm + k, vaddq_f32(yi, ti));
+                }
+#endif
+                for (; k < half; ++k) {
+                    float tr = bRe[k] * wr[k] - bIm[k] * wi[k];
+                    float ti = bRe[k] * wi[k] + bIm[k] * wr[k];
+                    bRe[k] = aRe[k] - tr;
+                    bIm[k] = aIm[k] - ti;
+                    aRe[k] += tr;
+                    aIm[k] += ti;
+                }
+            }
+        }
+    }
+
+private:
+    std::vector<float> twiddleRe;
+    std::vector<float> twiddleIm;
+    std::vector<uint32_t> reversed;
+};
+
+// ================= Analyzer thread =================
+
+static SpectrumFrame silentFrame() {
+    SpectrumFrame frame;
+    std::fill(std::begin(frame.levels), std::end(frame.levels), SPECTRUM_FLOOR_DB);
+    std::fill(std::begin(frame.peaks), std::end(frame.peaks), SPECTRUM_FLOOR_DB);
+    return frame;
+}
+
+static void analyzerLoop(float sampleRate) {
+    const Fft fft;
+    std::vector<float> window(FFT_SIZE);
+    float windowSum = 0.0f;
+    for (size_t i = 0; i < FFT_SIZE; ++i) {
+        window[i] = 0.5f - 0.5f * std::cos(2.0f * PI * i / FFT_SIZE);
+        windowSum += window[i];
+    }
+    // A full-scale sine reads 0 dB
+    const float amplitudeScale = 2.0f / windowSum;
+
+    // FFT bins of each band; narrow low bands read the bin under their centre
+    const float binHz = sampleRate / FFT_SIZE;
+    size_t firstBin[SPECTRUM_BANDS];
+    size_t lastBin[SPECTRUM_BANDS];
+    for (int band = 0; band < SPECTRUM_BANDS; ++band) {
+        float low = spectrumBandEdge(band);
+        float high = spectrumBandEdge(band + 1);
+        size_t first = static_cast<size_t>(std::ceil(low / binHz));
+        size_t last = static_cast<size_t>(std::ceil(high / binHz));
+        if (last <= first) {
+            first = static_cast<size_t>(std::lround(std::sqrt(low * high) / binHz));
+            last = first + 1;
+        }
+        firstBin[band] = std::min(first, FFT_SIZE / 2 - 1);
+        lastBin[band] = std::clamp(last, firstBin[band] + 1, FFT_SIZE / 2);
+    }
+
+    const size_t channels = static_cast<size_t>(tapChannels);
+    std::vector<float> incoming(tap.capacity());
+    std::vector<float> history(FFT_SIZE, 0.0f);   // mono, newest last
+    std::vector<float> re(FFT_SIZE);
+    std::vector<float> im(FFT_SIZE);
+
+    SpectrumFrame frame = silentFrame();
+    float peakAge[SPECTRUM_BANDS] = {};
+    double lastUpdate = nowSeconds();
+
+    while (running.load(std::memory_order_relaxed)) {
+        std::this_thread::sleep_for(ANALYZER_PERIOD);
+
+        size_t samples = tap.read(incoming.data(), tap.readAvailable() / channels * channels);
+        size_t frames = samples / channels;
+        double now = nowSeconds();
+        if (now - lastViewed.load(std::memory_order_relaxed) > VISIBLE_TIMEOUT) {
+            lastUpdate = now;
+            continue;   // nobody is looking, keep draining the tap
+        }
+
+        // Slide the mono history along by what arrived
+        if (frames >= FFT_SIZE) {
+            history.assign(FFT_SIZE, 0.0f);
+            frames = FFT_SIZE;
+        } else {
+            std::copy(history.begin() + frames, history.end(), history.begin());
+        }
+        const float* source = incoming.data() + (samples - frames * channels);
+        float* target = history.data() + (FFT_SIZE - frames);
+        for (size_t i = 0; i < frames; ++i) {
+            float sum = 0.0f;
+            for (size_t c = 0; c < channels; ++c) sum += source[i * channels + c];
+            target[i] = sum / channels;
+        }
+
+        for (size_t i = 0; i < FFT_SIZE; ++i) {
+            re[i] = history[i] * window[i];
+            im[i] = 0.0f;
+        }
+        fft.transform(re.data(), im.data());
+
+        float elapsed = static_cast<float>(now - lastUpdate);
+        lastUpdate = now;
+        for (int band = 0; band < SPECTRUM_BANDS; ++band) {
+            float power = 0.0f;
+            for (size_t bin = firstBin[band]; bin < lastBin[band]; ++bin) {
+                power = std::max(power, re[bin] * re[bin] + im[bin] * im[bin]);
+            }
+            float db = power > 0.0f ? 20.0f * std::log10(std::sqrt(power) * amplitudeScale) : SPECTRUM_FLOOR_DB;
+            db = std::max(db, SPECTRUM_FLOOR_DB);
+
+            frame.levels[band] = std::max(db, frame.levels[band] - FALL_DB_PER_SECOND * elapsed);
+            if (db >= frame.peaks[band]) {
+                frame.peaks[band] = db;
+                peakAge[band] = 0.0f;
+            } else {
+                peakAge[band] += elapsed;
+                if (peakAge[band] > PEAK_HOLD_SECONDS) {
+                    frame.peaks[band] = std::max(frame.peaks[band] - PEAK_FALL_DB_PER_SECOND * elapsed, frame.levels[band]);
+                }
+            }
+        }
+        spectrum.publish(frame);
+    }
+}
+
+void startSpectrumAnalyzer(float sampleRate, int channels) {
+    if (running.load()) return;
+    tapChannels = std::max(channels, 1);
+    tap.resize(TAP_FRAMES * tapChannels);
+    spectrum.publish(silentFrame());
+    running = true;
+    analyzerThread = std::thread(analyzerLoop, sampleRate);
+}
+
+void stopSpectrumAnalyzer() {
+    running = false;
+    if (analyzerThread.joinable()) analyzerThread.join();
+}
+
+void spectrumTap(const float* samples, size_t frames) {
+    // Whole frames only, the analyzer reads them back interleaved
+    size_t room = tap.writeAvailable() / tapChannels;
+    tap.write(samples, std::min(frames, room) * tapChannels);
+}
+
+SpectrumFrame getSpectrum() {
+    lastViewed.store(nowSeconds(), std::memory_order_relaxed);
+    return spectrum.read();
+}
@@ -0,0 +1,59 @@
+#include "spectrum_ui.h"
+#include "spectrum.h"
+#include "eq.h"
+#include "imgui.h"
+
+#include <cmath>
+#include <algorithm>
+
+static float frequencyToX(float frequency, float width) {
+    return width * std::log(frequency / SPECTRUM_MIN_HZ) / std::log(SPECTRUM_MAX_HZ / SPECTRUM_MIN_HZ);
+}
+
+static float levelToHeight(float db, float height) {
+    return height * std::clamp((db - SPECTRUM_FLOOR_DB) / -SPECTRUM_FLOOR_DB, 0.0f, 1.0f);
+}
+
+void drawSpectrum(float width, float height) {
+    if (width <= 0.0f || height <= 0.0f) return;
+
+    ImGui::InvisibleButton("##spectrum", ImVec2(width, height));
+    bool hovered = ImGui::IsItemHovered();
+    ImVec2 p0 = ImGui::GetItemRectMin();
+    ImVec2 p1 = ImGui::GetItemRectMax();
+
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    drawList->AddRectFilled(p0, p1, IM_COL32(255, 255, 255, 12), 2.0f);
+
+    // Bands of the active EQ layout, to line them up with what they do to the material
+    for (const EqBand& band : getEqualizerBands()) {
+        if (!band.enabled || band.frequency < SPECTRUM_MIN_HZ || band.frequency > SPECTRUM_MAX_HZ) continue;
+        float x = p0.x + frequencyToX(band.frequency, width);
+        drawList->AddLine(ImVec2(x, p0.y), ImVec2(x, p1.y), IM_COL32(255, 255, 255, 30));
+    }
+
+    SpectrumFrame frame = getSpectrum();
+    const float barWidth = width / SPECTRUM_BANDS;
+    int hoveredBand = hovered
+        ? std::clamp(static_cast<int>((ImGui::GetMousePos().x - p0.x) / barWidth), 0, SPECTRUM_BANDS - 1)
+        : -1;
+    for (int band = 0; band < SPECTRUM_BANDS; ++band) {
+        float x0 = p0.x + band * barWidth + 1.0f;
+        float x1 = p0.x + (band + 1) * barWidth - 1.0f;
+        float level = levelToHeight(frame.levels[band], height);
+        float peak = levelToHeight(frame.peaks[band], height);
+        ImU32 color = band == hoveredBand ? IM_COL32(255, 255, 255, 220) : IM_COL32(225, 225, 225, 160);
+        if (level > 0.0f) {
+            drawList->AddRectFilled(ImVec2(x0, p1.y - level), ImVec2(x1, p1.y), color);
+        }
+        if (peak > 0.0f) {
+            drawList->AddLine(ImVec2(x0, p1.y - peak), ImVec2(x1, p1.y - peak), IM_COL32(255, 255, 255, 230));
+        }
+    }
+
+    if (hoveredBand >= 0) {
+        ImGui::SetTooltip("%.0f - %.0f Hz: %.1f dB (peak %.1f dB)",
+                          spectrumBandEdge(hoveredBand), spectrumBandEdge(hoveredBand + 1),
+                          frame.levels[hoveredBand], frame.peaks[hoveredBand]);
+    }
+}
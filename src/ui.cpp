@@ -1,8 +1,11 @@
 #include "equalizer_ui.h"
+#include "output_ui.h"
+#include "spectrum_ui.h"
 #include "get_artist_info.h"
 #include "ui.h"
 #include "lyrics.h"
 #include "player.h"
+#include "waveform.h"
 #include "tinyfiledialogs.h"
 #include "imgui.h"
 #include "texture_loader.h"
@@ -336,6 +339,39 @@ void startFrame() {
     ImGui::NewFrame();
 }
 
+// Track overview behind the seek bar: min/max columns, one per pixel, with
+// the RMS drawn brighter inside; the played part is lit up
+static void drawSeekWaveform(ImVec2 origin, float width, float barHeight, float progress) {
+    static std::shared_ptr<const WaveformPyramid> shownPyramid;
+    static std::vector<WaveformColumn> columns;
+
+    std::shared_ptr<const WaveformPyramid> pyramid = getCurrentWaveform();
+    if (!pyramid || pyramid->empty() || width < 1.0f) return;
+
+    size_t count = static_cast<size_t>(width);
+    if (pyramid != shownPyramid || columns.size() != count) {
+        pyramid->render(0.0, pyramid->duration(), count, columns);
+        shownPyramid = pyramid;
+    }
+
+    const float halfHeight = 9.0f;
+    float centerY = origin.y + barHeight * 0.5f;
+    float playedX = origin.x + width * progress;
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    for (size_t i = 0; i < columns.size(); ++i) {
+        const WaveformColumn& column = columns[i];
+        float x = origin.x + static_cast<float>(i) + 0.5f;
+        bool played = x <= playedX;
+        ImU32 peakColor = played ? IM_COL32(255, 255, 255, 70) : IM_COL32(255, 255, 255, 30);
+        ImU32 rmsColor = played ? IM_COL32(255, 255, 255, 130) : IM_COL32(255, 255, 255, 55);
+        drawList->AddLine(ImVec2(x, centerY - column.max * halfHeight),
+                          ImVec2(x, centerY - column.min * halfHeight - 1.0f), peakColor);
+        float rms = std::min(column.rms, std::max(column.max, -column.min));
+        drawList->AddLine(ImVec2(x, centerY - rms * halfHeight),
+                          ImVec2(x, centerY + rms * halfHeight), rmsColor);
+    }
+}
+
 void drawControlPanel(float windowWidth, float windowHeight, float playlistWidth, float coverHeight) {
     ImGui::SetNextWindowPos(ImVec2(playlistWidth, coverHeight));
     ImGui::SetNextWindowSize(ImVec2(windowWidth - playlistWidth, windowHeight - coverHeight));
@@ -388,6 +424,9 @@ void drawControlPanel(float windowWidth, float windowHeight, float playlistWidth
     ImGui::SetCursorPos(ImVec2(barX, barY));
     ImGui::PushItemWidth(barWidth);
 
+    float shownProgress = (currentTrackDuration > 0.0f) ? std::clamp(seekPos / currentTrackDuration, 0.0f, 1.0f) : 0.0f;
+    drawSeekWaveform(ImGui::GetCursorScreenPos(), barWidth, ImGui::GetFrameHeight(), shownProgress);
+
     // Update seekPos from the current track position,
     // only if the slider is NOT active (so as not to erase the position when moving)
     if (!wasActive)
@@ -419,24 +458,6 @@ void drawControlPanel(float windowWidth, float windowHeight, float playlistWidth
     }
     wasActive = isActive;
 
-    // Checking end of the track
-        if (!isSeeking && currentTrackDuration > 0.0f && currentTrackPosition >= currentTrackDuration - 1.0f && isPlaying_f()) {
-            std::cout << "SeekBar: Track ended, currentTrackPosition: " << currentTrackPosition 
-                      << ", currentTrackDuration: " << currentTrackDuration << std::endl;
-            if (!playlist.empty()) {
-                if (repeatEnabled) {
-                    std::cout << "SeekBar: Repeating track " << currentTrackIndex << std::endl;
-                    playTrack(currentTrackIndex);
-                } else {
-                    std::cout << "SeekBar: Playing next track" << std::endl;
-                    playNext();
-                }
-            } else {
-                std::cout << "SeekBar: Stopping due to empty playlist" << std::endl;
-                stop();
-            }
-        }
-
     ImGui::PopItemWidth();
 
     style.GrabMinSize = oldGrabMinSize;
@@ -748,8 +769,8 @@ void drawUI() {
                 if (openedPlaylistIndex == -1) {
                     std::cout << "No playlist opened, cannot add track\n";
                 } else {
-                    const char* filters[] = { "*.mp3", "*.wav", "*.ogg" };
-                    const char* file = tinyfd_openFileDialog("Выберите аудиофайл", "", 3, filters, NULL, 0);
+                    const char* filters[] = { "*.mp3", "*.wav", "*.ogg", "*.flac" };
+                    const char* file = tinyfd_openFileDialog("Выберите аудиофайл", "", 4, filters, NULL, 0);
                     if (file) {
                         if (openedPlaylistIndex >= 0 && openedPlaylistIndex < (int)playlists.size()) {
                             std::string playlistName = playlists[openedPlaylistIndex].name;
@@ -925,6 +946,14 @@ void drawUI() {
                     }
                 }
 
+                // Spectrum below the lyrics, where there is room left
+                float spectrumHeight = std::min(90.0f, ImGui::GetContentRegionAvail().y - 10.0f);
+                if (spectrumHeight > 30.0f) {
+                    ImGui::Spacing();
+                    ImGui::SetCursorPosX((winSize.x - squareSize) * 0.5f);
+                    drawSpectrum(squareSize, spectrumHeight);
+                }
+
                 ImGui::EndTabItem();
             }
 
@@ -933,6 +962,11 @@ void drawUI() {
                 ImGui::EndTabItem();
             }
 
+            if (ImGui::BeginTabItem("Output")) {
+                drawOutputUI();
+                ImGui::EndTabItem();
+            }
+
             if (ImGui::BeginTabItem("About Artist")) {
                 static std::string lastQueriedArtist;
                 ImVec2 aboutSize = ImGui::GetWindowSize();
@@ -1034,6 +1068,7 @@ void drawUI() {
     ImGui::End();
     }    
     drawControlPanel(io.DisplaySize.x, io.DisplaySize.y, playlistWidth, coverHeight);
+    drawAudioStatsOverlay();
 }
 
 std::string getArtistFromFile(const std::string& path) {
@@ -0,0 +1,57 @@
+#include "wav_writer.h"
+
+#include <algorithm>
+#include <cmath>
+
+WavWriter::WavWriter(const std::string& path, WavFormat format, int sampleRate, int channels)
+    : format(format), sampleRate(sampleRate), channels(channels), dither(channels) {
+    file.open(path, std::ios::binary);
+    if (file.is_open() && format != WavFormat::Raw) {
+        writeHeader(0);
+    }
+}
+
+bool WavWriter::write(const float* samples, size_t frames) {
+    size_t count = frames * channels;
+    if (format == WavFormat::Pcm16) {
+        static const SampleConverter toPcm16 = sampleConverter(SampleFormat::Int16, DitherMode::Triangular);
+        pcm.resize(count);
+        toPcm16(samples, pcm.data(), frames, dither);
+        file.write(reinterpret_cast<const char*>(pcm.data()), count * sizeof(int16_t));
+    } else {
+        file.write(reinterpret_cast<const char*>(samples), count * sizeof(float));
+    }
+    framesWritten += frames;
+    return static_cast<bool>(file);
+}
+
+bool WavWriter::close() {
+    if (!file.is_open()) return false;
+    if (format != WavFormat::Raw) {
+        file.seekp(0);
+        writeHeader(framesWritten);
+    }
+    file.close();
+    return !file.fail();
+}
+
+void WavWriter::writeHeader(uint64_t frames) {
+    uint16_t bytesPerSample = format == WavFormat::Pcm16 ? 2 : 4;
+    uint16_t formatTag = format == WavFormat::Pcm16 ? 1 : 3;   // PCM, IEEE float
+    uint32_t dataSize = static_cast<uint32_t>(std::min<uint64_t>(frames * channels * bytesPerSample, UINT32_MAX - 36));
+
+    auto write16 = [&](uint16_t v) { file.write(reinterpret_cast<const char*>(&v), 2); };
+    auto write32 = [&](uint32_t v) { file.write(reinterpret_cast<const char*>(&v), 4); };
+    file.write("RIFF", 4);
+    write32(36 + dataSize);
+    file.write("WAVEfmt ", 8);
+    write32(16);
+    write16(formatTag);
+    write16(static_cast<uint16_t>(channels));
+    write32(static_cast<uint32_t>(sampleRate));
+    write32(static_cast<uint32_t>(sampleRate * channels * bytesPerSample));
+    write16(static_cast<uint16_t>(channels * bytesPerSample));
+    write16(bytesPerSample * 8);
+    file.write("data", 4);
+    write32(dataSize);
+}
@@ -0,0 +1,273 @@
+#include "waveform.h"
+#include "file_identity.h"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+static std::string cacheDirectory;
+
+// ================= On-disk layout =================
+
+static const char WAVEFORM_MAGIC[8] = {'Y', 'B', 'W', 'A', 'V', 'E', '\0', '\0'};
+static const uint32_t WAVEFORM_VERSION = 2;   // 2: source path
+static const uint32_t MAX_LEVELS = 40;
+static const uint32_t MAX_PATH_LENGTH = 65536;
+
+// Followed by the source path (pathLength bytes), which tells tracks whose
+// path hashes collide apart, one uint64 bucket count per level, then the
+// buckets of every level, finest first
+struct WaveformHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t levelCount;
+    uint64_t fileSize;
+    int64_t mtime;
+    uint64_t totalFrames;
+    uint32_t sampleRate;
+    uint32_t baseFrames;
+    uint32_t pathLength;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(WaveformBucket) == 3, "buckets are stored packed");
+
+static std::string cachePath(const std::string& filepath) {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.wfm", static_cast<unsigned long long>(hashPath(filepath)));
+    return (fs::path(cacheDirectory) / name).string();
+}
+
+// ================= Pyramid =================
+
+void WaveformPyramid::begin(int rate, int channelCount) {
+    sampleRate = rate;
+    channels = std::max(channelCount, 1);
+    totalFrames = 0;
+    levels.assign(1, std::vector<WaveformBucket>());
+    bucketFrames = 0;
+    bucketMin = 0.0f;
+    bucketMax = 0.0f;
+    bucketSquares = 0.0;
+}
+
+void WaveformPyramid::add(const float* samples, size_t frames) {
+    for (size_t i = 0; i < frames; ++i) {
+        const float* frame = samples + i * channels;
+        double squares = 0.0;
+        for (int ch = 0; ch < channels; ++ch) {
+            float s = frame[ch];
+            bucketMin = std::min(bucketMin, s);
+            bucketMax = std::max(bucketMax, s);
+            squares += static_cast<double>(s) * s;
+        }
+        bucketSquares += squares / channels;
+        if (++bucketFrames == BASE_FRAMES) flushBucket();
+    }
+    totalFrames += frames;
+}
+
+void WaveformPyramid::flushBucket() {
+    if (bucketFrames == 0) return;
+    float rms = static_cast<float>(std::sqrt(bucketSquares / bucketFrames));
+    WaveformBucket bucket;
+    bucket.min = static_cast<int8_t>(std::lround(std::clamp(bucketMin, -1.0f, 1.0f) * 127.0f));
+    bucket.max = static_cast<int8_t>(std::lround(std::clamp(bucketMax, -1.0f, 1.0f) * 127.0f));
+    bucket.rms = static_cast<uint8_t>(std::lround(std::min(rms, 1.0f) * 255.0f));
+    levels[0].push_back(bucket);
+
+    bucketFrames = 0;
+    bucketMin = 0.0f;
+    bucketMax = 0.0f;
+    bucketSquares = 0.0;
+}
+
+void WaveformPyramid::finish() {
+    if (levels.empty()) return;
+    flushBucket();
+    levels.resize(1);
+    // Halve until one bucket covers the whole track
+    while (levels.back().size() > 1) {
+        const std::vector<WaveformBucket>& below = levels.back();
+        std::vector<WaveformBucket> level((below.size() + 1) / 2);
+        for (size_t i = 0; i < level.size(); ++i) {
+            const WaveformBucket& a = below[2 * i];
+            const WaveformBucket& b = 2 * i + 1 < below.size() ? below[2 * i + 1] : a;
+            level[i].min = std::min(a.min, b.min);
+            level[i].max = std::max(a.max, b.max);
+            float squares = (static_cast<float>(a.rms) * a.rms + static_cast<float>(b.rms) * b.rms) * 0.5f;
+            level[i].rms = static_cast<uint8_t>(std::lround(std::sqrt(squares)));
+        }
+        levels.push_back(std::move(level));
+    }
+}
+
+double WaveformPyramid::duration() const {
+    return sampleRate > 0 ? static_cast<double>(totalFrames) / sampleRate : 0.0;
+}
+
+void WaveformPyramid::render(double startSeconds, double endSeconds, size_t columns,
+                             std::vector<WaveformColumn>& out) const {
+    out.assign(columns, WaveformColumn());
+    if (empty() || columns == 0 || endSeconds <= startSeconds || sampleRate <= 0) return;
+
+    double startFrame = startSeconds * sampleRate;
+    double framesPerColumn = (endSeconds - startSeconds) * sampleRate / columns;
+
+    // Coarsest level whose buckets are no wider than a column: each column
+    // then reads one to three buckets
+    size_t level = 0;
+    while (level + 1 < levels.size() && std::ldexp(static_cast<double>(BASE_FRAMES), static_cast<int>(level + 1)) <= framesPerColumn) {
+        ++level;
+    }
+    const std::vector<WaveformBucket>& buckets = levels[level];
+    double bucketSize = std::ldexp(static_cast<double>(BASE_FRAMES), static_cast<int>(level));
+
+    for (size_t c = 0; c < columns; ++c) {
+        double from = (startFrame + c * framesPerColumn) / bucketSize;
+        double to = (startFrame + (c + 1) * framesPerColumn) / bucketSize;
+        if (to <= 0.0) continue;
+        size_t first = static_cast<size_t>(std::max(from, 0.0));
+        if (first >= buckets.size()) break;
+        size_t last = std::min(std::max(first + 1, static_cast<size_t>(std::ceil(to))), buckets.size());
+
+        int minValue = 127;
+        int maxValue = -127;
+        float squares = 0.0f;
+        for (size_t i = first; i < last; ++i) {
+            minValue = std::min<int>(minValue, buckets[i].min);
+            maxValue = std::max<int>(maxValue, buckets[i].max);
+            squares += static_cast<float>(buckets[i].rms) * buckets[i].rms;
+        }
+        out[c].min = minValue / 127.0f;
+        out[c].max = maxValue / 127.0f;
+        out[c].rms = std::sqrt(squares / (last - first)) / 255.0f;
+    }
+}
+
+bool WaveformPyramid::save(const std::string& path, const std::string& sourcePath, uint64_t fileSize, int64_t mtime) const {
+    // Written aside and renamed, a reader never sees half a file
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file) return false;
+
+        WaveformHeader header = {};
+        std::memcpy(header.magic, WAVEFORM_MAGIC, sizeof(header.magic));
+        header.version = WAVEFORM_VERSION;
+        header.levelCount = static_cast<uint32_t>(levels.size());
+        header.fileSize = fileSize;
+        header.mtime = mtime;
+        header.totalFrames = totalFrames;
+        header.sampleRate = static_cast<uint32_t>(sampleRate);
+        header.baseFrames = BASE_FRAMES;
+        header.pathLength = static_cast<uint32_t>(sourcePath.size());
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(sourcePath.data(), sourcePath.size());
+        for (const std::vector<WaveformBucket>& level : levels) {
+            uint64_t count = level.size();
+            file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        }
+        for (const std::vector<WaveformBucket>& level : levels) {
+            file.write(reinterpret_cast<const char*>(level.data()), level.size() * sizeof(WaveformBucket));
+        }
+        if (!file) return false;
+    }
+
+    std::error_code ec;
+    fs::rename(tempPath, path, ec);
+    if (ec) {
+        fs::remove(tempPath, ec);
+        return false;
+    }
+    return true;
+}
+
+// Header and source path; false unless the file is a pyramid of sourcePath as it is now
+static bool readHeader(std::ifstream& file, WaveformHeader& header, const std::string& sourcePath,
+                       uint64_t fileSize, int64_t mtime) {
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+    if (std::memcmp(header.magic, WAVEFORM_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != WAVEFORM_VERSION || header.pathLength > MAX_PATH_LENGTH) {
+        return false;
+    }
+    if (header.fileSize != fileSize || header.mtime != mtime || header.pathLength != sourcePath.size()) return false;
+    std::string storedPath(header.pathLength, '\0');
+    return file.read(&storedPath[0], storedPath.size()) && storedPath == sourcePath;
+}
+
+bool WaveformPyramid::load(const std::string& path, const std::string& sourcePath, uint64_t fileSize, int64_t mtime) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+
+    WaveformHeader header;
+    if (!readHeader(file, header, sourcePath, fileSize, mtime)) return false;
+    if (header.baseFrames != BASE_FRAMES || header.levelCount == 0 || header.levelCount > MAX_LEVELS) {
+        return false;
+    }
+
+    std::vector<uint64_t> counts(header.levelCount);
+    if (!file.read(reinterpret_cast<char*>(counts.data()), counts.size() * sizeof(uint64_t))) return false;
+    // Every level halves the one below, anything else is a damaged file
+    uint64_t expected = (header.totalFrames + BASE_FRAMES - 1) / BASE_FRAMES;
+    for (uint64_t count : counts) {
+        if (count != expected) return false;
+        expected = (expected + 1) / 2;
+    }
+
+    std::vector<std::vector<WaveformBucket>> loaded(header.levelCount);
+    for (size_t i = 0; i < loaded.size(); ++i) {
+        loaded[i].resize(counts[i]);
+        if (!file.read(reinterpret_cast<char*>(loaded[i].data()), counts[i] * sizeof(WaveformBucket))) return false;
+    }
+
+    sampleRate = static_cast<int>(header.sampleRate);
+    totalFrames = header.totalFrames;
+    levels = std::move(loaded);
+    return true;
+}
+
+// ================= Cache =================
+
+void openWaveformCache(const std::string& directory) {
+    cacheDirectory = directory;
+    std::error_code ec;
+    fs::create_directories(cacheDirectory, ec);
+    if (ec) {
+        std::cerr << "Waveform cache unavailable: " << cacheDirectory << ": " << ec.message() << std::endl;
+    }
+}
+
+bool hasWaveform(const std::string& filepath) {
+    if (cacheDirectory.empty()) return false;
+    uint64_t fileSize = 0;
+    int64_t mtime = 0;
+    if (!statFile(filepath, fileSize, mtime)) return false;
+    std::ifstream file(cachePath(filepath), std::ios::binary);
+    WaveformHeader header;
+    return file && readHeader(file, header, filepath, fileSize, mtime);
+}
+
+bool storeWaveform(const std::string& filepath, const WaveformPyramid& pyramid) {
+    if (cacheDirectory.empty() || pyramid.empty()) return false;
+    uint64_t fileSize = 0;
+    int64_t mtime = 0;
+    if (!statFile(filepath, fileSize, mtime)) return false;
+    return pyramid.save(cachePath(filepath), filepath, fileSize, mtime);
+}
+
+std::shared_ptr<const WaveformPyramid> loadWaveform(const std::string& filepath) {
+    if (cacheDirectory.empty()) return nullptr;
+    uint64_t fileSize = 0;
+    int64_t mtime = 0;
+    if (!statFile(filepath, fileSize, mtime)) return nullptr;
+    auto pyramid = std::make_shared<WaveformPyramid>();
+    if (!pyramid->load(cachePath(filepath), filepath, fileSize, mtime)) return nullptr;
+    return pyramid;
+}